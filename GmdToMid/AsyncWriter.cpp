@@ -0,0 +1,203 @@
+// AsyncWriter.cpp - Defines the AsyncWriter and AsyncSink classes.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstring>
+#include "AsyncWriter.h"
+
+AsyncWriter::AsyncWriter(size_t numThreads, size_t maxQueuedBytes) :
+    maxQueuedBytes{ maxQueuedBytes }
+{
+    if (numThreads == 0)
+        numThreads = 1;
+
+    for (size_t i = 0; i < numThreads; i++)
+        threads.emplace_back(&AsyncWriter::WriterLoop, this);
+}
+
+AsyncWriter::~AsyncWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock{ mutex };
+        stopping = true;
+    }
+
+    jobAvailable.notify_all();
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+void AsyncWriter::Submit(Batch& batch,
+                         OutputSink& sink,
+                         const std::string& name,
+                         std::vector<ByteSpan>&& pieces,
+                         std::vector<uint8_t>&& storage)
+{
+    size_t size = storage.size();
+    std::unique_lock<std::mutex> lock{ mutex };
+
+    // Only the copies count against the queue, since the pinned bytes are
+    // there anyway. A file larger than the whole queue is still accepted
+    // once the queue is empty, otherwise it could never be written.
+    spaceAvailable.wait(lock, [&]
+    {
+        return queuedBytes == 0 || queuedBytes + size <= maxQueuedBytes;
+    });
+
+    queuedBytes += size;
+    batch.pending++;
+    jobs.push_back(Job{ &batch, &sink, name, std::move(pieces),
+                        std::move(storage) });
+    jobAvailable.notify_one();
+}
+
+std::vector<std::string> AsyncWriter::Wait(Batch& batch)
+{
+    std::unique_lock<std::mutex> lock{ mutex };
+    jobFinished.wait(lock, [&] { return batch.pending == 0; });
+
+    std::vector<std::string> failedNames = std::move(batch.failedNames);
+    batch.failedNames.clear();
+    return failedNames;
+}
+
+void AsyncWriter::Drain()
+{
+    std::unique_lock<std::mutex> lock{ mutex };
+    jobFinished.wait(lock, [&] { return jobs.empty() && activeJobs == 0; });
+}
+
+void AsyncWriter::WriterLoop()
+{
+    std::unique_lock<std::mutex> lock{ mutex };
+    while (true)
+    {
+        jobAvailable.wait(lock, [&] { return stopping || !jobs.empty(); });
+        if (jobs.empty())
+            return;
+
+        Job job = std::move(jobs.front());
+        jobs.pop_front();
+        activeJobs++;
+
+        lock.unlock();
+        bool written = job.sink->Write(job.name, job.pieces);
+        lock.lock();
+
+        if (!written)
+            job.batch->failedNames.push_back(job.name);
+
+        job.batch->pending--;
+        queuedBytes -= job.storage.size();
+        activeJobs--;
+        spaceAvailable.notify_all();
+        jobFinished.notify_all();
+    }
+}
+
+AsyncSink::~AsyncSink()
+{
+    writer.Wait(batch);
+}
+
+bool AsyncSink::Write(const std::string& name,
+                      const std::vector<ByteSpan>& pieces)
+{
+    // The pieces that aren't pinned are copied into one block, which is
+    // sized up front so that the copies never move.
+    size_t copySize{ 0 };
+    for (const ByteSpan& piece : pieces)
+    {
+        if (!IsPinned(piece))
+            copySize += piece.size;
+    }
+
+    std::vector<uint8_t> storage(copySize);
+    std::vector<ByteSpan> queuedPieces;
+    queuedPieces.reserve(pieces.size());
+    uint8_t* position = storage.data();
+    for (const ByteSpan& piece : pieces)
+    {
+        if (IsPinned(piece))
+        {
+            queuedPieces.push_back(piece);
+            continue;
+        }
+
+        if (piece.size > 0)
+            std::memcpy(position, piece.data, piece.size);
+        queuedPieces.push_back(ByteSpan{ position, piece.size });
+        position += piece.size;
+    }
+
+    writer.Submit(batch, sink, name, std::move(queuedPieces),
+                  std::move(storage));
+    return true;
+}
+
+bool AsyncSink::WriteBuffer(const std::string& name,
+                            std::vector<uint8_t>&& buffer)
+{
+    // Moving the buffer leaves its bytes where they are, so the piece still
+    // refers to them once the writer has taken it.
+    std::vector<ByteSpan> pieces{ ByteSpan{ buffer.data(), buffer.size() } };
+    writer.Submit(batch, sink, name, std::move(pieces), std::move(buffer));
+    return true;
+}
+
+bool AsyncSink::Link(const std::string& name,
+                     const std::filesystem::path& source)
+{
+    // The source may still be waiting in the queue, perhaps from another
+    // sink, and linking to it before it is written would link to whatever
+    // was there before.
+    writer.Drain();
+    return sink.Link(name, source);
+}
+
+void AsyncSink::Pin(ByteSpan bytes)
+{
+    if (bytes.size == 0)
+        return;
+
+    std::lock_guard<std::mutex> lock{ mutex };
+    pinned.push_back(bytes);
+}
+
+std::vector<std::string> AsyncSink::Flush()
+{
+    std::vector<std::string> failedNames = writer.Wait(batch);
+    std::lock_guard<std::mutex> lock{ mutex };
+    pinned.clear();
+    return failedNames;
+}
+
+bool AsyncSink::IsPinned(ByteSpan piece)
+{
+    if (piece.size == 0)
+        return true;
+
+    std::lock_guard<std::mutex> lock{ mutex };
+    for (const ByteSpan& bytes : pinned)
+    {
+        if (piece.data >= bytes.data &&
+            piece.data + piece.size <= bytes.data + bytes.size)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
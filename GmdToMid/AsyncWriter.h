@@ -0,0 +1,180 @@
+// AsyncWriter.h - Declares the AsyncWriter and AsyncSink classes.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ASYNC_WRITER_H
+#define ASYNC_WRITER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "OutputSink.h"
+
+/// @brief The number of threads an AsyncWriter writes files on unless
+/// another number is specified.
+inline constexpr size_t asyncWriterDefaultThreads{ 4 };
+
+/// @brief The number of copied bytes that may wait in the queue before
+/// Submit blocks.
+inline constexpr size_t asyncWriterDefaultQueueBytes{ 64 * 1024 * 1024 };
+
+/// @brief Writes files on dedicated threads while the caller carries on.
+///
+/// Completed files are queued with Submit() and handed to their sink by one
+/// of the writer threads, so converting the next track overlaps writing the
+/// last one. This pays off when writing a file blocks for longer than it
+/// takes to convert one, e.g. on a network mounted volume where closing a
+/// file waits for the server to acknowledge it. With several writer threads,
+/// several files can be waiting on the volume at once.
+class AsyncWriter
+{
+public:
+    /// @brief Tracks the files submitted by one sink until they're written.
+    struct Batch
+    {
+        /// @brief The number of files submitted but not yet written.
+        size_t pending{ 0 };
+
+        /// @brief The names of the files that couldn't be written.
+        std::vector<std::string> failedNames;
+    };
+
+    /// @brief Constructor; starts the writer threads.
+    /// @param numThreads The number of files that may be written at once.
+    /// @param maxQueuedBytes The number of copied bytes that may wait in the
+    /// queue before Submit blocks.
+    AsyncWriter(size_t numThreads = asyncWriterDefaultThreads,
+                size_t maxQueuedBytes = asyncWriterDefaultQueueBytes);
+
+    /// @brief Destructor; writes every queued file and joins the threads.
+    ~AsyncWriter();
+
+    AsyncWriter(const AsyncWriter&) = delete;
+    AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+    /// @brief Queues a file to be written.
+    /// @param batch The batch the file belongs to.
+    /// @param sink The sink to write the file to.
+    /// @param name The name of the file.
+    /// @param pieces The pieces of the file, which must stay valid until the
+    /// file has been written.
+    /// @param storage The copies of any pieces that wouldn't have, which the
+    /// writer takes.
+    void Submit(Batch& batch,
+                OutputSink& sink,
+                const std::string& name,
+                std::vector<ByteSpan>&& pieces,
+                std::vector<uint8_t>&& storage);
+
+    /// @brief Blocks until every file in the batch has been written.
+    /// @param batch The batch to wait for.
+    /// @return The names of the files in the batch that couldn't be written,
+    /// which are removed from the batch.
+    std::vector<std::string> Wait(Batch& batch);
+
+    /// @brief Blocks until every file submitted so far has been written.
+    void Drain();
+private:
+    /// @brief Represents a file waiting to be written.
+    struct Job
+    {
+        Batch* batch;
+        OutputSink* sink;
+        std::string name;
+        std::vector<ByteSpan> pieces;
+        std::vector<uint8_t> storage;
+    };
+
+    std::deque<Job> jobs;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable spaceAvailable;
+    std::condition_variable jobFinished;
+    size_t maxQueuedBytes;
+    size_t queuedBytes{ 0 };
+    size_t activeJobs{ 0 };
+    bool stopping{ false };
+    std::vector<std::thread> threads;
+
+    /// @brief The main loop of each writer thread.
+    void WriterLoop();
+};
+
+/// @brief Writes files to another sink through an AsyncWriter.
+///
+/// Write() normally returns before the file is written, and the file is
+/// only known to have been written once Flush() returns, which also reports
+/// the files that couldn't be written.
+///
+/// The pieces of a file are only borrowed, so any that don't lie within
+/// bytes pinned with Pin() are copied into the queue. GmdFile pins the .gmd
+/// file and the setup prelude, so only the MIDI headers and tracks that
+/// were cut or re-encoded are copied.
+class AsyncSink : public OutputSink
+{
+public:
+    /// @brief Constructor; creates a new AsyncSink.
+    /// @param writer The writer to write the files with.
+    /// @param sink The sink the files are written to, which must outlive
+    /// this sink.
+    AsyncSink(AsyncWriter& writer, OutputSink& sink) :
+        writer{ writer }, sink{ sink }
+    { }
+
+    /// @brief Destructor; waits for every file to be written.
+    ~AsyncSink() override;
+
+    AsyncSink(const AsyncSink&) = delete;
+    AsyncSink& operator=(const AsyncSink&) = delete;
+
+    bool Write(const std::string& name,
+               const std::vector<ByteSpan>& pieces) override;
+
+    bool WriteBuffer(const std::string& name,
+                     std::vector<uint8_t>&& buffer) override;
+
+    /// @brief Waits for every queued file to be written, since the source
+    /// may be one of them, then links the file through the sink.
+    bool Link(const std::string& name,
+              const std::filesystem::path& source) override;
+
+    void Pin(ByteSpan bytes) override;
+
+    /// @brief Waits for every file to be written and forgets the bytes
+    /// pinned so far.
+    std::vector<std::string> Flush() override;
+
+    std::string PathOf(const std::string& name) const override
+    {
+        return sink.PathOf(name);
+    }
+private:
+    AsyncWriter& writer;
+    OutputSink& sink;
+    AsyncWriter::Batch batch;
+    std::mutex mutex;
+    std::vector<ByteSpan> pinned;
+
+    /// @brief Determines if a piece lies within the pinned bytes.
+    /// @param piece The piece.
+    /// @return true if the piece is pinned, otherwise false.
+    bool IsPinned(ByteSpan piece);
+};
+
+#endif
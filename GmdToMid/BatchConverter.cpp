@@ -0,0 +1,360 @@
+// BatchConverter.cpp - Defines the BatchConverter class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include "BatchConverter.h"
+#include "GmdFile.h"
+#include "WorkerPool.h"
+
+bool BatchConverter::AddInput(const std::string& input)
+{
+    size_t numFilesBefore = files.size();
+    std::filesystem::path inputPath{ input };
+    std::error_code error;
+
+    if (!IsGlob(input))
+    {
+        if (std::filesystem::is_directory(inputPath, error))
+            AddDirectory(inputPath, "", true);
+        else if (std::filesystem::is_regular_file(inputPath, error))
+            files.push_back(inputPath);
+    }
+    else
+    {
+        std::string pattern = inputPath.filename().string();
+        std::filesystem::path directory = inputPath.parent_path();
+        bool recursive{ false };
+
+        // A ** directory component means "this directory and everything
+        // beneath it", which is the only place we allow a wildcard outside
+        // of the file name.
+        if (directory.filename() == "**")
+        {
+            recursive = true;
+            directory = directory.parent_path();
+        }
+
+        if (IsGlob(directory.string()))
+        {
+            std::cerr << "Wildcards are only supported in the file name: "
+                      << input << std::endl;
+            return false;
+        }
+
+        if (directory.empty())
+            directory = ".";
+
+        if (std::filesystem::is_directory(directory, error))
+            AddDirectory(directory, pattern, recursive);
+    }
+
+    if (files.size() == numFilesBefore)
+    {
+        std::cerr << "No .gmd files found matching: " << input << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+std::vector<std::filesystem::path> BatchConverter::Files() const
+{
+    // The same file can be reached through more than one input, e.g. a
+    // directory and a glob inside it, so we only list each file once.
+    std::vector<std::filesystem::path> uniqueFiles;
+    for (const auto& file : files)
+        uniqueFiles.push_back(file.lexically_normal());
+    std::sort(uniqueFiles.begin(), uniqueFiles.end());
+    uniqueFiles.erase(std::unique(uniqueFiles.begin(), uniqueFiles.end()), 
+                      uniqueFiles.end());
+    return uniqueFiles;
+}
+
+bool BatchConverter::Run()
+{
+    files = Files();
+    if (!CheckOutputNames())
+    {
+        stats.clear();
+        numFailed = files.size();
+        return false;
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    std::atomic<size_t> numSucceeded{ 0 };
+    std::vector<std::filesystem::path> failedFiles;
+    std::mutex outputMutex;
+
+    // Each worker writes only to the slot of its own file, so the stats can
+    // be collected without holding the output lock.
+    stats.assign(files.size(), ConversionStats{});
+
+    {
+        ConversionOptions batchOptions{ options };
+        WorkerPool pool{ numWorkers };
+        std::cout << "Converting " << files.size() << " files using "
+                  << pool.Size() << " workers..." << std::endl << std::endl;
+
+        // The workers share the hardware when they export tracks in 
+        // parallel too.
+        batchOptions.trackWorkers = NestedWorkerCount(pool.Size());
+
+        for (size_t fileNum = 0; fileNum < files.size(); fileNum++)
+        {
+            pool.Submit([&, fileNum]
+            {
+                const std::filesystem::path& file = files[fileNum];
+                bool succeeded{ false };
+                std::string errorMessage;
+                try
+                {
+                    GmdFile gmd{ file.string(), 
+                                 BatchOptionsFor(batchOptions, file) };
+                    succeeded = gmd.Convert();
+                    stats[fileNum] = gmd.Stats();
+                    errorMessage = gmd.Error();
+                }
+                catch (const std::exception& e)
+                {
+                    errorMessage = e.what();
+                    stats[fileNum].fileName = file.string();
+                }
+
+                std::lock_guard<std::mutex> lock{ outputMutex };
+                if (succeeded)
+                {
+                    numSucceeded++;
+                    std::cout << (stats[fileNum].inputsSkipped > 0 ? 
+                                  "[SKIP]   " : "[OK]     ") 
+                              << file.string() << '\n';
+                }
+                else
+                {
+                    failedFiles.push_back(file);
+                    std::cout << "[FAILED] " << file.string();
+                    if (!errorMessage.empty())
+                        std::cout << " (" << errorMessage << ")";
+                    std::cout << '\n';
+                }
+            });
+        }
+
+        pool.Wait();
+    }
+
+    auto elapsed = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - startTime);
+    wallSeconds = elapsed.count();
+    numFailed = failedFiles.size();
+    std::sort(failedFiles.begin(), failedFiles.end());
+
+    ConversionStats totals;
+    for (const auto& fileStats : stats)
+        totals.Add(fileStats);
+
+    std::cout << std::endl
+              << "Batch Summary" << std::endl
+              << "--------------------" << std::endl
+              << "Files     : " << files.size() << std::endl
+              << "Converted : " << numSucceeded.load() << std::endl
+              << "Failed    : " << numFailed << std::endl
+              << "Read      : " << totals.bytesRead << " bytes" << std::endl
+              << "Written   : " << totals.bytesWritten << " bytes" << std::endl
+              << "Time      : " << std::fixed << std::setprecision(3)
+              << wallSeconds << "s" << std::endl;
+    if (options.dedup != nullptr)
+    {
+        std::cout << "Duplicates: " << totals.tracksDeduplicated 
+                  << " tracks, " << totals.bytesDeduplicated << " bytes" 
+                  << std::endl;
+    }
+    if (options.optimize)
+    {
+        std::cout << "Optimized : " << totals.bytesOptimized << " bytes "
+                  << "saved" << std::endl;
+    }
+    if (options.incremental != nullptr)
+    {
+        std::cout << "Skipped   : " << totals.inputsSkipped << " up to date, "
+                  << totals.orphansRemoved << " orphans removed" 
+                  << std::endl;
+    }
+    if (options.cache != nullptr)
+    {
+        std::cout << "Cache     : " << totals.cacheHits << " hits, " 
+                  << totals.cacheMisses << " misses" << std::endl;
+    }
+    std::cout << std::endl;
+
+    for (const auto& file : failedFiles)
+        std::cerr << "Failed to convert: " << file.string() << std::endl;
+
+    return numFailed == 0;
+}
+
+bool BatchConverter::CheckOutputNames() const
+{
+    // The .mid files are named after the stem of the .gmd, so two inputs 
+    // with the same stem that write to the same directory would overwrite
+    // each other's files, at the same time if they ran on different workers.
+    std::map<std::filesystem::path, std::filesystem::path> inputsByOutput;
+    bool unique{ true };
+    for (const auto& file : files)
+    {
+        std::filesystem::path output = 
+            (BatchOptionsFor(options, file).outputDirectory / file.stem())
+            .lexically_normal();
+        auto [existing, inserted] = inputsByOutput.emplace(output, file);
+        if (!inserted)
+        {
+            std::cerr << file.string() << " and " 
+                      << existing->second.string() << " would both be "
+                      << "converted to " << output.string() << "*.mid" 
+                      << std::endl;
+            unique = false;
+        }
+    }
+
+    if (!unique)
+    {
+        std::cerr << "Nothing was converted. Convert the files with the same "
+                  << "name separately, or without --output so that each is "
+                  << "converted next to its .gmd file." << std::endl;
+    }
+
+    return unique;
+}
+
+void BatchConverter::AddDirectory(const std::filesystem::path& directory,
+                                  const std::string& pattern,
+                                  bool recursive)
+{
+    auto isMatch = [&pattern](const std::filesystem::path& file)
+    {
+        if (!pattern.empty())
+            return MatchesGlob(pattern, file.filename().string());
+        return HasGmdExtension(file);
+    };
+
+    auto dirOptions = std::filesystem::directory_options::skip_permission_denied;
+    std::error_code error;
+
+    if (recursive)
+    {
+        std::filesystem::recursive_directory_iterator it{ directory,
+                                                          dirOptions,
+                                                          error };
+        for (; !error && it != std::filesystem::recursive_directory_iterator{};
+             it.increment(error))
+        {
+            if (it->is_regular_file(error) && isMatch(it->path()))
+                files.push_back(it->path());
+        }
+    }
+    else
+    {
+        std::filesystem::directory_iterator it{ directory, dirOptions, error };
+        for (; !error && it != std::filesystem::directory_iterator{};
+             it.increment(error))
+        {
+            if (it->is_regular_file(error) && isMatch(it->path()))
+                files.push_back(it->path());
+        }
+    }
+
+    if (error)
+    {
+        std::cerr << "Error reading directory " << directory.string() << ": "
+                  << error.message() << std::endl;
+    }
+}
+
+ConversionOptions BatchOptionsFor(const ConversionOptions& options,
+                                  const std::filesystem::path& file)
+{
+    // Unless the user asked for a single output directory, the .mid files
+    // are written next to their .gmd so that files with the same name in
+    // different directories don't overwrite each other. With one, the batch
+    // checks that no two files have the same name first.
+    ConversionOptions fileOptions{ options };
+
+    // Several files are converted at once, so each error is reported on the
+    // line of its file rather than printed as it happens, where it could be
+    // cut into by the lines of other files.
+    fileOptions.printErrors = false;
+    if (fileOptions.outputDirectory.empty())
+        fileOptions.outputDirectory = file.parent_path();
+    return fileOptions;
+}
+
+bool HasGmdExtension(const std::filesystem::path& file)
+{
+    std::string extension = file.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    return extension == gmdExtension;
+}
+
+bool MatchesGlob(const std::string& pattern, const std::string& name)
+{
+    // Iterative wildcard matching with single-star backtracking, which runs
+    // in O(pattern * name) in the worst case without recursion.
+    size_t p{ 0 };
+    size_t n{ 0 };
+    size_t starPos{ std::string::npos };
+    size_t starMatch{ 0 };
+
+    while (n < name.size())
+    {
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n]))
+        {
+            p++;
+            n++;
+        }
+        else if (p < pattern.size() && pattern[p] == '*')
+        {
+            starPos = p++;
+            starMatch = n;
+        }
+        else if (starPos != std::string::npos)
+        {
+            p = starPos + 1;
+            n = ++starMatch;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    while (p < pattern.size() && pattern[p] == '*')
+        p++;
+
+    return p == pattern.size();
+}
+
+bool IsGlob(const std::string& input)
+{
+    return input.find_first_of("*?") != std::string::npos;
+}
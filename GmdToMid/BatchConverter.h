@@ -0,0 +1,123 @@
+// BatchConverter.h - Declares the BatchConverter class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BATCH_CONVERTER_H
+#define BATCH_CONVERTER_H
+
+#include <string>
+#include <vector>
+#include <filesystem>
+#include "ConversionOptions.h"
+#include "ConversionStats.h"
+
+/// @brief The file extension used to find .gmd files inside directories.
+inline const char* gmdExtension{ ".gmd" };
+
+/// @brief Converts many .gmd files concurrently on a pool of workers.
+///
+/// Inputs may be individual files, directories (which are searched
+/// recursively for .gmd files), or glob patterns. Glob patterns support the
+/// * and ? wildcards in the final path component, and a ** component to
+/// match any number of subdirectories.
+class BatchConverter
+{
+public:
+    /// @brief Constructor; creates a new BatchConverter.
+    /// @param options The options to convert each file with.
+    /// @param numWorkers The number of workers, or 0 to match the hardware.
+    BatchConverter(ConversionOptions options, size_t numWorkers) :
+        options{ options }, numWorkers{ numWorkers }, numFailed{ 0 }
+    { }
+
+    /// @brief Adds a file, directory, or glob pattern to the batch.
+    /// @param input The input to add.
+    /// @return true if the input matched at least one file, otherwise false.
+    bool AddInput(const std::string& input);
+
+    /// @brief Converts every file in the batch and prints a summary.
+    /// @return true if every file converted successfully, otherwise false.
+    ///
+    /// Nothing is converted if two files would write .mid files with the
+    /// same names.
+    bool Run();
+
+    /// @brief Gets the number of files that have been added to the batch.
+    /// @return The number of files in the batch.
+    size_t NumFiles() const { return files.size(); }
+
+    /// @brief Gets every file in the batch, sorted and without duplicates.
+    /// @return The files in the batch.
+    std::vector<std::filesystem::path> Files() const;
+
+    /// @brief Gets the number of files that failed to convert.
+    /// @return The number of failed files.
+    size_t NumFailed() const { return numFailed; }
+
+    /// @brief Gets the stats of every file converted by the last Run().
+    /// @return The stats of each file, in the same order as Files().
+    const std::vector<ConversionStats>& Stats() const { return stats; }
+
+    /// @brief Gets the wall clock time taken by the last Run().
+    /// @return The elapsed time in seconds.
+    double WallSeconds() const { return wallSeconds; }
+private:
+    ConversionOptions options;
+    size_t numWorkers;
+    size_t numFailed;
+    std::vector<std::filesystem::path> files;
+    std::vector<ConversionStats> stats;
+    double wallSeconds{ 0 };
+
+    /// @brief Checks that no two files in the batch write .mid files with 
+    /// the same names, printing each pair that would.
+    /// @return true if every file writes its own .mid files.
+    bool CheckOutputNames() const;
+
+    /// @brief Adds every .gmd file found beneath the specified directory.
+    /// @param directory The directory to search.
+    /// @param pattern The file name pattern to match, or empty for .gmd.
+    /// @param recursive Determines if subdirectories are searched.
+    void AddDirectory(const std::filesystem::path& directory,
+                      const std::string& pattern,
+                      bool recursive);
+};
+
+/// @brief Determines the options to use when converting a file in a batch.
+/// @param options The options of the batch.
+/// @param file The file to be converted.
+/// @return The options for the file, which write the .mid files next to the
+/// .gmd unless the batch has an output directory, and leave printing the 
+/// error of a file that fails to the caller.
+ConversionOptions BatchOptionsFor(const ConversionOptions& options,
+                                  const std::filesystem::path& file);
+
+/// @brief Determines if a file has the .gmd extension, in any case.
+/// @param file The path of the file.
+/// @return true if the file is a .gmd file, otherwise false.
+bool HasGmdExtension(const std::filesystem::path& file);
+
+/// @brief Determines if a file name matches a glob pattern.
+/// @param pattern The pattern, which may contain * and ? wildcards.
+/// @param name The file name to test.
+/// @return true if the name matches the pattern, otherwise false.
+bool MatchesGlob(const std::string& pattern, const std::string& name);
+
+/// @brief Determines if the specified input contains glob wildcards.
+/// @param input The input to test.
+/// @return true if the input contains wildcards, otherwise false.
+bool IsGlob(const std::string& input);
+
+#endif
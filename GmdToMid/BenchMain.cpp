@@ -0,0 +1,1335 @@
+// BenchMain.cpp - Defines the entry point of the benchmark program.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "AsyncWriter.h"
+#include "ChunkIndex.h"
+#include "CmdLine.h"
+#include "ConversionClient.h"
+#include "EventScanner.h"
+#include "EventStore.h"
+#include "GmdFile.h"
+#include "MappedFile.h"
+#include "MidiEvent.h"
+#include "MidiFile.h"
+#include "StreamConverter.h"
+#include "SyntheticGmd.h"
+#include "TrackOptimizer.h"
+#include "TrackStats.h"
+
+/// @brief The minimum time each benchmark is repeated for, in seconds.
+inline constexpr double benchDefaultMinSeconds{ 0.5 };
+
+/// @brief The number of bytes in a megabyte, for reporting throughput.
+inline constexpr double benchBytesPerMB{ 1024.0 * 1024.0 };
+
+/// @brief The number of requests a load test sends unless another number
+/// is specified.
+inline constexpr size_t benchDefaultLoadRequests{ 1000 };
+
+/// @brief The number of connections a load test sends requests over unless
+/// another number is specified.
+inline constexpr size_t benchDefaultLoadConnections{ 4 };
+
+/// @brief The case a load test sends unless another is specified.
+inline const char* benchDefaultLoadCase{ "small" };
+
+/// @brief The number of corrupted copies of the first track of each 
+/// synthetic case that --scan-check compares the scanner and the decoder on.
+inline constexpr size_t benchScanCheckCorruptions{ 64 };
+
+/// @brief The number of tracks of random events --scan-check compares the
+/// scanner and the decoder on.
+inline constexpr size_t benchScanCheckRandomTracks{ 65536 };
+
+/// @brief Describes a synthetic input to run every benchmark against.
+struct BenchCase
+{
+    /// @brief The name of the case, used in the results and file names.
+    std::string name;
+
+    /// @brief The shape of the synthetic .gmd file.
+    SyntheticGmdOptions options;
+
+    /// @brief Determines if the case only runs when --stress is specified.
+    bool stress{ false };
+};
+
+/// @brief Holds the result of repeating a single benchmark.
+struct BenchResult
+{
+    /// @brief The number of times the benchmark ran.
+    size_t iterations{ 0 };
+
+    /// @brief The total time taken by every iteration, in seconds.
+    double seconds{ 0 };
+
+    /// @brief The number of bytes processed by a single iteration.
+    size_t bytes{ 0 };
+
+    /// @brief The number of files processed by a single iteration.
+    size_t files{ 0 };
+
+    /// @brief Determines if every iteration succeeded.
+    bool succeeded{ true };
+};
+
+/// @brief Writes files to another sink, taking longer over each one.
+///
+/// This stands in for a network mounted volume, where closing a file waits
+/// for the server to acknowledge it, so that --write-latency can show what
+/// writing in the background saves there.
+class LatentSink : public OutputSink
+{
+public:
+    /// @brief Constructor; creates a new LatentSink.
+    /// @param sink The sink to write the files to.
+    /// @param latency The extra time each file takes to write.
+    LatentSink(OutputSink& sink, std::chrono::microseconds latency) :
+        sink{ sink }, latency{ latency }
+    { }
+
+    bool Write(const std::string& name, 
+               const std::vector<ByteSpan>& pieces) override
+    {
+        bool written = sink.Write(name, pieces);
+        std::this_thread::sleep_for(latency);
+        return written;
+    }
+
+    std::string PathOf(const std::string& name) const override
+    {
+        return sink.PathOf(name);
+    }
+private:
+    OutputSink& sink;
+    std::chrono::microseconds latency;
+};
+
+/// @brief Gets the inputs the benchmarks run against, from smallest to largest.
+/// @return The benchmark cases.
+static std::vector<BenchCase> BenchCases()
+{
+    auto makeCase = [](std::string name, size_t numTracks, size_t trackSize,
+                       size_t numUnknownChunks, size_t unknownChunkSize,
+                       size_t eventDensity, bool stress)
+    {
+        BenchCase benchCase;
+        benchCase.name = name;
+        benchCase.options.numTracks = numTracks;
+        benchCase.options.trackSize = trackSize;
+        benchCase.options.numUnknownChunks = numUnknownChunks;
+        benchCase.options.unknownChunkSize = unknownChunkSize;
+        benchCase.options.eventDensity = eventDensity;
+        benchCase.stress = stress;
+        return benchCase;
+    };
+
+    return {
+        makeCase("tiny", 2, 256, 1, 16, 4, false),
+        makeCase("small", 8, 8 * 1024, 4, 256, 4, false),
+        makeCase("dense", 8, 8 * 1024, 4, 256, 0, false),
+        makeCase("chunky", 4, 1024, 256, 4 * 1024, 4, false),
+        makeCase("medium", 16, 256 * 1024, 8, 4 * 1024, 8, false),
+        makeCase("large", 16, 2 * 1024 * 1024, 16, 64 * 1024, 8, false),
+        makeCase("stress", 64, 4 * 1024 * 1024, 64, 1024 * 1024, 8, true)
+    };
+}
+
+/// @brief Repeats a benchmark until it has run for at least minSeconds.
+/// @param minSeconds The minimum time to repeat the benchmark for.
+/// @param run The benchmark, which returns false if it failed.
+/// @param result The result to record the iterations and time in.
+static void Repeat(double minSeconds, 
+                   const std::function<bool()>& run, 
+                   BenchResult& result)
+{
+    auto start = std::chrono::steady_clock::now();
+    do
+    {
+        result.succeeded &= run();
+        result.iterations++;
+        result.seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+    } while (result.succeeded && result.seconds < minSeconds);
+}
+
+/// @brief Prints the header of the results table.
+static void PrintResultsHeader()
+{
+    std::cout << std::left << std::setw(8) << "Case"
+              << std::setw(15) << "Stage" << std::right
+              << std::setw(12) << "Size (KB)"
+              << std::setw(8) << "Runs"
+              << std::setw(12) << "MB/s"
+              << std::setw(12) << "files/s" << '\n'
+              << std::string(67, '-') << '\n';
+}
+
+/// @brief Prints a row of the results table.
+/// @param caseName The name of the benchmark case.
+/// @param stage The name of the stage that was measured.
+/// @param result The result of the benchmark.
+static void PrintResult(const std::string& caseName, 
+                        const std::string& stage, 
+                        const BenchResult& result)
+{
+    double seconds = result.seconds > 0 ? result.seconds : 1e-9;
+    double mbPerSecond = result.bytes * result.iterations / 
+                         benchBytesPerMB / seconds;
+    double filesPerSecond = result.files * result.iterations / seconds;
+
+    std::cout << std::left << std::setw(8) << caseName
+              << std::setw(15) << stage << std::right << std::fixed
+              << std::setw(12) << std::setprecision(1) 
+              << result.bytes / 1024.0
+              << std::setw(8) << result.iterations
+              << std::setw(12) << std::setprecision(1) << mbPerSecond
+              << std::setw(12) << std::setprecision(1) << filesPerSecond;
+    if (!result.succeeded)
+        std::cout << "  FAILED";
+    std::cout << std::endl;
+}
+
+/// @brief Gets the scan paths the CPU supports, from slowest to fastest.
+/// @return The scan paths.
+static std::vector<ScanPath> SupportedScanPaths()
+{
+    std::vector<ScanPath> paths;
+    for (ScanPath path : { ScanPath::Scalar, ScanPath::Sse2, ScanPath::Avx2 })
+    {
+        if (ScanPathSupported(path))
+            paths.push_back(path);
+    }
+    return paths;
+}
+
+/// @brief Checks that every supported scan path finds exactly what the
+/// decoder does in a track.
+/// @param track The track data.
+/// @param name The name of the track, used in messages.
+/// @return true if the scanner and the decoder agree, otherwise false.
+static bool CheckScan(ByteSpan track, const std::string& name)
+{
+    std::vector<uint32_t> offsets;
+    EventCursor cursor{ track };
+    MidiEvent event;
+    while (cursor.Next(event))
+        offsets.push_back(event.offset);
+
+    bool agreed{ true };
+    for (ScanPath path : SupportedScanPaths())
+    {
+        EventScanner scanner{ path };
+        bool scanned = scanner.Scan(track);
+        if (scanned != !cursor.HasError() || scanner.Error() != cursor.Error()
+            || scanner.ReachedEndOfTrack() != cursor.ReachedEndOfTrack() ||
+            (scanned && scanner.Offsets() != offsets))
+        {
+            std::cerr << name << ": the " << ScanPathName(path) 
+                      << " scan found " << scanner.NumEvents() << " events ("
+                      << (scanned ? "no error" : scanner.Error()) 
+                      << ") where the decoder found " << offsets.size() 
+                      << " (" << (cursor.HasError() ? cursor.Error() : 
+                                                      "no error")
+                      << ")" << std::endl;
+            agreed = false;
+        }
+    }
+
+    return agreed;
+}
+
+/// @brief Replaces the contents of a buffer with a short track of random
+/// events, a few of which are malformed.
+/// @param buffer The buffer to fill.
+/// @param random The random number generator for the events.
+static void AppendRandomEvents(std::vector<uint8_t>& buffer, 
+                               std::mt19937& random)
+{
+    // Writes a variable length quantity of 1 to 4 bytes, or rarely 5.
+    auto appendVarLen = [&](uint32_t value)
+    {
+        size_t numBytes = random() % 64 == 0 ? 5 : 1 + random() % 4;
+        for (size_t i = numBytes - 1; i > 0; i--)
+            buffer.push_back(static_cast<uint8_t>(0x80 | (value >> (7 * i))));
+        buffer.push_back(value & 0x7F);
+    };
+
+    buffer.clear();
+    size_t numEvents = random() % 24;
+    uint8_t runningStatus{ 0 };
+    for (size_t i = 0; i < numEvents; i++)
+    {
+        appendVarLen(random() % 200);
+        uint8_t status{ 0 };
+        switch (random() % 10)
+        {
+            case 0:
+                status = midiMeta;
+                break;
+            case 1:
+                status = random() % 2 == 0 ? midiSysEx : midiSysExEscape;
+                break;
+            case 2:
+                // A status byte no track may contain.
+                status = static_cast<uint8_t>(0xF1 + random() % 14);
+                break;
+            default:
+                status = static_cast<uint8_t>(0x80 + random() % 0x70);
+                break;
+        }
+
+        if (status < midiSysEx)
+        {
+            // Leave out the status to use running status, sometimes when
+            // there isn't one.
+            if (random() % 2 == 0 && (runningStatus != 0 || 
+                                      random() % 8 == 0))
+            {
+                if (runningStatus != 0)
+                    status = runningStatus;
+            }
+            else
+            {
+                buffer.push_back(status);
+            }
+            runningStatus = status;
+            for (uint32_t j = ChannelEventDataLength(status); j > 0; j--)
+                buffer.push_back(static_cast<uint8_t>(random() % 128));
+            continue;
+        }
+
+        if (random() % 16 == 0)
+            continue;
+        buffer.push_back(status);
+        if (status == midiMeta)
+        {
+            buffer.push_back(random() % 4 == 0 ? midiMetaEndOfTrack : 
+                                                 midiMetaText);
+        }
+        if (status == midiMeta || status == midiSysEx || 
+            status == midiSysExEscape)
+        {
+            uint32_t length = random() % 8 == 0 ? 128 + random() % 64 : 
+                                                  random() % 8;
+            appendVarLen(length);
+            for (uint32_t j = 0; j < length; j++)
+                buffer.push_back(static_cast<uint8_t>(random()));
+        }
+    }
+}
+
+/// @brief Checks the scanner against the decoder on the tracks of the 
+/// synthetic cases, corrupted copies of them, random tracks, and the .gmd 
+/// files at a path.
+/// @param path A .gmd file or a directory to search for them.
+/// @return true if the scanner and the decoder always agree.
+static bool RunScanCheck(const std::filesystem::path& path)
+{
+    std::mt19937 random{ 1 };
+    size_t numTracks{ 0 };
+    bool agreed{ true };
+    for (const BenchCase& benchCase : BenchCases())
+    {
+        if (benchCase.stress)
+            continue;
+
+        std::vector<uint8_t> gmdData = GenerateSyntheticGmd(benchCase.options);
+        ChunkIndex index;
+        index.Build(ByteSpan{ gmdData.data(), gmdData.size() });
+        for (size_t trackNum = 0; trackNum < index.NumTracks(); trackNum++)
+        {
+            ByteSpan track = index.Track(trackNum).data;
+            std::string name = benchCase.name + " track " + 
+                               std::to_string(trackNum);
+            agreed &= CheckScan(track, name);
+            numTracks++;
+
+            // Corrupt a few bytes of the first track, favouring ones with
+            // their top bit set since those change the shape of the events,
+            // and cut the track short every other time.
+            std::vector<uint8_t> corrupted;
+            for (size_t i = 0; trackNum == 0 && 
+                               i < benchScanCheckCorruptions; i++)
+            {
+                corrupted.assign(track.data, track.data + track.size);
+                for (size_t j = 1 + random() % 3; j > 0; j--)
+                {
+                    uint8_t value = static_cast<uint8_t>(random());
+                    corrupted[random() % corrupted.size()] = 
+                        random() % 2 == 0 ? value | 0x80 : value;
+                }
+                if (i % 2 == 1)
+                    corrupted.resize(random() % corrupted.size());
+
+                agreed &= CheckScan(ByteSpan{ corrupted.data(), 
+                                              corrupted.size() },
+                                    name + " corruption " + 
+                                    std::to_string(i));
+                numTracks++;
+            }
+        }
+    }
+
+    // Short tracks of random events, every so often malformed, and cut
+    // short every other time, so that every check the decoder makes fails
+    // somewhere.
+    std::vector<uint8_t> randomTrack;
+    for (size_t i = 0; i < benchScanCheckRandomTracks; i++)
+    {
+        AppendRandomEvents(randomTrack, random);
+        if (i % 2 == 1 && !randomTrack.empty())
+            randomTrack.resize(random() % randomTrack.size());
+        agreed &= CheckScan(ByteSpan{ randomTrack.data(), 
+                                      randomTrack.size() },
+                            "random track " + std::to_string(i));
+        numTracks++;
+    }
+
+    std::vector<std::filesystem::path> files;
+    std::error_code error;
+    bool searched = std::filesystem::is_directory(path, error);
+    if (searched)
+    {
+        for (const auto& entry : 
+             std::filesystem::recursive_directory_iterator{ path, error })
+        {
+            std::string extension = entry.path().extension().string();
+            std::transform(extension.begin(), extension.end(), 
+                           extension.begin(), ::tolower);
+            if (entry.is_regular_file(error) && extension == ".gmd")
+                files.push_back(entry.path());
+        }
+    }
+    else
+    {
+        files.push_back(path);
+    }
+
+    for (const std::filesystem::path& file : files)
+    {
+        MappedFile mappedFile{ file.string() };
+        ChunkIndex index;
+        if (!mappedFile.Open() || !index.Build(mappedFile.Data()))
+        {
+            // A directory of game files may well hold broken ones, which
+            // have nothing to compare, but a file named on its own should
+            // be readable.
+            std::cerr << "Unable to read " << file.string() << std::endl;
+            agreed &= searched;
+            continue;
+        }
+
+        for (size_t trackNum = 0; trackNum < index.NumTracks(); trackNum++)
+        {
+            agreed &= CheckScan(index.Track(trackNum).data, file.string() + 
+                                " track " + std::to_string(trackNum));
+            numTracks++;
+        }
+    }
+
+    std::cout << "Compared " << numTracks << " tracks from " << files.size()
+              << " files on the scan paths:";
+    for (ScanPath scanPath : SupportedScanPaths())
+        std::cout << ' ' << ScanPathName(scanPath);
+    std::cout << '\n' << (agreed ? "The scanner and the decoder agree." : 
+                                   "The scanner and the decoder DISAGREE.")
+              << std::endl;
+    return agreed;
+}
+
+/// @brief Describes a channel event that must or must not be part of the
+/// setup a transition track starts with.
+struct SetupCheckEvent
+{
+    /// @brief The status and data bytes of the event.
+    std::vector<uint8_t> bytes;
+
+    /// @brief Determines if the event must be part of the setup, rather 
+    /// than must not be.
+    bool expected{ true };
+};
+
+/// @brief Builds a .gmd file whose first track changes its setup once the
+/// music has started, for --setup-check.
+/// @return The .gmd file.
+///
+/// Channel 0 is set up at tick 0 and faded out and given another program 
+/// at tick 960, after it has played a note. Channel 1 is only set up at 
+/// tick 960, right before its first note. The second track is a transition
+/// that plays on both channels.
+static std::vector<uint8_t> SetupCheckGmd()
+{
+    const std::vector<uint8_t> mainTrack = {
+        0x00, 0xC0, 0x05,
+        0x00, 0xB0, 0x07, 0x64,
+        0x00, 0x90, 0x3C, 0x64,
+        0x83, 0x60, 0x90, 0x3C, 0x00,
+        0x83, 0x60, 0xB0, 0x07, 0x00,
+        0x00, 0xC0, 0x21,
+        0x00, 0xC1, 0x10,
+        0x00, 0xB1, 0x07, 0x50,
+        0x00, 0x91, 0x40, 0x64,
+        0x81, 0x70, 0x91, 0x40, 0x00,
+        0x00, midiMeta, midiMetaEndOfTrack, 0x00
+    };
+    const std::vector<uint8_t> transitionTrack = {
+        0x00, 0x90, 0x3E, 0x50,
+        0x00, 0x91, 0x43, 0x50,
+        0x81, 0x70, 0x90, 0x3E, 0x00,
+        0x00, 0x91, 0x43, 0x00,
+        0x00, midiMeta, midiMetaEndOfTrack, 0x00
+    };
+
+    std::vector<uint8_t> gmdData;
+    auto appendChunk = [&gmdData](const char* id, 
+                                  const std::vector<uint8_t>& data)
+    {
+        uint8_t header[chunkHeaderSize];
+        std::copy(id, id + 4, header);
+        WriteUInt32BE(header + 4, static_cast<uint32_t>(data.size()));
+        gmdData.insert(gmdData.end(), header, header + chunkHeaderSize);
+        gmdData.insert(gmdData.end(), data.begin(), data.end());
+    };
+
+    std::vector<uint8_t> headerData(midiHeaderDataSize);
+    WriteUInt16BE(headerData.data(), midiType2ID);
+    WriteUInt16BE(headerData.data() + 2, 2);
+    WriteUInt16BE(headerData.data() + 4, 480);
+    appendChunk(gmdHeaderID, {});
+    appendChunk(midiHeaderID, headerData);
+    appendChunk(midiTrackID, mainTrack);
+    appendChunk(midiTrackID, transitionTrack);
+    WriteUInt32BE(gmdData.data() + 4, 
+                  static_cast<uint32_t>(gmdData.size() - chunkHeaderSize));
+    return gmdData;
+}
+
+/// @brief Finds a track within a .mid file.
+/// @param midiData The .mid file.
+/// @param trackNum The number of the track.
+/// @param track Set to the data of the track.
+/// @return true if the file has the track, otherwise false.
+static bool FindMidiTrack(const std::vector<uint8_t>& midiData, 
+                          size_t trackNum,
+                          ByteSpan& track)
+{
+    ByteSpan file{ midiData.data(), midiData.size() };
+    size_t offset = chunkHeaderSize + midiHeaderDataSize;
+    for (size_t i = 0; file.Contains(offset, chunkHeaderSize); i++)
+    {
+        size_t size = ReadUInt32BE(file.data + offset + 4);
+        track = file.Subspan(offset + chunkHeaderSize, size);
+        if (i == trackNum)
+            return track.data != nullptr;
+        offset += chunkHeaderSize + size;
+    }
+
+    return false;
+}
+
+/// @brief Checks the setup a track of a .mid file starts with, i.e. the 
+/// channel events before its first note.
+/// @param midiData The .mid file.
+/// @param trackNum The number of the track within the file.
+/// @param events The events that must and must not be part of the setup.
+/// @param name The name of the track, used in messages.
+/// @return true if the setup is as expected, otherwise false.
+static bool CheckSetup(const std::vector<uint8_t>& midiData,
+                       size_t trackNum,
+                       const std::vector<SetupCheckEvent>& events,
+                       const std::string& name)
+{
+    ByteSpan track;
+    EventArena arena;
+    EventStore store;
+    if (!FindMidiTrack(midiData, trackNum, track) || 
+        !store.Decode(track, arena))
+    {
+        std::cerr << name << ": unable to read the track" << std::endl;
+        return false;
+    }
+
+    std::vector<std::vector<uint8_t>> setup;
+    for (size_t i = 0; i < store.Size(); i++)
+    {
+        if ((store.Status(i) & 0xF0) == midiNoteOn)
+            break;
+
+        std::vector<uint8_t> bytes{ store.Status(i) };
+        ByteSpan data = store.Data(i);
+        bytes.insert(bytes.end(), data.data, data.data + data.size);
+        setup.push_back(bytes);
+    }
+
+    bool matched{ true };
+    for (const SetupCheckEvent& event : events)
+    {
+        bool found = std::find(setup.begin(), setup.end(), event.bytes) != 
+                     setup.end();
+        if (found != event.expected)
+        {
+            std::cerr << name << ": the setup " 
+                      << (event.expected ? "lacks" : "has") << " the event";
+            for (uint8_t byte : event.bytes)
+            {
+                std::cerr << ' ' << std::hex << std::setw(2) 
+                          << std::setfill('0') << static_cast<int>(byte);
+            }
+            std::cerr << std::dec << std::setfill(' ') << std::endl;
+            matched = false;
+        }
+    }
+
+    return matched;
+}
+
+/// @brief Checks that transition tracks get the setup of the first track
+/// from both converters, and not the state the first track ends in.
+/// @return true if every check passed, otherwise false.
+static bool RunSetupCheck()
+{
+    std::vector<uint8_t> gmdData = SetupCheckGmd();
+    const std::vector<SetupCheckEvent> setupEvents = {
+        { { 0xC0, 0x05 }, true },
+        { { 0xB0, 0x07, 0x64 }, true },
+        { { 0xC1, 0x10 }, true },
+        { { 0xB1, 0x07, 0x50 }, true },
+        { { 0xC0, 0x21 }, false },
+        { { 0xB0, 0x07, 0x00 }, false }
+    };
+
+    ConversionOptions options;
+    options.verbose = false;
+    options.propagateSetup = true;
+
+    bool passed{ true };
+    for (bool optimize : { false, true })
+    {
+        options.optimize = optimize;
+        std::string variant = optimize ? " (optimized)" : "";
+
+        MemorySink fileSink;
+        GmdFile gmd{ ByteSpan{ gmdData.data(), gmdData.size() }, 
+                     "setup.gmd", options };
+        std::vector<MemorySink::Output> fileOutputs;
+        if (gmd.Convert(fileSink))
+            fileOutputs = fileSink.TakeOutputs();
+
+        MemorySink streamSink;
+        std::istringstream input{ std::string{ gmdData.begin(), 
+                                               gmdData.end() } };
+        StreamConverter converter{ input, "setup.gmd", options };
+        std::vector<MemorySink::Output> streamOutputs;
+        if (converter.Convert(streamSink))
+            streamOutputs = streamSink.TakeOutputs();
+
+        const std::pair<const char*, const std::vector<MemorySink::Output>*>
+            converters[] = { { "file", &fileOutputs }, 
+                             { "stream", &streamOutputs } };
+        for (const auto& [converterName, converterOutputs] : converters)
+        {
+            const std::vector<MemorySink::Output>& outputs = *converterOutputs;
+            auto transition = std::find_if(outputs.begin(), outputs.end(), 
+                [](const MemorySink::Output& output)
+                {
+                    return output.name == "setup-1.mid";
+                });
+            if (transition == outputs.end())
+            {
+                std::cerr << converterName << variant 
+                          << ": the transition track wasn't exported" 
+                          << std::endl;
+                passed = false;
+                continue;
+            }
+
+            passed &= CheckSetup(transition->data, 0, setupEvents, 
+                                 std::string{ converterName } + variant + 
+                                 " setup-1.mid");
+        }
+    }
+
+    std::cout << (passed ? "Transition tracks get the setup of the first "
+                           "track." : 
+                           "Transition tracks DON'T get the setup of the "
+                           "first track.")
+              << std::endl;
+    return passed;
+}
+
+/// @brief Runs every benchmark against a single case.
+/// @param benchCase The case to run.
+/// @param workDirectory The directory to write temporary files to.
+/// @param minSeconds The minimum time to repeat each benchmark for.
+/// @param writeLatency The extra time each .mid file takes to write when
+/// converting entire files.
+/// @return true if every benchmark succeeded, otherwise false.
+static bool RunCase(const BenchCase& benchCase, 
+                    const std::filesystem::path& workDirectory,
+                    double minSeconds,
+                    std::chrono::microseconds writeLatency)
+{
+    std::vector<uint8_t> gmdData = GenerateSyntheticGmd(benchCase.options);
+    ByteSpan gmdSpan{ gmdData.data(), gmdData.size() };
+
+    ChunkIndex index;
+    if (!index.Build(gmdSpan))
+    {
+        std::cerr << benchCase.name << ": " << index.Error() << std::endl;
+        return false;
+    }
+
+    // Chunk index throughput, measured on the bytes in memory so that only
+    // the cost of walking the chunk headers is counted.
+    BenchResult indexResult;
+    indexResult.bytes = gmdData.size();
+    indexResult.files = 1;
+    Repeat(minSeconds, [&] { return index.Build(gmdSpan); }, indexResult);
+    PrintResult(benchCase.name, "index", indexResult);
+
+    // Track analysis throughput, as used by --stats, decoding every event of
+    // every track.
+    BenchResult statsResult;
+    statsResult.bytes = gmdData.size();
+    statsResult.files = 1;
+    Repeat(minSeconds, [&]
+    {
+        bool succeeded{ true };
+        for (size_t trackNum = 0; trackNum < index.NumTracks(); trackNum++)
+        {
+            TrackStats stats;
+            std::string error;
+            succeeded &= AnalyzeTrack(index.Track(trackNum).data, 
+                                      syntheticDivision, stats, error);
+        }
+        return succeeded;
+    }, statsResult);
+    PrintResult(benchCase.name, "stats", statsResult);
+
+    // Event boundary throughput, finding where every event of every track
+    // starts, first by decoding the events as a baseline and then with each
+    // scan path the CPU supports. Each path is checked against the decoder
+    // before it is timed.
+    size_t trackBytes{ 0 };
+    for (size_t trackNum = 0; trackNum < index.NumTracks(); trackNum++)
+        trackBytes += index.Track(trackNum).data.size;
+
+    BenchResult cursorResult;
+    cursorResult.bytes = trackBytes;
+    cursorResult.files = 1;
+    std::vector<uint32_t> cursorOffsets;
+    Repeat(minSeconds, [&]
+    {
+        bool succeeded{ true };
+        for (size_t trackNum = 0; trackNum < index.NumTracks(); trackNum++)
+        {
+            cursorOffsets.clear();
+            EventCursor cursor{ index.Track(trackNum).data };
+            MidiEvent event;
+            while (cursor.Next(event))
+                cursorOffsets.push_back(event.offset);
+            succeeded &= !cursor.HasError();
+        }
+        return succeeded;
+    }, cursorResult);
+    PrintResult(benchCase.name, "cursor", cursorResult);
+
+    bool scansSucceeded{ true };
+    for (size_t trackNum = 0; trackNum < index.NumTracks(); trackNum++)
+    {
+        scansSucceeded &= CheckScan(index.Track(trackNum).data, 
+                                    benchCase.name + " track " + 
+                                    std::to_string(trackNum));
+    }
+
+    for (ScanPath path : SupportedScanPaths())
+    {
+        BenchResult scanResult;
+        scanResult.bytes = trackBytes;
+        scanResult.files = 1;
+        scanResult.succeeded = scansSucceeded;
+
+        EventScanner scanner{ path };
+        if (scanResult.succeeded)
+        {
+            Repeat(minSeconds, [&]
+            {
+                bool succeeded{ true };
+                for (size_t trackNum = 0; trackNum < index.NumTracks(); 
+                     trackNum++)
+                {
+                    succeeded &= scanner.Scan(index.Track(trackNum).data);
+                }
+                return succeeded;
+            }, scanResult);
+        }
+        PrintResult(benchCase.name, std::string{ "scan-" } + 
+                                    ScanPathName(path), scanResult);
+        scansSucceeded &= scanResult.succeeded;
+    }
+
+    // Track re-encoding throughput, as used by --optimize.
+    TrackOptimizer optimizer{ true, true };
+    std::vector<uint8_t> optimized;
+    BenchResult optimizeResult;
+    optimizeResult.files = 1;
+    optimizeResult.bytes = trackBytes;
+    Repeat(minSeconds, [&]
+    {
+        bool succeeded{ true };
+        for (size_t trackNum = 0; trackNum < index.NumTracks(); trackNum++)
+        {
+            succeeded &= optimizer.Optimize(ByteSpan{}, 
+                                            index.Track(trackNum).data, 
+                                            optimized);
+        }
+        return succeeded;
+    }, optimizeResult);
+    PrintResult(benchCase.name, "optimize", optimizeResult);
+
+    // MIDI write throughput, writing every track as its own type 0 file.
+    std::string midPath = (workDirectory / (benchCase.name + ".mid")).string();
+    FileSink sink;
+    BinData::UInt16Field division{ BinData::FieldEndianness::Big };
+    division.SetValue(syntheticDivision);
+    BenchResult writeResult;
+    writeResult.files = index.NumTracks();
+    Repeat(minSeconds, [&]
+    {
+        writeResult.bytes = 0;
+        bool succeeded{ true };
+        for (size_t trackNum = 0; trackNum < index.NumTracks(); trackNum++)
+        {
+            MidiFile midiFile{ sink, midPath, division };
+            succeeded &= midiFile.WriteTrack(index.Track(trackNum).data);
+            writeResult.bytes += midiFile.BytesWritten();
+        }
+        return succeeded;
+    }, writeResult);
+    PrintResult(benchCase.name, "write", writeResult);
+
+    // The same, writing every track into one type 2 file as -f 2 does.
+    BenchResult writeType2Result;
+    writeType2Result.files = 1;
+    Repeat(minSeconds, [&]
+    {
+        MidiFile midiFile{ sink, midPath, midiType2ID, division };
+        for (size_t trackNum = 0; trackNum < index.NumTracks(); trackNum++)
+            midiFile.AddTrack(index.Track(trackNum).data);
+        bool succeeded = midiFile.Write();
+        writeType2Result.bytes = midiFile.BytesWritten();
+        return succeeded;
+    }, writeType2Result);
+    PrintResult(benchCase.name, "write-type2", writeType2Result);
+
+    // End-to-end throughput, from the .gmd on disk to the .mid files.
+    std::filesystem::path gmdPath = workDirectory / (benchCase.name + ".gmd");
+    if (!WriteSyntheticGmd(gmdPath.string(), benchCase.options))
+    {
+        std::cerr << "Unable to write " << gmdPath.string() << std::endl;
+        return false;
+    }
+
+    ConversionOptions options;
+    options.verbose = false;
+    FileSink fileSink{ workDirectory };
+    LatentSink latentSink{ fileSink, writeLatency };
+
+    BenchResult convertResult;
+    convertResult.bytes = gmdData.size();
+    convertResult.files = 1;
+    Repeat(minSeconds, [&]
+    {
+        GmdFile gmd{ gmdPath.string(), options };
+        return gmd.Convert(latentSink);
+    }, convertResult);
+    PrintResult(benchCase.name, "convert", convertResult);
+
+    // The same again, with the .mid files written in the background as
+    // --async-write does.
+    AsyncWriter asyncWriter;
+    BenchResult asyncResult;
+    asyncResult.bytes = gmdData.size();
+    asyncResult.files = 1;
+    Repeat(minSeconds, [&]
+    {
+        AsyncSink asyncSink{ asyncWriter, latentSink };
+        GmdFile gmd{ gmdPath.string(), options };
+        return gmd.Convert(asyncSink);
+    }, asyncResult);
+    PrintResult(benchCase.name, "convert-async", asyncResult);
+
+    // Only remove the files we wrote, since the work directory may be one
+    // the user specified.
+    std::error_code error;
+    std::filesystem::remove(midPath, error);
+    std::filesystem::remove(gmdPath, error);
+    for (size_t trackNum = 0; trackNum < index.NumTracks(); trackNum++)
+    {
+        std::string trackName = benchCase.name + "-" + 
+                                std::to_string(trackNum) + ".mid";
+        std::filesystem::remove(workDirectory / trackName, error);
+    }
+
+    return indexResult.succeeded && statsResult.succeeded && 
+           cursorResult.succeeded && scansSucceeded && 
+           optimizeResult.succeeded && writeResult.succeeded && 
+           writeType2Result.succeeded && convertResult.succeeded && 
+           asyncResult.succeeded;
+}
+
+/// @brief Holds the shape of a load test against a conversion server.
+struct LoadTest
+{
+    /// @brief The path of the socket the server listens on.
+    std::string socketPath;
+
+    /// @brief The total number of requests to send.
+    size_t numRequests{ benchDefaultLoadRequests };
+
+    /// @brief The number of connections to send the requests over at once.
+    size_t numConnections{ benchDefaultLoadConnections };
+
+    /// @brief The number of different files to send, each generated with
+    /// its own seed, so that 1 measures the result cache and a number
+    /// larger than the cache measures conversion.
+    size_t numDistinct{ 1 };
+
+    /// @brief Determines if the server is sent paths to read instead of the
+    /// bytes of the files.
+    bool byPath{ false };
+};
+
+/// @brief Gets the specified percentile of a list of latencies.
+/// @param latencies The latencies, sorted from fastest to slowest.
+/// @param percentile The percentile, from 0 to 100.
+/// @return The latency in milliseconds.
+static double Percentile(const std::vector<double>& latencies, 
+                         double percentile)
+{
+    if (latencies.empty())
+        return 0;
+    size_t index = static_cast<size_t>(percentile / 100 * 
+                                       (latencies.size() - 1) + 0.5);
+    return latencies[index];
+}
+
+/// @brief Sends requests to a running conversion server from several 
+/// connections at once and prints the latency of the requests.
+/// @param test The shape of the load test.
+/// @param benchCase The case to send.
+/// @param workDirectory The directory to write the files to when sending
+/// paths.
+/// @return true if every request was converted, otherwise false.
+static bool RunLoadTest(const LoadTest& test,
+                        const BenchCase& benchCase,
+                        const std::filesystem::path& workDirectory)
+{
+    std::vector<std::vector<uint8_t>> files;
+    std::vector<std::string> names;
+    for (size_t fileNum = 0; fileNum < test.numDistinct; fileNum++)
+    {
+        SyntheticGmdOptions options = benchCase.options;
+        options.seed += static_cast<uint32_t>(fileNum);
+        files.push_back(GenerateSyntheticGmd(options));
+
+        std::filesystem::path path = workDirectory / (benchCase.name + "-" + 
+            std::to_string(fileNum) + ".gmd");
+        if (test.byPath)
+            names.push_back(std::filesystem::absolute(path).string());
+        else
+            names.push_back(path.filename().string());
+        if (test.byPath && !WriteSyntheticGmd(path.string(), options))
+        {
+            std::cerr << "Unable to write " << path.string() << std::endl;
+            return false;
+        }
+    }
+
+    std::cout << "Sending " << test.numRequests << " requests for " 
+              << test.numDistinct << " " << benchCase.name << " files ("
+              << files[0].size() / 1024 << " KB) over " 
+              << test.numConnections << " connections to " 
+              << test.socketPath << (test.byPath ? " by path" : "") 
+              << "..." << std::endl;
+
+    // Each connection takes the next request until they have all been sent,
+    // so a slow request doesn't hold up the others.
+    std::atomic<size_t> nextRequest{ 0 };
+    std::atomic<size_t> numFailed{ 0 };
+    std::vector<std::vector<double>> connectionLatencies(test.numConnections);
+    std::vector<std::string> connectionErrors(test.numConnections);
+    auto start = std::chrono::steady_clock::now();
+    {
+        std::vector<std::thread> connections;
+        for (size_t connectionNum = 0; connectionNum < test.numConnections; 
+             connectionNum++)
+        {
+            connections.emplace_back([&, connectionNum]
+            {
+                ConversionClient client;
+                if (!client.Connect(test.socketPath))
+                {
+                    connectionErrors[connectionNum] = client.Error();
+                    return;
+                }
+
+                ConversionResult result;
+                for (size_t requestNum = nextRequest++; 
+                     requestNum < test.numRequests; 
+                     requestNum = nextRequest++)
+                {
+                    size_t fileNum = requestNum % test.numDistinct;
+                    ServerRequest request;
+                    request.name = names[fileNum];
+                    request.isPath = test.byPath;
+                    if (!test.byPath)
+                    {
+                        request.data = ByteSpan{ files[fileNum].data(), 
+                                                 files[fileNum].size() };
+                    }
+
+                    auto requestStart = std::chrono::steady_clock::now();
+                    if (!client.Convert(request, result))
+                    {
+                        connectionErrors[connectionNum] = client.Error();
+                        return;
+                    }
+                    connectionLatencies[connectionNum].push_back(
+                        std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - 
+                            requestStart).count());
+
+                    if (!result.succeeded)
+                    {
+                        numFailed++;
+                        connectionErrors[connectionNum] = result.error;
+                    }
+                }
+            });
+        }
+
+        for (std::thread& connection : connections)
+            connection.join();
+    }
+    double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    if (test.byPath)
+    {
+        std::error_code error;
+        for (const std::string& name : names)
+            std::filesystem::remove(name, error);
+    }
+
+    std::vector<double> latencies;
+    for (const std::vector<double>& connection : connectionLatencies)
+        latencies.insert(latencies.end(), connection.begin(), connection.end());
+    std::sort(latencies.begin(), latencies.end());
+
+    std::cout << std::fixed << std::setprecision(3)
+              << "Completed " << latencies.size() << " requests ("
+              << numFailed << " failed) in " << seconds << " s, "
+              << std::setprecision(1) << latencies.size() / seconds 
+              << " requests/s" << std::endl << std::setprecision(3)
+              << "Latency (ms): p50 " << Percentile(latencies, 50)
+              << ", p90 " << Percentile(latencies, 90)
+              << ", p99 " << Percentile(latencies, 99)
+              << ", max " << (latencies.empty() ? 0 : latencies.back()) 
+              << std::endl;
+
+    bool succeeded = latencies.size() == test.numRequests && numFailed == 0;
+    for (const std::string& connectionError : connectionErrors)
+    {
+        if (!connectionError.empty())
+        {
+            std::cerr << connectionError << std::endl;
+            break;
+        }
+    }
+
+    return succeeded;
+}
+
+/// @brief Parses a count specified on the command line.
+/// @param param The parameter holding the count.
+/// @param count Set to the count, if one was specified.
+/// @return true if no count was specified or it is a positive number.
+static bool ParseCount(const CmdLine::ValueParam& param, size_t& count)
+{
+    if (!param.IsSpecified())
+        return true;
+    if (param.Value().empty() || 
+        param.Value().find_first_not_of("0123456789") != std::string::npos ||
+        std::stoull(param.Value()) == 0)
+    {
+        return false;
+    }
+
+    count = std::stoull(param.Value());
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> args;
+    for (int i = 0; i < argc; i++)
+        args.push_back(argv[i]);
+
+    CmdLine::ProgParam::Definition progDef;
+    progDef.name = "gmdtomid_bench";
+    progDef.description = "GmdToMid benchmark suite using synthetic .gmd files";
+    CmdLine::ProgParam progParam{ progDef };
+
+    CmdLine::ValueParam::Definition workDirDef;
+    workDirDef.name = "work-dir";
+    workDirDef.shortName = 'w';
+    workDirDef.description = "The directory to write temporary files to "
+                             "(defaults to the system temporary directory)";
+    CmdLine::ValueParam workDirParam{ workDirDef };
+
+    CmdLine::ValueParam::Definition minTimeDef;
+    minTimeDef.name = "min-time";
+    minTimeDef.shortName = 't';
+    minTimeDef.description = "The minimum number of seconds to repeat each "
+                             "benchmark for";
+    CmdLine::ValueParam minTimeParam{ minTimeDef };
+
+    CmdLine::ValueParam::Definition writeLatencyDef;
+    writeLatencyDef.name = "write-latency";
+    writeLatencyDef.description = "The number of milliseconds each .mid file "
+                                  "takes to write when converting entire "
+                                  "files, as on a network mounted volume";
+    CmdLine::ValueParam writeLatencyParam{ writeLatencyDef };
+
+    CmdLine::ValueParam::Definition caseDef;
+    caseDef.name = "case";
+    caseDef.shortName = 'c';
+    caseDef.description = "Run only the case with the specified name";
+    CmdLine::ValueParam caseParam{ caseDef };
+
+    CmdLine::OptionParam::Definition stressDef;
+    stressDef.name = "stress";
+    stressDef.shortName = 's';
+    stressDef.description = "Also run the multi-hundred-MB stress case";
+    CmdLine::OptionParam stressParam{ stressDef };
+
+    CmdLine::ValueParam::Definition loadTestDef;
+    loadTestDef.name = "load-test";
+    loadTestDef.description = "Instead of the benchmarks, send requests to "
+                              "the gmdtomid --serve server listening on the "
+                              "specified socket and report their latency";
+    CmdLine::ValueParam loadTestParam{ loadTestDef };
+
+    CmdLine::ValueParam::Definition requestsDef;
+    requestsDef.name = "requests";
+    requestsDef.description = "With --load-test, the number of requests to "
+                              "send (defaults to 1000)";
+    CmdLine::ValueParam requestsParam{ requestsDef };
+
+    CmdLine::ValueParam::Definition connectionsDef;
+    connectionsDef.name = "connections";
+    connectionsDef.description = "With --load-test, the number of "
+                                 "connections to send requests over at once "
+                                 "(defaults to 4)";
+    CmdLine::ValueParam connectionsParam{ connectionsDef };
+
+    CmdLine::ValueParam::Definition distinctDef;
+    distinctDef.name = "distinct";
+    distinctDef.description = "With --load-test, the number of different "
+                              "files to send (defaults to 1, which is "
+                              "answered from the cache after the first)";
+    CmdLine::ValueParam distinctParam{ distinctDef };
+
+    CmdLine::OptionParam::Definition byPathDef;
+    byPathDef.name = "by-path";
+    byPathDef.description = "With --load-test, write the files to the work "
+                            "directory and send their paths instead of "
+                            "their bytes";
+    CmdLine::OptionParam byPathParam{ byPathDef };
+
+    CmdLine::ValueParam::Definition scanCheckDef;
+    scanCheckDef.name = "scan-check";
+    scanCheckDef.description = "Instead of the benchmarks, check that every "
+                               "scan path finds the same events as the "
+                               "decoder in synthetic and corrupted tracks "
+                               "and the tracks of the .gmd file, or the .gmd "
+                               "files in the directory, at the specified "
+                               "path";
+    CmdLine::ValueParam scanCheckParam{ scanCheckDef };
+
+    CmdLine::OptionParam::Definition setupCheckDef;
+    setupCheckDef.name = "setup-check";
+    setupCheckDef.description = "Instead of the benchmarks, check that "
+                                "transition tracks start with the setup of "
+                                "the first track rather than the state it "
+                                "ends in";
+    CmdLine::OptionParam setupCheckParam{ setupCheckDef };
+
+    CmdLine::Parser parser{ &progParam, args };
+    parser.Add(&workDirParam);
+    parser.Add(&minTimeParam);
+    parser.Add(&writeLatencyParam);
+    parser.Add(&caseParam);
+    parser.Add(&stressParam);
+    parser.Add(&loadTestParam);
+    parser.Add(&requestsParam);
+    parser.Add(&connectionsParam);
+    parser.Add(&distinctParam);
+    parser.Add(&byPathParam);
+    parser.Add(&scanCheckParam);
+    parser.Add(&setupCheckParam);
+
+    if (parser.Parse() == CmdLine::Parser::Status::Failure)
+    {
+        std::cout << parser.GenerateUsage() << std::endl;
+        return 1;
+    }
+    else if (parser.BuiltInHelpOptionIsSpecified())
+    {
+        std::cout << parser.GenerateHelp() << std::endl;
+        return 0;
+    }
+
+    if (scanCheckParam.IsSpecified())
+        return RunScanCheck(scanCheckParam.Value()) ? 0 : 2;
+
+    if (setupCheckParam.IsSpecified())
+        return RunSetupCheck() ? 0 : 2;
+
+    double minSeconds{ benchDefaultMinSeconds };
+    if (minTimeParam.IsSpecified())
+    {
+        try
+        {
+            minSeconds = std::stod(minTimeParam.Value());
+        }
+        catch (const std::exception&)
+        {
+            std::cerr << "The minimum time must be a number." << std::endl;
+            return 1;
+        }
+    }
+
+    std::chrono::microseconds writeLatency{ 0 };
+    if (writeLatencyParam.IsSpecified())
+    {
+        double milliseconds{ 0 };
+        try
+        {
+            milliseconds = std::stod(writeLatencyParam.Value());
+        }
+        catch (const std::exception&)
+        {
+            milliseconds = -1;
+        }
+
+        if (milliseconds < 0)
+        {
+            std::cerr << "The write latency must be a non-negative number." 
+                      << std::endl;
+            return 1;
+        }
+
+        writeLatency = std::chrono::microseconds{ 
+            static_cast<int64_t>(milliseconds * 1000) };
+    }
+
+    std::filesystem::path workDirectory = workDirParam.IsSpecified() ? 
+        std::filesystem::path{ workDirParam.Value() } :
+        std::filesystem::temp_directory_path() / "gmdtomid_bench";
+    std::error_code error;
+    std::filesystem::create_directories(workDirectory, error);
+    if (error)
+    {
+        std::cerr << "Unable to create " << workDirectory.string() << ": "
+                  << error.message() << std::endl;
+        return 1;
+    }
+
+    if (loadTestParam.IsSpecified())
+    {
+        LoadTest test;
+        test.socketPath = loadTestParam.Value();
+        test.byPath = byPathParam.IsSpecified();
+        if (!ParseCount(requestsParam, test.numRequests) ||
+            !ParseCount(connectionsParam, test.numConnections) ||
+            !ParseCount(distinctParam, test.numDistinct))
+        {
+            std::cerr << "The number of requests, connections, and distinct "
+                      << "files must be positive numbers." << std::endl;
+            return 1;
+        }
+
+        std::string caseName = caseParam.IsSpecified() ? caseParam.Value() :
+                                                         benchDefaultLoadCase;
+        for (const BenchCase& benchCase : BenchCases())
+        {
+            if (benchCase.name == caseName)
+            {
+                bool succeeded = RunLoadTest(test, benchCase, workDirectory);
+                std::filesystem::remove(workDirectory, error);
+                return succeeded ? 0 : 2;
+            }
+        }
+
+        std::cerr << "No benchmark case named " << caseName << std::endl;
+        return 1;
+    }
+
+    PrintResultsHeader();
+
+    bool allSucceeded{ true };
+    size_t numRun{ 0 };
+    for (const BenchCase& benchCase : BenchCases())
+    {
+        if (caseParam.IsSpecified() ? caseParam.Value() != benchCase.name :
+                                      benchCase.stress && 
+                                      !stressParam.IsSpecified())
+        {
+            continue;
+        }
+
+        allSucceeded &= RunCase(benchCase, workDirectory, minSeconds, 
+                                writeLatency);
+        numRun++;
+    }
+
+    // This only removes the work directory if it is now empty.
+    std::filesystem::remove(workDirectory, error);
+
+    if (numRun == 0)
+    {
+        std::cerr << "No benchmark case named " << caseParam.Value() 
+                  << std::endl;
+        return 1;
+    }
+
+    return allSucceeded ? 0 : 2;
+}
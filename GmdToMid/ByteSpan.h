@@ -0,0 +1,98 @@
+// ByteSpan.h - Declares the ByteSpan struct and big endian helpers.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BYTE_SPAN_H
+#define BYTE_SPAN_H
+
+#include <cstddef>
+#include <cstdint>
+
+/// @brief Represents a read-only view of a range of bytes owned elsewhere.
+///
+/// A ByteSpan never owns the bytes it refers to, so it is cheap to copy and
+/// pass by value. The owner (e.g. a MappedFile) must outlive every span that
+/// refers to its data.
+struct ByteSpan
+{
+    /// @brief Points to the first byte in the span.
+    const uint8_t* data{ nullptr };
+
+    /// @brief The number of bytes in the span.
+    size_t size{ 0 };
+
+    /// @brief Determines if the span contains the specified range of bytes.
+    /// @param offset The offset of the range from the start of the span.
+    /// @param length The number of bytes in the range.
+    /// @return true if the entire range lies within the span.
+    bool Contains(size_t offset, size_t length) const
+    {
+        // Written so that neither side can overflow, even for huge lengths
+        // read from a corrupt file.
+        return offset <= size && length <= size - offset;
+    }
+
+    /// @brief Gets a span referring to a range of bytes within this span.
+    /// @param offset The offset of the range from the start of the span.
+    /// @param length The number of bytes in the range.
+    /// @return The range, or an empty span if it is out of bounds.
+    ByteSpan Subspan(size_t offset, size_t length) const
+    {
+        if (!Contains(offset, length))
+            return ByteSpan{};
+        return ByteSpan{ data + offset, length };
+    }
+};
+
+/// @brief Reads a big endian 16-bit unsigned integer.
+/// @param bytes Points to the 2 bytes to read.
+/// @return The integer value.
+inline uint16_t ReadUInt16BE(const uint8_t* bytes)
+{
+    return static_cast<uint16_t>((bytes[0] << 8) | bytes[1]);
+}
+
+/// @brief Reads a big endian 32-bit unsigned integer.
+/// @param bytes Points to the 4 bytes to read.
+/// @return The integer value.
+inline uint32_t ReadUInt32BE(const uint8_t* bytes)
+{
+    return (static_cast<uint32_t>(bytes[0]) << 24) |
+           (static_cast<uint32_t>(bytes[1]) << 16) |
+           (static_cast<uint32_t>(bytes[2]) << 8) |
+           static_cast<uint32_t>(bytes[3]);
+}
+
+/// @brief Writes a big endian 16-bit unsigned integer.
+/// @param bytes Points to the 2 bytes to write to.
+/// @param value The integer value to write.
+inline void WriteUInt16BE(uint8_t* bytes, uint16_t value)
+{
+    bytes[0] = static_cast<uint8_t>(value >> 8);
+    bytes[1] = static_cast<uint8_t>(value);
+}
+
+/// @brief Writes a big endian 32-bit unsigned integer.
+/// @param bytes Points to the 4 bytes to write to.
+/// @param value The integer value to write.
+inline void WriteUInt32BE(uint8_t* bytes, uint32_t value)
+{
+    bytes[0] = static_cast<uint8_t>(value >> 24);
+    bytes[1] = static_cast<uint8_t>(value >> 16);
+    bytes[2] = static_cast<uint8_t>(value >> 8);
+    bytes[3] = static_cast<uint8_t>(value);
+}
+
+#endif
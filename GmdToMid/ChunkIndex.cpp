@@ -0,0 +1,86 @@
+// ChunkIndex.cpp - Defines the ChunkIndex class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sstream>
+#include "ChunkIndex.h"
+
+bool ChunkIndex::Build(ByteSpan fileData)
+{
+    this->fileData = fileData;
+    chunks.clear();
+    trackPositions.clear();
+    midiHeaderPosition = chunkIndexNone;
+    error.clear();
+
+    // The GMD header is a chunk that wraps the rest of the file, so we only
+    // read its 8 byte header here rather than treating it as a normal chunk.
+    if (!fileData.Contains(0, chunkHeaderSize) ||
+        ReadUInt32BE(fileData.data) != gmdHeaderFourCC)
+    {
+        error = "Input file does not appear to be in the GMD format.";
+        return false;
+    }
+
+    size_t expectedSize = ReadUInt32BE(fileData.data + 4);
+    size_t actualSize = fileData.size - chunkHeaderSize;
+    if (expectedSize != actualSize)
+    {
+        std::stringstream message;
+        message << "GMD file appears corrupt due to file size mismatch."
+                << std::endl << "Expected Size : " << expectedSize
+                << std::endl << "Actual Size   : " << actualSize;
+        error = message.str();
+        return false;
+    }
+
+    fileHeader.id = ReadUInt32BE(fileData.data);
+    fileHeader.offset = 0;
+    fileHeader.data = fileData.Subspan(chunkHeaderSize, expectedSize);
+
+    GmdReader reader{ fileData };
+    reader.Seek(chunkHeaderSize);
+    while (reader.BytesRemaining() > 0)
+    {
+        Chunk chunk;
+        if (!reader.ReadChunk(chunk))
+        {
+            error = "GMD file appears corrupt: " + reader.Error();
+            return false;
+        }
+
+        switch (chunk.id)
+        {
+            case midiTrackFourCC:
+                trackPositions.push_back(chunks.size());
+                break;
+            case midiHeaderFourCC:
+                if (midiHeaderPosition == chunkIndexNone)
+                    midiHeaderPosition = chunks.size();
+                break;
+            default:
+                break;
+        }
+
+        chunks.push_back(chunk);
+    }
+
+    return true;
+}
+
+size_t ChunkIndex::BytesAfter(const Chunk& chunk) const
+{
+    return fileData.size - (chunk.offset + chunkHeaderSize + chunk.data.size);
+}
@@ -0,0 +1,85 @@
+// ChunkIndex.h - Declares the ChunkIndex class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CHUNK_INDEX_H
+#define CHUNK_INDEX_H
+
+#include <string>
+#include <vector>
+#include "ByteSpan.h"
+#include "GmdReader.h"
+
+/// @brief Indicates that an index has no entry of a given kind.
+inline constexpr size_t chunkIndexNone{ static_cast<size_t>(-1) };
+
+/// @brief Records the ID, offset, and size of every chunk in a .gmd file.
+///
+/// The index is built in a single pass that hops from one chunk header to
+/// the next without touching any chunk data, so building it costs the same
+/// no matter how large the tracks are. Once built, any chunk or track can be
+/// reached directly without walking the file again.
+class ChunkIndex
+{
+public:
+    /// @brief Builds the index from the bytes of a .gmd file.
+    /// @param fileData The bytes of the entire .gmd file.
+    /// @return true if the index was built, otherwise false.
+    bool Build(ByteSpan fileData);
+
+    /// @brief Gets the GMD chunk that wraps the rest of the file.
+    /// @return The GMD file header chunk.
+    const Chunk& FileHeader() const { return fileHeader; }
+
+    /// @brief Gets every chunk within the file, in the order they appear.
+    /// @return The chunks, excluding the GMD file header.
+    const std::vector<Chunk>& Chunks() const { return chunks; }
+
+    /// @brief Gets the position of the MIDI header within Chunks().
+    /// @return The position, or chunkIndexNone if there is no MIDI header.
+    size_t MidiHeaderPosition() const { return midiHeaderPosition; }
+
+    /// @brief Gets the number of MIDI tracks within the file.
+    /// @return The number of MIDI tracks.
+    size_t NumTracks() const { return trackPositions.size(); }
+
+    /// @brief Gets the specified MIDI track chunk.
+    /// @param trackNum The zero-based number of the track.
+    /// @return The track chunk.
+    /// @pre trackNum is less than NumTracks().
+    const Chunk& Track(size_t trackNum) const
+    {
+        return chunks[trackPositions[trackNum]];
+    }
+
+    /// @brief Gets the number of bytes that follow the specified chunk.
+    /// @param chunk A chunk within the index.
+    /// @return The number of bytes between the end of the chunk and the end
+    /// of the file.
+    size_t BytesAfter(const Chunk& chunk) const;
+
+    /// @brief Gets a description of the error that stopped the index build.
+    /// @return The error message, or an empty string if there was no error.
+    const std::string& Error() const { return error; }
+private:
+    ByteSpan fileData;
+    Chunk fileHeader;
+    std::vector<Chunk> chunks;
+    std::vector<size_t> trackPositions;
+    size_t midiHeaderPosition{ chunkIndexNone };
+    std::string error;
+};
+
+#endif
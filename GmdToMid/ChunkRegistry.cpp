@@ -0,0 +1,94 @@
+// ChunkRegistry.cpp - Defines the ChunkRegistry class and chunk handlers.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <iterator>
+#include "ChunkRegistry.h"
+
+/// @brief Orders handlers by ID so they can be binary searched.
+/// @param entry The registered handler.
+/// @param id The ID to compare against.
+/// @return true if the handler's ID comes before the ID.
+static bool IdLess(const std::pair<uint32_t, ChunkHandler>& entry, 
+                   uint32_t id)
+{
+    return entry.first < id;
+}
+
+void ChunkRegistry::Register(uint32_t id, ChunkHandler handler)
+{
+    auto entry = std::lower_bound(handlers.begin(), handlers.end(), id, 
+                                  IdLess);
+    if (entry != handlers.end() && entry->first == id)
+        entry->second = std::move(handler);
+    else
+        handlers.emplace(entry, id, std::move(handler));
+}
+
+const ChunkHandler* ChunkRegistry::Find(uint32_t id) const
+{
+    auto entry = std::lower_bound(handlers.begin(), handlers.end(), id, 
+                                  IdLess);
+    if (entry == handlers.end() || entry->first != id)
+        return nullptr;
+    return &entry->second;
+}
+
+const ChunkRegistry& ChunkRegistry::BuiltIn()
+{
+    static const ChunkRegistry builtIn = []
+    {
+        ChunkRegistry registry;
+        registry.Register(imuseHeaderFourCC, DecodeImuseHeader);
+        return registry;
+    }();
+    return builtIn;
+}
+
+bool DecodeImuseHeader(const Chunk& chunk, 
+                       ChunkMetadata& metadata, 
+                       std::string&)
+{
+    // Pan, transpose, and detune are signed offsets from the defaults.
+    struct HeaderField
+    {
+        const char* name;
+        bool isSigned;
+    };
+    static constexpr HeaderField headerFields[] = {
+        { "priority", false },
+        { "volume", false },
+        { "pan", true },
+        { "transpose", true },
+        { "detune", true },
+        { "speed", false }
+    };
+    static constexpr size_t firstFieldOffset{ 2 };
+
+    for (size_t i = 0; i < std::size(headerFields); i++)
+    {
+        size_t offset = firstFieldOffset + i;
+        if (offset >= chunk.data.size)
+            break;
+
+        uint8_t byte = chunk.data.data[offset];
+        int64_t value = headerFields[i].isSigned ? 
+            static_cast<int64_t>(static_cast<int8_t>(byte)) : byte;
+        metadata.fields.push_back(ChunkField{ headerFields[i].name, value });
+    }
+
+    return true;
+}
@@ -0,0 +1,111 @@
+// ChunkRegistry.h - Declares the ChunkRegistry class and chunk handlers.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CHUNK_REGISTRY_H
+#define CHUNK_REGISTRY_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "FourCC.h"
+#include "GmdReader.h"
+
+/// @brief Represents a value decoded from a chunk.
+struct ChunkField
+{
+    /// @brief The name of the value, e.g. "priority".
+    std::string name;
+
+    /// @brief The value.
+    int64_t value{ 0 };
+};
+
+/// @brief Represents what a chunk handler decoded from a chunk.
+struct ChunkMetadata
+{
+    /// @brief The ID of the chunk.
+    uint32_t id{ 0 };
+
+    /// @brief The offset of the chunk header from the start of the file.
+    size_t offset{ 0 };
+
+    /// @brief The values decoded from the chunk, in the order they appear.
+    std::vector<ChunkField> fields;
+};
+
+/// @brief Decodes a chunk other than the MIDI header and tracks.
+///
+/// The handler is given the chunk and metadata with the ID and offset
+/// already filled in, and adds whatever fields it decodes. A handler that
+/// returns false stops the conversion with the error it sets, so handlers
+/// for chunks that are merely informative should decode what they can
+/// rather than fail.
+using ChunkHandler = std::function<bool(const Chunk& chunk, 
+                                        ChunkMetadata& metadata, 
+                                        std::string& error)>;
+
+/// @brief Maps chunk IDs to the handlers that decode them.
+///
+/// The MIDI header and tracks are converted directly and never reach the
+/// registry. Every other chunk is looked up by its integer ID, which is a
+/// binary search without any allocation, and the ones without a handler are
+/// skipped without their data being touched.
+///
+/// A registry is only read during conversions, so one registry can be
+/// shared by every conversion as long as nothing is registered meanwhile.
+class ChunkRegistry
+{
+public:
+    /// @brief Registers a handler, replacing any already registered for the
+    /// same ID.
+    /// @param id The ID of the chunks to handle, e.g. MakeFourCC("MDpg").
+    /// @param handler The handler to call for each chunk with the ID.
+    void Register(uint32_t id, ChunkHandler handler);
+
+    /// @brief Finds the handler for the specified chunk ID.
+    /// @param id The ID of the chunk.
+    /// @return The handler, or null if no handler is registered for the ID.
+    const ChunkHandler* Find(uint32_t id) const;
+
+    /// @brief Gets a registry holding only the built-in handlers.
+    /// @return The registry used when ConversionOptions::chunkRegistry is 
+    /// null. Copy it to add handlers of your own to the built-in ones.
+    ///
+    /// Only the iMuse header (MDhd) has a built-in handler. The MDpg chunk
+    /// also appears in .gmd files, but its layout isn't documented, so it's
+    /// left to callers who know what their files hold.
+    static const ChunkRegistry& BuiltIn();
+private:
+    std::vector<std::pair<uint32_t, ChunkHandler>> handlers;
+};
+
+/// @brief Decodes an iMuse header (MDhd) chunk.
+/// @param chunk The chunk to decode.
+/// @param metadata The metadata to add the decoded fields to.
+/// @param error Unused; the header is informative, so it never fails.
+/// @return true.
+///
+/// The header holds the settings iMuse starts the sound with: the priority
+/// it has over other sounds, and its volume, pan, transpose, detune, and
+/// speed. Headers shorter than the usual 8 bytes are decoded as far as they
+/// go, and the first 2 bytes, whose purpose is unknown, are skipped.
+bool DecodeImuseHeader(const Chunk& chunk, 
+                       ChunkMetadata& metadata, 
+                       std::string& error);
+
+#endif
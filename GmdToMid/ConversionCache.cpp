@@ -0,0 +1,311 @@
+// ConversionCache.cpp - Defines the ConversionCache class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include "ConversionCache.h"
+#include "Hash.h"
+#include "MappedFile.h"
+
+/// @brief The prefix of the directories entries are staged in.
+inline const char* conversionCacheStagingPrefix{ "tmp-" };
+
+bool ConversionCache::Open()
+{
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    return std::filesystem::is_directory(directory, error);
+}
+
+std::string ConversionCache::Key(ByteSpan gmdData, 
+                                 const ConversionOptions& options)
+{
+    return HashToString(Xxh64(gmdData)) + OptionsKey(options);
+}
+
+std::string ConversionCache::OptionsKey(const ConversionOptions& options)
+{
+    // Only the options that change the output are part of the key; e.g.
+    // parallelTracks produces the same files, so it shares the entries.
+    std::string fingerprint = "v" + std::to_string(conversionCacheVersion);
+    fingerprint += ";extract=";
+    if (options.extractTrack)
+        fingerprint += std::to_string(*options.extractTrack);
+    fingerprint += ";setup=" + std::to_string(options.propagateSetup);
+    fingerprint += ";format=";
+    if (options.singleFileFormat)
+        fingerprint += std::to_string(*options.singleFileFormat);
+    fingerprint += ";range=";
+    if (options.range)
+    {
+        auto appendBound = [&fingerprint](const RangeBound& bound)
+        {
+            fingerprint += std::to_string(bound.value);
+            if (bound.seconds)
+                fingerprint += "s";
+        };
+        appendBound(options.range->start);
+        fingerprint += ":";
+        appendBound(options.range->end);
+    }
+
+    // Only added when set, so entries made before the optimizer existed
+    // keep their keys.
+    if (options.optimize)
+    {
+        fingerprint += ";optimize=";
+        fingerprint += options.stripImuseSysEx ? "strip" : "keep";
+    }
+
+    ByteSpan fingerprintSpan{ 
+        reinterpret_cast<const uint8_t*>(fingerprint.data()), 
+        fingerprint.size() };
+    return HashToString(Xxh64(fingerprintSpan));
+}
+
+bool ConversionCache::Restore(const std::string& key, 
+                              const std::string& stem, 
+                              OutputSink& sink,
+                              size_t& numFiles)
+{
+    std::filesystem::path entry = EntryPath(key);
+    std::ifstream manifest{ entry / conversionCacheManifest };
+    if (!manifest)
+    {
+        misses++;
+        return false;
+    }
+
+    std::vector<std::string> suffixes;
+    std::string suffix;
+    while (std::getline(manifest, suffix))
+        suffixes.push_back(suffix);
+    manifest.close();
+
+    for (size_t i = 0; i < suffixes.size(); i++)
+    {
+        std::filesystem::path source = entry / (std::to_string(i) + ".mid");
+        if (!sink.Link(stem + suffixes[i], source))
+        {
+            // The entry may have been evicted by another process while we
+            // were restoring it, in which case we just convert as normal.
+            misses++;
+            return false;
+        }
+    }
+
+    // The time the manifest was last written is when the entry was last
+    // used, which is what Evict() goes by.
+    std::error_code error;
+    std::filesystem::last_write_time(entry / conversionCacheManifest,
+                                     std::filesystem::file_time_type::clock::now(),
+                                     error);
+
+    numFiles = suffixes.size();
+    hits++;
+    return true;
+}
+
+void ConversionCache::Evict()
+{
+    struct Entry
+    {
+        std::filesystem::path path;
+        std::filesystem::file_time_type lastUsed;
+        uint64_t size{ 0 };
+    };
+
+    std::lock_guard<std::mutex> lock{ evictMutex };
+    std::vector<Entry> entries;
+    uint64_t totalSize{ 0 };
+    std::error_code error;
+
+    for (std::filesystem::directory_iterator it{ directory, error }; 
+         !error && it != std::filesystem::directory_iterator{}; 
+         it.increment(error))
+    {
+        std::string name = it->path().filename().string();
+        if (!it->is_directory(error) || 
+            name.rfind(conversionCacheStagingPrefix, 0) == 0)
+        {
+            continue;
+        }
+
+        Entry entry;
+        entry.path = it->path();
+        entry.lastUsed = std::filesystem::last_write_time(
+            entry.path / conversionCacheManifest, error);
+        if (error)
+            entry.lastUsed = std::filesystem::file_time_type::min();
+
+        for (const auto& file : 
+             std::filesystem::directory_iterator{ entry.path, error })
+        {
+            entry.size += file.file_size(error);
+        }
+
+        totalSize += entry.size;
+        entries.push_back(entry);
+        error.clear();
+    }
+
+    std::sort(entries.begin(), entries.end(), 
+              [](const Entry& a, const Entry& b) 
+              { 
+                  return a.lastUsed < b.lastUsed; 
+              });
+
+    for (const Entry& entry : entries)
+    {
+        if (totalSize <= maxSize)
+            break;
+
+        std::filesystem::remove_all(entry.path, error);
+        if (!error)
+        {
+            totalSize -= entry.size;
+            evictions++;
+        }
+    }
+
+    size = totalSize;
+}
+
+ConversionCacheStats ConversionCache::Stats() const
+{
+    ConversionCacheStats stats;
+    stats.hits = hits;
+    stats.misses = misses;
+    stats.stores = stores;
+    stats.evictions = evictions;
+    stats.size = size;
+    return stats;
+}
+
+std::filesystem::path ConversionCache::EntryPath(const std::string& key) const
+{
+    return directory / key;
+}
+
+ConversionCache::Recorder::Recorder(ConversionCache& cache, 
+                                    std::string key, 
+                                    std::string stem, 
+                                    OutputSink& sink) :
+    cache{ cache }, key{ key }, stem{ stem }, sink{ sink }
+{
+    // The staging directory has to be unique across threads and processes
+    // that are converting the same file at the same time.
+    auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+    stagingDirectory = cache.directory / 
+        (conversionCacheStagingPrefix + key + "-" + std::to_string(now) + 
+         "-" + std::to_string(cache.nextStagingNum++));
+
+    std::error_code error;
+    if (!std::filesystem::create_directories(stagingDirectory, error))
+        failed = true;
+}
+
+ConversionCache::Recorder::~Recorder()
+{
+    std::error_code error;
+    std::filesystem::remove_all(stagingDirectory, error);
+}
+
+bool ConversionCache::Recorder::Write(const std::string& name, 
+                                      const std::vector<ByteSpan>& pieces)
+{
+    if (!sink.Write(name, pieces))
+        return false;
+
+    Record(name, pieces);
+    return true;
+}
+
+bool ConversionCache::Recorder::WriteBuffer(const std::string& name, 
+                                            std::vector<uint8_t>&& buffer)
+{
+    // The buffer has to be recorded before the sink is allowed to take it.
+    Record(name, { ByteSpan{ buffer.data(), buffer.size() } });
+    return sink.WriteBuffer(name, std::move(buffer));
+}
+
+bool ConversionCache::Recorder::Link(const std::string& name, 
+                                     const std::filesystem::path& source)
+{
+    if (!sink.Link(name, source))
+        return false;
+
+    MappedFile file{ source.string() };
+    if (!file.Open())
+    {
+        std::lock_guard<std::mutex> lock{ mutex };
+        failed = true;
+        return true;
+    }
+
+    Record(name, { file.Data() });
+    return true;
+}
+
+std::string ConversionCache::Recorder::PathOf(const std::string& name) const
+{
+    return sink.PathOf(name);
+}
+
+void ConversionCache::Recorder::Record(const std::string& name, 
+                                       const std::vector<ByteSpan>& pieces)
+{
+    std::lock_guard<std::mutex> lock{ mutex };
+    if (failed || name.compare(0, stem.size(), stem) != 0)
+    {
+        failed = true;
+        return;
+    }
+
+    FileSink staging{ stagingDirectory };
+    std::string fileName = std::to_string(suffixes.size()) + ".mid";
+    if (!staging.Write(fileName, pieces))
+        failed = true;
+
+    suffixes.push_back(name.substr(stem.size()));
+}
+
+bool ConversionCache::Recorder::Commit()
+{
+    std::lock_guard<std::mutex> lock{ mutex };
+    if (failed)
+        return false;
+
+    // The outputs of parallel tracks are recorded in the order they finish,
+    // but the manifest keeps each file with its own name, so that is fine.
+    std::ofstream manifest{ stagingDirectory / conversionCacheManifest };
+    for (const std::string& suffix : suffixes)
+        manifest << suffix << '\n';
+    manifest.close();
+    if (manifest.fail())
+        return false;
+
+    // If the same input was stored by someone else in the meantime, theirs
+    // is kept and ours is removed with the staging directory.
+    std::error_code error;
+    std::filesystem::rename(stagingDirectory, cache.EntryPath(key), error);
+    if (error)
+        return false;
+
+    cache.stores++;
+    return true;
+}
@@ -0,0 +1,193 @@
+// ConversionCache.h - Declares the ConversionCache class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CONVERSION_CACHE_H
+#define CONVERSION_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ByteSpan.h"
+#include "ConversionOptions.h"
+#include "OutputSink.h"
+
+/// @brief The version of the cache entries and of the conversion itself.
+///
+/// This is part of every cache key, so bumping it whenever a change to the
+/// converter changes its output makes every existing entry a miss.
+inline constexpr int conversionCacheVersion{ 1 };
+
+/// @brief The default limit on the size of the cache, in bytes.
+inline constexpr uint64_t conversionCacheDefaultSize{ 1024ULL * 1024 * 1024 };
+
+/// @brief The name of the file in each entry that lists its outputs.
+inline const char* conversionCacheManifest{ "manifest" };
+
+/// @brief Holds the counters of a ConversionCache.
+struct ConversionCacheStats
+{
+    /// @brief The number of conversions that were restored from the cache.
+    uint64_t hits{ 0 };
+
+    /// @brief The number of conversions that weren't in the cache.
+    uint64_t misses{ 0 };
+
+    /// @brief The number of new entries added to the cache.
+    uint64_t stores{ 0 };
+
+    /// @brief The number of entries removed to keep within the size limit.
+    uint64_t evictions{ 0 };
+
+    /// @brief The size of the cache after the last eviction, in bytes.
+    uint64_t size{ 0 };
+};
+
+/// @brief Stores the .mid files produced by each conversion on disk, keyed
+/// by the contents of the .gmd file and the options it was converted with.
+///
+/// Each entry is a directory named after its key, holding the .mid files and
+/// a manifest of their names. Names are stored without the .gmd file name,
+/// so the same file under a different name is still a hit. Restoring an
+/// entry hard links the cached files into place where possible, so a hit
+/// costs a few metadata operations rather than a conversion.
+///
+/// Entries are written to a temporary directory and renamed into place, so
+/// several threads or processes can share a cache. The cache is trimmed to
+/// its size limit by Evict(), which removes the least recently used entries
+/// first.
+class ConversionCache
+{
+public:
+    /// @brief Constructor; creates a new ConversionCache.
+    /// @param directory The directory the cache is kept in.
+    /// @param maxSize The size the cache is trimmed to by Evict(), in bytes.
+    ConversionCache(std::filesystem::path directory, 
+                    uint64_t maxSize = conversionCacheDefaultSize) :
+        directory{ directory }, maxSize{ maxSize }
+    { }
+
+    /// @brief Creates the cache directory if it doesn't exist yet.
+    /// @return true if the cache directory exists, otherwise false.
+    bool Open();
+
+    /// @brief Computes the key of a conversion.
+    /// @param gmdData The bytes of the .gmd file.
+    /// @param options The options the file is converted with.
+    /// @return The key, as 32 hexadecimal digits.
+    static std::string Key(ByteSpan gmdData, const ConversionOptions& options);
+
+    /// @brief Computes the part of a key that comes from the options.
+    /// @param options The options a file is converted with.
+    /// @return The hash of every option that changes the output, as 16 
+    /// hexadecimal digits.
+    static std::string OptionsKey(const ConversionOptions& options);
+
+    /// @brief Writes the outputs of a cached conversion to a sink.
+    /// @param key The key of the conversion.
+    /// @param stem The name of the .gmd file without its extension.
+    /// @param sink The sink to write the outputs to.
+    /// @param numFiles Set to the number of files restored.
+    /// @return true if the conversion was cached and every output was
+    /// restored, otherwise false.
+    bool Restore(const std::string& key, 
+                 const std::string& stem, 
+                 OutputSink& sink,
+                 size_t& numFiles);
+
+    /// @brief Removes the least recently used entries until the cache fits
+    /// within its size limit.
+    void Evict();
+
+    /// @brief Gets the counters of the cache.
+    /// @return The counters.
+    ConversionCacheStats Stats() const;
+
+    /// @brief Records the outputs of a conversion while forwarding them to
+    /// another sink, then stores them in the cache once it succeeds.
+    class Recorder : public OutputSink
+    {
+    public:
+        /// @brief Constructor; creates a new Recorder.
+        /// @param cache The cache to store the outputs in.
+        /// @param key The key of the conversion.
+        /// @param stem The name of the .gmd file without its extension.
+        /// @param sink The sink to forward the outputs to.
+        Recorder(ConversionCache& cache, 
+                 std::string key, 
+                 std::string stem, 
+                 OutputSink& sink);
+
+        /// @brief Destructor; discards the outputs if they weren't stored.
+        ~Recorder();
+
+        Recorder(const Recorder&) = delete;
+        Recorder& operator=(const Recorder&) = delete;
+
+        bool Write(const std::string& name, 
+                   const std::vector<ByteSpan>& pieces) override;
+
+        bool WriteBuffer(const std::string& name, 
+                         std::vector<uint8_t>&& buffer) override;
+
+        bool Link(const std::string& name, 
+                  const std::filesystem::path& source) override;
+
+        void Pin(ByteSpan bytes) override { sink.Pin(bytes); }
+
+        std::vector<std::string> Flush() override { return sink.Flush(); }
+
+        std::string PathOf(const std::string& name) const override;
+
+        /// @brief Stores every output recorded so far in the cache.
+        /// @return true if the entry was stored, otherwise false.
+        bool Commit();
+    private:
+        ConversionCache& cache;
+        std::string key;
+        std::string stem;
+        OutputSink& sink;
+        std::filesystem::path stagingDirectory;
+        std::vector<std::string> suffixes;
+        std::mutex mutex;
+        bool failed{ false };
+
+        /// @brief Records an output in the staging directory.
+        /// @param name The name of the output.
+        /// @param pieces The pieces of the output.
+        void Record(const std::string& name, 
+                    const std::vector<ByteSpan>& pieces);
+    };
+private:
+    std::filesystem::path directory;
+    uint64_t maxSize;
+    std::mutex evictMutex;
+    std::atomic<uint64_t> hits{ 0 };
+    std::atomic<uint64_t> misses{ 0 };
+    std::atomic<uint64_t> stores{ 0 };
+    std::atomic<uint64_t> evictions{ 0 };
+    std::atomic<uint64_t> size{ 0 };
+    std::atomic<uint64_t> nextStagingNum{ 0 };
+
+    /// @brief Gets the directory of the entry with the specified key.
+    /// @param key The key of the entry.
+    /// @return The path of the entry.
+    std::filesystem::path EntryPath(const std::string& key) const;
+};
+
+#endif
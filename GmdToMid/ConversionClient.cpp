@@ -0,0 +1,119 @@
+// ConversionClient.cpp - Defines the ConversionClient class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ConversionClient.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+ConversionClient::~ConversionClient()
+{
+    Close();
+}
+
+#ifndef _WIN32
+
+bool ConversionClient::Connect(const std::string& socketPath)
+{
+    Close();
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path))
+    {
+        error = "The socket path must be between 1 and " + 
+                std::to_string(sizeof(address.sun_path) - 1) + " bytes";
+        return false;
+    }
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socket < 0 || connect(socket, reinterpret_cast<sockaddr*>(&address), 
+                              sizeof(address)) != 0)
+    {
+        error = "Unable to connect to " + socketPath + ": " + 
+                std::strerror(errno);
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+bool ConversionClient::Convert(const ServerRequest& request, 
+                               ConversionResult& result)
+{
+    if (socket < 0)
+    {
+        error = "Not connected to a server";
+        return false;
+    }
+
+    // The message buffer is kept between requests, so a client sending
+    // files of a similar size only allocates for the first.
+    EncodeServerRequest(request, message);
+    if (!WriteSocket(socket, message.data(), message.size()) ||
+        !ReadMessage(socket, message))
+    {
+        error = "The connection to the server was lost";
+        Close();
+        return false;
+    }
+
+    result = ConversionResult{};
+    if (!DecodeServerResponse(ByteSpan{ message.data(), message.size() }, 
+                              result))
+    {
+        error = "The server sent a malformed response";
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void ConversionClient::Close()
+{
+    if (socket >= 0)
+        close(socket);
+    socket = -1;
+}
+
+#else
+
+bool ConversionClient::Connect(const std::string& socketPath)
+{
+    error = "The conversion server is not supported on this platform";
+    return false;
+}
+
+bool ConversionClient::Convert(const ServerRequest& request, 
+                               ConversionResult& result)
+{
+    error = "The conversion server is not supported on this platform";
+    return false;
+}
+
+void ConversionClient::Close()
+{
+}
+
+#endif
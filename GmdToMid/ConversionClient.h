@@ -0,0 +1,67 @@
+// ConversionClient.h - Declares the ConversionClient class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CONVERSION_CLIENT_H
+#define CONVERSION_CLIENT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "GmdToMid.h"
+#include "ServerProtocol.h"
+
+/// @brief Sends .gmd files to a ConversionServer to be converted.
+///
+/// A client holds one connection open for all of its requests, so only the
+/// first request pays for connecting. A client may only be used by one
+/// thread at a time.
+class ConversionClient
+{
+public:
+    ConversionClient() = default;
+
+    /// @brief Destructor; closes the connection.
+    ~ConversionClient();
+
+    ConversionClient(const ConversionClient&) = delete;
+    ConversionClient& operator=(const ConversionClient&) = delete;
+
+    /// @brief Connects to a server.
+    /// @param socketPath The path of the socket the server listens on.
+    /// @return true if the client connected, otherwise false.
+    bool Connect(const std::string& socketPath);
+
+    /// @brief Sends a request and waits for the response.
+    /// @param request The request to send.
+    /// @param result Set to the result of the conversion. When the server
+    /// couldn't convert the file, succeeded is false and error says why.
+    /// @return true if a response was received, or false if the connection
+    /// failed, in which case the client must connect again.
+    bool Convert(const ServerRequest& request, ConversionResult& result);
+
+    /// @brief Gets a description of the last error that occurred.
+    /// @return The error message, or an empty string if there was no error.
+    const std::string& Error() const { return error; }
+private:
+    int socket{ -1 };
+    std::vector<uint8_t> message;
+    std::string error;
+
+    /// @brief Closes the connection, if it is open.
+    void Close();
+};
+
+#endif
@@ -0,0 +1,172 @@
+// ConversionOptions.h - Declares the ConversionOptions struct.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CONVERSION_OPTIONS_H
+#define CONVERSION_OPTIONS_H
+
+#include <filesystem>
+#include <optional>
+
+class AsyncWriter;
+class ChunkRegistry;
+class ConversionCache;
+class IncrementalManifest;
+class TrackDeduplicator;
+
+/// @brief Represents one end of a TrackRange.
+struct RangeBound
+{
+    /// @brief The position, in ticks or seconds.
+    ///
+    /// An open end of a range is infinitely far away.
+    double value{ 0 };
+
+    /// @brief Determines if the value is in seconds rather than ticks.
+    bool seconds{ false };
+};
+
+/// @brief Represents the window of each track to export, from the start up
+/// to but not including the end.
+struct TrackRange
+{
+    /// @brief The start of the window.
+    RangeBound start;
+
+    /// @brief The end of the window.
+    RangeBound end;
+};
+
+/// @brief Represents the options that control how a .gmd file is converted.
+///
+/// The options are gathered from the command line by the Program class and
+/// passed to each GmdFile so that single file and batch conversions behave
+/// the same way.
+struct ConversionOptions
+{
+    /// @brief Determines if chunk details are printed while converting.
+    bool verbose{ true };
+
+    /// @brief Determines if errors are printed to standard error.
+    ///
+    /// Errors are always available from GmdFile::Error() either way.
+    bool printErrors{ true };
+
+    /// @brief The directory the .mid files are written to.
+    ///
+    /// When empty, the .mid files are written to the current directory. This
+    /// is ignored when converting to an OutputSink.
+    std::filesystem::path outputDirectory;
+
+    /// @brief Determines if the tracks within a file are exported in parallel.
+    ///
+    /// The tracks are still numbered in the order they appear in the file,
+    /// so the output is identical to exporting the tracks one at a time.
+    bool parallelTracks{ false };
+
+    /// @brief The most tracks of a file exported at once when parallelTracks
+    /// is set, or 0 to match the hardware.
+    ///
+    /// Files converted side by side, e.g. by a batch, set this to their share
+    /// of the hardware, so that every file doesn't start as many workers as
+    /// there are CPU threads.
+    size_t trackWorkers{ 0 };
+
+    /// @brief The zero-based number of the only track to export, if any.
+    ///
+    /// When empty, every track in the file is exported.
+    std::optional<size_t> extractTrack;
+
+    /// @brief Determines if the setup from the first track is added to the
+    /// start of every other track.
+    ///
+    /// Not used with a type 1 single file, whose tracks play at the same 
+    /// time rather than after the first track.
+    bool propagateSetup{ false };
+
+    /// @brief The MIDI type to export every track into a single file as.
+    ///
+    /// When empty, each track is exported as its own type 0 MIDI file.
+    /// Otherwise this is 1, for tracks that play at the same time, or 2, for
+    /// tracks that are independent sequences like the tracks of a GMD.
+    std::optional<int> singleFileFormat;
+
+    /// @brief The window of each track to export, if any.
+    ///
+    /// When empty, every track is exported in full. Otherwise each track is
+    /// cut down to the window, starting with the state the track had built
+    /// up by the start of the window. @see SeekIndex
+    std::optional<TrackRange> range;
+
+    /// @brief Determines if each track is re-encoded into as few bytes as
+    /// possible, using running status and leaving out events that change
+    /// nothing, instead of being copied as it is. @see TrackOptimizer
+    ///
+    /// The events left out are judged within each track, so in a type 1 
+    /// file, whose tracks share their channels, only running status is 
+    /// used.
+    bool optimize{ false };
+
+    /// @brief Determines if the SysEx messages iMuse uses for its own hooks
+    /// and markers are stripped from the tracks.
+    ///
+    /// Only used when optimize is set.
+    bool stripImuseSysEx{ false };
+
+    /// @brief The cache to reuse the outputs of earlier conversions from.
+    ///
+    /// When null, every file is converted. The cache is not owned by the
+    /// options and must outlive every conversion that uses it.
+    ConversionCache* cache{ nullptr };
+
+    /// @brief The deduplicator that finds tracks identical to ones already
+    /// exported, which are then linked or referenced instead of written.
+    ///
+    /// When null, every track is written. Tracks exported into a single MIDI
+    /// file are never deduplicated. Like the cache, the deduplicator is not
+    /// owned by the options.
+    TrackDeduplicator* dedup{ nullptr };
+
+    /// @brief The manifest of earlier conversions, used to skip inputs whose
+    /// outputs are already up to date.
+    ///
+    /// When null, every file is converted. This is ignored when converting
+    /// to an OutputSink. Like the cache, the manifest is not owned by the
+    /// options.
+    IncrementalManifest* incremental{ nullptr };
+
+    /// @brief The writer that writes the .mid files in the background.
+    ///
+    /// When null, each .mid file is written before the conversion moves on.
+    /// This is ignored when converting to an OutputSink. Like the cache, the
+    /// writer is not owned by the options.
+    AsyncWriter* asyncWriter{ nullptr };
+
+    /// @brief Determines if each .mid file is written under a temporary name
+    /// and renamed into place once it is complete.
+    ///
+    /// Anything watching the output directory then never sees a partially
+    /// written file. @see FileSink
+    bool atomicWrites{ false };
+
+    /// @brief The handlers that decode chunks other than the MIDI header and
+    /// tracks.
+    ///
+    /// When null, ChunkRegistry::BuiltIn() is used. Like the cache, the
+    /// registry is not owned by the options.
+    const ChunkRegistry* chunkRegistry{ nullptr };
+};
+
+#endif
@@ -0,0 +1,299 @@
+// ConversionServer.cpp - Defines the ConversionServer class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <filesystem>
+#include <memory>
+#include "ConversionCache.h"
+#include "ConversionServer.h"
+#include "GmdToMid.h"
+#include "MappedFile.h"
+#include "ServerProtocol.h"
+#include "WorkerPool.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+ConversionServer::~ConversionServer()
+{
+#ifndef _WIN32
+    if (listenSocket >= 0)
+    {
+        close(listenSocket);
+        unlink(socketPath.c_str());
+    }
+
+    for (int descriptor : wakePipe)
+    {
+        if (descriptor >= 0)
+            close(descriptor);
+    }
+#endif
+}
+
+#ifndef _WIN32
+
+bool ConversionServer::Start()
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path))
+    {
+        error = "The socket path must be between 1 and " + 
+                std::to_string(sizeof(address.sun_path) - 1) + " bytes";
+        return false;
+    }
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+    const sockaddr* socketAddress = reinterpret_cast<sockaddr*>(&address);
+
+    std::error_code fileError;
+    if (std::filesystem::is_socket(socketPath, fileError))
+    {
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool inUse = probe >= 0 && 
+                     connect(probe, socketAddress, sizeof(address)) == 0;
+        if (probe >= 0)
+            close(probe);
+        if (inUse)
+        {
+            error = "Another server is already listening on " + socketPath;
+            return false;
+        }
+        unlink(socketPath.c_str());
+    }
+
+    listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenSocket < 0 || 
+        bind(listenSocket, socketAddress, sizeof(address)) != 0)
+    {
+        error = "Unable to create " + socketPath + ": " + std::strerror(errno);
+        if (listenSocket >= 0)
+            close(listenSocket);
+        listenSocket = -1;
+        return false;
+    }
+
+    // Workers write to the pipe to wake the thread waiting for requests
+    // when they hand a connection back to it.
+    if (listen(listenSocket, SOMAXCONN) != 0 || pipe(wakePipe) != 0)
+    {
+        error = "Unable to listen on " + socketPath + ": " + 
+                std::strerror(errno);
+        return false;
+    }
+
+    fcntl(listenSocket, F_SETFD, FD_CLOEXEC);
+    for (int descriptor : wakePipe)
+    {
+        fcntl(descriptor, F_SETFL, fcntl(descriptor, F_GETFL) | O_NONBLOCK);
+        fcntl(descriptor, F_SETFD, FD_CLOEXEC);
+    }
+
+    return true;
+}
+
+void ConversionServer::Run()
+{
+    std::vector<int> idleSockets;
+    {
+        WorkerPool pool{ numWorkers };
+        std::vector<pollfd> descriptors;
+        while (!stopping)
+        {
+            {
+                std::lock_guard<std::mutex> lock{ mutex };
+                idleSockets.insert(idleSockets.end(), returnedSockets.begin(),
+                                   returnedSockets.end());
+                returnedSockets.clear();
+            }
+
+            descriptors.clear();
+            descriptors.push_back(pollfd{ listenSocket, POLLIN, 0 });
+            descriptors.push_back(pollfd{ wakePipe[0], POLLIN, 0 });
+            for (int socket : idleSockets)
+                descriptors.push_back(pollfd{ socket, POLLIN, 0 });
+
+            if (poll(descriptors.data(), descriptors.size(), 
+                     conversionServerWakeMs) <= 0)
+            {
+                continue;
+            }
+
+            uint8_t wakeBytes[64];
+            while (read(wakePipe[0], wakeBytes, sizeof(wakeBytes)) > 0)
+                continue;
+
+            // A connection with a request waiting, or that has hung up, is
+            // handed to a worker until the request has been answered.
+            idleSockets.clear();
+            for (size_t i = 2; i < descriptors.size(); i++)
+            {
+                int socket = descriptors[i].fd;
+                if (descriptors[i].revents == 0)
+                    idleSockets.push_back(socket);
+                else
+                    pool.Submit([this, socket] { ServeRequest(socket); });
+            }
+
+            if (descriptors[0].revents & POLLIN)
+            {
+                int socket = accept(listenSocket, nullptr, nullptr);
+                if (socket >= 0)
+                {
+                    // A client that stops halfway through a request only 
+                    // ties up its worker until the timeout.
+                    timeval timeout{ conversionServerReceiveTimeoutSeconds, 
+                                     0 };
+                    setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, 
+                               sizeof(timeout));
+                    fcntl(socket, F_SETFD, FD_CLOEXEC);
+                    idleSockets.push_back(socket);
+                }
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock{ mutex };
+    idleSockets.insert(idleSockets.end(), returnedSockets.begin(), 
+                       returnedSockets.end());
+    returnedSockets.clear();
+    for (int socket : idleSockets)
+        close(socket);
+}
+
+void ConversionServer::Stop()
+{
+    stopping = true;
+    if (wakePipe[1] >= 0)
+    {
+        uint8_t wakeByte{ 0 };
+        [[maybe_unused]] ssize_t numWritten = write(wakePipe[1], &wakeByte, 1);
+    }
+}
+
+void ConversionServer::ServeRequest(int socket)
+{
+    // Each worker keeps its buffer between requests, so answering a request
+    // only allocates when it is the largest the worker has seen.
+    thread_local std::vector<uint8_t> body;
+    if (!ReadMessage(socket, body))
+    {
+        close(socket);
+        return;
+    }
+
+    ResultCache::Result response = Answer(ByteSpan{ body.data(), 
+                                                    body.size() });
+    if (!WriteSocket(socket, response->data(), response->size()))
+    {
+        close(socket);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{ mutex };
+        returnedSockets.push_back(socket);
+    }
+
+    uint8_t wakeByte{ 0 };
+    [[maybe_unused]] ssize_t numWritten = write(wakePipe[1], &wakeByte, 1);
+}
+
+#else
+
+bool ConversionServer::Start()
+{
+    error = "The conversion server is not supported on this platform";
+    return false;
+}
+
+void ConversionServer::Run()
+{
+}
+
+void ConversionServer::Stop()
+{
+    stopping = true;
+}
+
+#endif
+
+ResultCache::Result ConversionServer::Answer(ByteSpan body)
+{
+    numRequests++;
+
+    ServerRequest request;
+    ConversionResult result;
+    if (!DecodeServerRequest(body, request, result.error))
+    {
+        numFailed++;
+        auto response = std::make_shared<std::vector<uint8_t>>();
+        EncodeServerResponse(result, *response);
+        return response;
+    }
+
+    // The file is only mapped while its response is produced; the response
+    // holds copies of everything it needs.
+    std::unique_ptr<MappedFile> file;
+    if (request.isPath)
+    {
+        file = std::make_unique<MappedFile>(request.name);
+        if (!file->Open())
+        {
+            numFailed++;
+            result.error = "Unable to open " + request.name;
+            auto response = std::make_shared<std::vector<uint8_t>>();
+            EncodeServerResponse(result, *response);
+            return response;
+        }
+        request.data = file->Data();
+    }
+
+    // The names of the .mid files come from the name of the .gmd file, so
+    // the same bytes under another name are a different response.
+    std::string stem = std::filesystem::path{ request.name }.stem().string();
+    std::string key = ConversionCache::Key(request.data, request.options) + 
+                      ";name=" + stem;
+    ResultCache::Result response = cache.Find(key);
+    if (response)
+        return response;
+
+    result = ConvertGmd(request.data, request.name, request.options);
+    if (!result.succeeded)
+        numFailed++;
+
+    // Failures are cached too, since the same bytes always fail the same way.
+    auto newResponse = std::make_shared<std::vector<uint8_t>>();
+    EncodeServerResponse(result, *newResponse);
+    cache.Store(key, newResponse);
+    return newResponse;
+}
+
+ConversionServerStats ConversionServer::Stats()
+{
+    ConversionServerStats stats;
+    stats.requests = numRequests;
+    stats.failed = numFailed;
+    stats.cache = cache.Stats();
+    return stats;
+}
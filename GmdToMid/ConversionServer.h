@@ -0,0 +1,129 @@
+// ConversionServer.h - Declares the ConversionServer class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CONVERSION_SERVER_H
+#define CONVERSION_SERVER_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ByteSpan.h"
+#include "ResultCache.h"
+
+/// @brief The longest the server waits before checking if it has been
+/// stopped, in milliseconds.
+inline constexpr int conversionServerWakeMs{ 100 };
+
+/// @brief The longest the server waits for the rest of a request once it
+/// has started to arrive, in seconds.
+inline constexpr int conversionServerReceiveTimeoutSeconds{ 30 };
+
+/// @brief Holds the counters of a ConversionServer.
+struct ConversionServerStats
+{
+    /// @brief The number of requests answered.
+    uint64_t requests{ 0 };
+
+    /// @brief The number of requests whose file couldn't be converted.
+    uint64_t failed{ 0 };
+
+    /// @brief The counters of the result cache.
+    ResultCacheStats cache;
+};
+
+/// @brief Converts .gmd files sent over a Unix domain socket.
+///
+/// Clients connect to the socket and send any number of requests, one at a
+/// time, each answered with the .mid files or the error. The messages are
+/// described by ServerRequest. A single thread accepts connections and
+/// waits for requests, and each request is then read, converted, and 
+/// answered by a worker, so a client that keeps its connection open
+/// between requests never ties up a worker.
+///
+/// Responses are kept in a ResultCache keyed by a hash of the .gmd file and
+/// the options, so a file requested again is answered without converting
+/// it, whether it was sent or read from a path.
+class ConversionServer
+{
+public:
+    /// @brief Constructor; creates a new ConversionServer.
+    /// @param socketPath The path of the socket to listen on.
+    /// @param numWorkers The number of workers, or 0 to match the hardware.
+    /// @param cacheSize The most bytes of responses to keep in memory.
+    ConversionServer(std::string socketPath, 
+                     size_t numWorkers = 0,
+                     size_t cacheSize = resultCacheDefaultSize) :
+        socketPath{ socketPath }, numWorkers{ numWorkers }, cache{ cacheSize }
+    { }
+
+    /// @brief Destructor; stops listening and removes the socket.
+    ~ConversionServer();
+
+    ConversionServer(const ConversionServer&) = delete;
+    ConversionServer& operator=(const ConversionServer&) = delete;
+
+    /// @brief Creates the socket and starts listening on it.
+    /// @return true if the server is listening, otherwise false.
+    ///
+    /// A socket left behind by a server that didn't exit cleanly is 
+    /// replaced, but one that another server is listening on is not.
+    bool Start();
+
+    /// @brief Answers requests until the server is stopped, then waits for
+    /// the requests being answered to finish.
+    /// @pre The server has been started.
+    void Run();
+
+    /// @brief Makes Run() return once the requests being answered finish.
+    ///
+    /// Only sets a lock free flag and writes to a pipe, so it is safe to 
+    /// call from another thread or a signal handler.
+    void Stop();
+
+    /// @brief Gets the counters of the server.
+    /// @return The counters.
+    ConversionServerStats Stats();
+
+    /// @brief Gets a description of the last error that occurred.
+    /// @return The error message, or an empty string if there was no error.
+    const std::string& Error() const { return error; }
+private:
+    std::string socketPath;
+    size_t numWorkers;
+    ResultCache cache;
+    int listenSocket{ -1 };
+    int wakePipe[2]{ -1, -1 };
+    std::atomic<bool> stopping{ false };
+    std::mutex mutex;
+    std::vector<int> returnedSockets;
+    std::atomic<uint64_t> numRequests{ 0 };
+    std::atomic<uint64_t> numFailed{ 0 };
+    std::string error;
+
+    /// @brief Reads, answers, and returns a connection to the waiting 
+    /// connections, or closes it if the client has hung up.
+    /// @param socket The connection, which has a request waiting.
+    void ServeRequest(int socket);
+
+    /// @brief Answers a request.
+    /// @param body The body of the request.
+    /// @return The response, including its size.
+    ResultCache::Result Answer(ByteSpan body);
+};
+
+#endif
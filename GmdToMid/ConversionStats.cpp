@@ -0,0 +1,117 @@
+// ConversionStats.cpp - Defines the ConversionStats struct.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <iomanip>
+#include "ConversionStats.h"
+#include "FourCC.h"
+#include "Json.h"
+
+void ConversionStats::Add(const ConversionStats& other)
+{
+    inputBytes += other.inputBytes;
+    bytesRead += other.bytesRead;
+    bytesWritten += other.bytesWritten;
+    filesWritten += other.filesWritten;
+    cacheHits += other.cacheHits;
+    cacheMisses += other.cacheMisses;
+    inputsSkipped += other.inputsSkipped;
+    orphansRemoved += other.orphansRemoved;
+    tracksDeduplicated += other.tracksDeduplicated;
+    bytesDeduplicated += other.bytesDeduplicated;
+    bytesOptimized += other.bytesOptimized;
+    for (const auto& [id, count] : other.chunkCounts)
+        chunkCounts[id] += count;
+    openSeconds += other.openSeconds;
+    indexSeconds += other.indexSeconds;
+    parseSeconds += other.parseSeconds;
+    writeSeconds += other.writeSeconds;
+    totalSeconds += other.totalSeconds;
+}
+
+/// @brief Writes the counters and timings shared by files and totals.
+/// @param out The stream to write the JSON members to.
+/// @param stats The stats to write.
+static void WriteStatsMembers(std::ostream& out, const ConversionStats& stats)
+{
+    out << "\"inputBytes\":" << stats.inputBytes
+        << ",\"bytesRead\":" << stats.bytesRead
+        << ",\"bytesWritten\":" << stats.bytesWritten
+        << ",\"filesWritten\":" << stats.filesWritten
+        << ",\"cache\":{\"hits\":" << stats.cacheHits
+        << ",\"misses\":" << stats.cacheMisses << "}"
+        << ",\"incremental\":{\"skipped\":" << stats.inputsSkipped
+        << ",\"orphansRemoved\":" << stats.orphansRemoved << "}"
+        << ",\"dedup\":{\"tracks\":" << stats.tracksDeduplicated
+        << ",\"bytes\":" << stats.bytesDeduplicated << "}"
+        << ",\"bytesOptimized\":" << stats.bytesOptimized
+        << ",\"chunks\":{";
+
+    bool first{ true };
+    for (const auto& [id, count] : stats.chunkCounts)
+    {
+        out << (first ? "" : ",") << JsonString(FourCCString(id)) << ":" 
+            << count;
+        first = false;
+    }
+
+    out << "},\"seconds\":{"
+        << "\"open\":" << stats.openSeconds
+        << ",\"index\":" << stats.indexSeconds
+        << ",\"parse\":" << stats.parseSeconds
+        << ",\"write\":" << stats.writeSeconds
+        << ",\"total\":" << stats.totalSeconds
+        << "}";
+}
+
+JsonReportWriter::JsonReportWriter(std::ostream& out) : out{ out }
+{
+    out << std::fixed << std::setprecision(6) << "{\"files\":[";
+}
+
+void JsonReportWriter::Add(const ConversionStats& file)
+{
+    out << (numFiles > 0 ? "," : "") << "\n{\"file\":" 
+        << JsonString(file.fileName)
+        << ",\"succeeded\":" << (file.succeeded ? "true" : "false") 
+        << ",";
+    WriteStatsMembers(out, file);
+    out << "}";
+
+    totals.Add(file);
+    numFiles++;
+    if (file.succeeded)
+        numSucceeded++;
+}
+
+void JsonReportWriter::Finish(double wallSeconds)
+{
+    out << "],\n\"totals\":{\"files\":" << numFiles
+        << ",\"succeeded\":" << numSucceeded
+        << ",\"failed\":" << numFiles - numSucceeded
+        << ",\"wallSeconds\":" << wallSeconds << ",";
+    WriteStatsMembers(out, totals);
+    out << "}}" << std::endl;
+}
+
+void WriteJsonReport(std::ostream& out, 
+                     const std::vector<ConversionStats>& files,
+                     double wallSeconds)
+{
+    JsonReportWriter writer{ out };
+    for (const ConversionStats& file : files)
+        writer.Add(file);
+    writer.Finish(wallSeconds);
+}
@@ -0,0 +1,173 @@
+// ConversionStats.h - Declares the ConversionStats struct.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CONVERSION_STATS_H
+#define CONVERSION_STATS_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/// @brief Holds the timings and counters gathered while converting a file.
+///
+/// The stages match the steps GmdFile goes through: opening (mapping) the
+/// file, building the chunk index, parsing (the MIDI header and any event
+/// decoding), and writing the .mid files.
+struct ConversionStats
+{
+    /// @brief The name of the .gmd file that was converted.
+    std::string fileName;
+
+    /// @brief Determines if the file was converted successfully.
+    bool succeeded{ false };
+
+    /// @brief The size of the .gmd file in bytes.
+    uint64_t inputBytes{ 0 };
+
+    /// @brief The number of bytes of the .gmd file that were actually read.
+    ///
+    /// Chunks that are skipped are never touched, so this is usually less
+    /// than inputBytes.
+    uint64_t bytesRead{ 0 };
+
+    /// @brief The number of bytes written to .mid files.
+    uint64_t bytesWritten{ 0 };
+
+    /// @brief The number of .mid files written.
+    uint64_t filesWritten{ 0 };
+
+    /// @brief The number of conversions restored from the cache.
+    uint64_t cacheHits{ 0 };
+
+    /// @brief The number of conversions that weren't in the cache.
+    uint64_t cacheMisses{ 0 };
+
+    /// @brief The number of inputs skipped because their outputs were
+    /// already up to date. @see IncrementalManifest
+    uint64_t inputsSkipped{ 0 };
+
+    /// @brief The number of outputs of earlier conversions removed because
+    /// they weren't written again.
+    uint64_t orphansRemoved{ 0 };
+
+    /// @brief The number of tracks that were duplicates of one already
+    /// exported, and so were linked or referenced instead of written.
+    uint64_t tracksDeduplicated{ 0 };
+
+    /// @brief The size of the .mid files that weren't written because they
+    /// were duplicates.
+    uint64_t bytesDeduplicated{ 0 };
+
+    /// @brief The number of bytes the tracks shrank by when they were 
+    /// re-encoded by the optimizer.
+    uint64_t bytesOptimized{ 0 };
+
+    /// @brief The number of chunks found, by chunk ID. @see MakeFourCC
+    std::map<uint32_t, uint64_t> chunkCounts;
+
+    /// @brief The time spent opening the file, in seconds.
+    double openSeconds{ 0 };
+
+    /// @brief The time spent building the chunk index, in seconds.
+    double indexSeconds{ 0 };
+
+    /// @brief The time spent parsing headers and events, in seconds.
+    double parseSeconds{ 0 };
+
+    /// @brief The time spent writing .mid files, in seconds.
+    ///
+    /// When tracks are exported in parallel, this is the sum of the time
+    /// each worker spent writing, so it can exceed totalSeconds.
+    double writeSeconds{ 0 };
+
+    /// @brief The total time spent converting the file, in seconds.
+    double totalSeconds{ 0 };
+
+    /// @brief Adds the counters and timings of another file to these.
+    /// @param other The stats to add.
+    void Add(const ConversionStats& other);
+};
+
+/// @brief Adds the time spent in a scope to a stage timing when destroyed.
+class StageTimer
+{
+public:
+    /// @brief Constructor; starts timing the stage.
+    /// @param seconds The stage timing to add the elapsed time to.
+    StageTimer(double& seconds) : 
+        seconds{ seconds }, start{ std::chrono::steady_clock::now() } 
+    { }
+
+    /// @brief Destructor; adds the elapsed time to the stage timing.
+    ~StageTimer() { seconds += Elapsed(); }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+    /// @brief Gets the time elapsed since the timer started.
+    /// @return The elapsed time in seconds.
+    double Elapsed() const
+    {
+        return std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+private:
+    double& seconds;
+    std::chrono::steady_clock::time_point start;
+};
+
+/// @brief Writes a JSON report one file at a time, as the files are 
+/// converted.
+///
+/// Only the totals are kept, so a report of a run that never ends, like a
+/// watch, takes no more memory after a million files than after one. The 
+/// report is only valid JSON once Finish() has been called.
+class JsonReportWriter
+{
+public:
+    /// @brief Constructor; writes the start of the report.
+    /// @param out The stream to write the report to.
+    JsonReportWriter(std::ostream& out);
+
+    JsonReportWriter(const JsonReportWriter&) = delete;
+    JsonReportWriter& operator=(const JsonReportWriter&) = delete;
+
+    /// @brief Writes the stats of a converted file to the report.
+    /// @param file The stats of the file.
+    void Add(const ConversionStats& file);
+
+    /// @brief Writes the totals of every file, which ends the report.
+    /// @param wallSeconds The wall clock time of the entire run, in seconds.
+    void Finish(double wallSeconds);
+private:
+    std::ostream& out;
+    ConversionStats totals;
+    uint64_t numFiles{ 0 };
+    uint64_t numSucceeded{ 0 };
+};
+
+/// @brief Writes a JSON report of the stats of every converted file.
+/// @param out The stream to write the report to.
+/// @param files The stats of each file.
+/// @param wallSeconds The wall clock time of the entire run, in seconds.
+void WriteJsonReport(std::ostream& out, 
+                     const std::vector<ConversionStats>& files,
+                     double wallSeconds);
+
+#endif
@@ -0,0 +1,64 @@
+// EventArena.cpp - Defines the EventArena class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include "EventArena.h"
+
+void EventArena::Reset()
+{
+    currentBlock = 0;
+    blockOffset = 0;
+    bytesAllocated = 0;
+}
+
+void* EventArena::AllocateBytes(size_t size, size_t alignment)
+{
+    // A zero length array still needs a unique, valid pointer.
+    size = std::max<size_t>(size, 1);
+
+    while (currentBlock < blocks.size())
+    {
+        Block& block = blocks[currentBlock];
+        auto address = reinterpret_cast<uintptr_t>(block.data.get());
+        size_t alignedOffset = 
+            ((address + blockOffset + alignment - 1) & ~(alignment - 1)) - 
+            address;
+
+        if (alignedOffset <= block.size && size <= block.size - alignedOffset)
+        {
+            blockOffset = alignedOffset + size;
+            bytesAllocated += size;
+            return block.data.get() + alignedOffset;
+        }
+
+        // The rest of this block is too small, so we move on to the next
+        // one. Blocks are only ever skipped, never revisited, until Reset().
+        currentBlock++;
+        blockOffset = 0;
+    }
+
+    // Oversized requests get a block of their own so a single huge track
+    // doesn't force every later block to be just as large.
+    size_t newBlockSize = std::max(blockSize, size + alignment);
+    // The block is deliberately left uninitialized; every array handed out
+    // of it is filled in by the caller anyway.
+    blocks.push_back(Block{ std::unique_ptr<uint8_t[]>{ 
+                                new uint8_t[newBlockSize] }, 
+                            newBlockSize });
+    currentBlock = blocks.size() - 1;
+    blockOffset = 0;
+    return AllocateBytes(size, alignment);
+}
@@ -0,0 +1,95 @@
+// EventArena.h - Declares the EventArena class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef EVENT_ARENA_H
+#define EVENT_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/// @brief The default size of each block of memory an EventArena allocates.
+inline constexpr size_t eventArenaBlockSize{ 64 * 1024 };
+
+/// @brief Represents a bump allocator for decoded MIDI events.
+///
+/// Decoding a file produces a handful of large arrays per track rather than
+/// one object per event, and every array lives exactly as long as the file
+/// does. The arena hands those arrays out of a few large blocks and frees
+/// them all at once, so decoding a file costs a few allocations instead of
+/// one per event. Reset() keeps the blocks around to be reused by the next
+/// file processed on the same thread.
+class EventArena
+{
+public:
+    /// @brief Constructor; creates a new, empty EventArena.
+    /// @param blockSize The minimum size of each block the arena allocates.
+    EventArena(size_t blockSize = eventArenaBlockSize) : 
+        blockSize{ blockSize }, currentBlock{ 0 }, blockOffset{ 0 } 
+    { }
+
+    EventArena(const EventArena&) = delete;
+    EventArena& operator=(const EventArena&) = delete;
+
+    /// @brief Allocates an uninitialized array from the arena.
+    /// @tparam T The type of the array elements.
+    /// @param count The number of elements in the array.
+    /// @return The array, which remains valid until Reset() is called.
+    template <typename T>
+    T* Allocate(size_t count)
+    {
+        // Nothing allocated from the arena is ever destroyed, so we only
+        // allow types that don't need to be.
+        static_assert(std::is_trivially_destructible_v<T>,
+                      "EventArena only supports trivially destructible types");
+
+        if (count > std::numeric_limits<size_t>::max() / sizeof(T))
+            throw std::bad_alloc{};
+
+        return static_cast<T*>(AllocateBytes(count * sizeof(T), alignof(T)));
+    }
+
+    /// @brief Releases every allocation while keeping the blocks for reuse.
+    void Reset();
+
+    /// @brief Gets the number of bytes handed out since the last Reset().
+    /// @return The number of bytes allocated.
+    size_t BytesAllocated() const { return bytesAllocated; }
+private:
+    struct Block
+    {
+        std::unique_ptr<uint8_t[]> data;
+        size_t size;
+    };
+
+    std::vector<Block> blocks;
+    size_t blockSize;
+    size_t currentBlock;
+    size_t blockOffset;
+    size_t bytesAllocated{ 0 };
+
+    /// @brief Allocates raw bytes from the arena.
+    /// @param size The number of bytes to allocate.
+    /// @param alignment The required alignment of the bytes.
+    /// @return The allocated bytes.
+    void* AllocateBytes(size_t size, size_t alignment);
+};
+
+#endif
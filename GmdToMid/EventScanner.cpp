@@ -0,0 +1,381 @@
+// EventScanner.cpp - Defines the EventScanner class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include "EventScanner.h"
+#include "MidiEvent.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+    defined(_M_IX86)
+#define EVENT_SCANNER_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only allow the intrinsics of instruction sets the whole
+// file is built for, unless a function asks for them itself, which lets
+// the rest of the program run on CPUs without them.
+#if defined(__GNUC__) || defined(__clang__)
+#define EVENT_SCANNER_TARGET(name) __attribute__((target(name)))
+#else
+#define EVENT_SCANNER_TARGET(name)
+#endif
+
+/// @brief The number of bytes each word of the bitmap covers.
+static constexpr size_t scanBitsPerWord{ 64 };
+
+/// @brief Counts the zero bits below the lowest set bit of a value.
+/// @param value The value, which must not be 0.
+/// @return The number of trailing zero bits.
+static inline unsigned CountTrailingZeros(uint64_t value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned>(__builtin_ctzll(value));
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return static_cast<unsigned>(index);
+#else
+    unsigned count{ 0 };
+    while ((value & 1) == 0)
+    {
+        value >>= 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+/// @brief Marks the bytes with their top bit set one byte at a time.
+/// @param bytes The bytes to mark.
+/// @param size The number of bytes.
+/// @param bits The bitmap to set the bits of, which must be zeroed.
+static void FindHighBitsScalar(const uint8_t* bytes, 
+                               size_t size, 
+                               uint64_t* bits)
+{
+    // Whole words are gathered in a register, which is about as well as
+    // can be done a byte at a time.
+    size_t i{ 0 };
+    for (; i + scanBitsPerWord <= size; i += scanBitsPerWord)
+    {
+        uint64_t word{ 0 };
+        for (size_t j = 0; j < scanBitsPerWord; j++)
+            word |= static_cast<uint64_t>(bytes[i + j] >> 7) << j;
+        bits[i / scanBitsPerWord] = word;
+    }
+
+    for (; i < size; i++)
+    {
+        bits[i / scanBitsPerWord] |= 
+            static_cast<uint64_t>(bytes[i] >> 7) << (i % scanBitsPerWord);
+    }
+}
+
+#ifdef EVENT_SCANNER_X86
+
+/// @brief Marks the bytes with their top bit set 16 bytes at a time.
+/// @param bytes The bytes to mark.
+/// @param size The number of bytes.
+/// @param bits The bitmap to set the bits of, which must be zeroed.
+EVENT_SCANNER_TARGET("sse2")
+static void FindHighBitsSse2(const uint8_t* bytes, 
+                             size_t size, 
+                             uint64_t* bits)
+{
+    // movemask gathers the top bit of every byte, which is exactly the bit
+    // we want for each byte.
+    size_t i{ 0 };
+    for (; i + scanBitsPerWord <= size; i += scanBitsPerWord)
+    {
+        uint64_t word{ 0 };
+        for (size_t part = 0; part < scanBitsPerWord; part += 16)
+        {
+            __m128i block = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(bytes + i + part));
+            word |= static_cast<uint64_t>(static_cast<uint32_t>(
+                _mm_movemask_epi8(block))) << part;
+        }
+        bits[i / scanBitsPerWord] = word;
+    }
+
+    FindHighBitsScalar(bytes + i, size - i, bits + i / scanBitsPerWord);
+}
+
+/// @brief Marks the bytes with their top bit set 32 bytes at a time.
+/// @param bytes The bytes to mark.
+/// @param size The number of bytes.
+/// @param bits The bitmap to set the bits of, which must be zeroed.
+EVENT_SCANNER_TARGET("avx2")
+static void FindHighBitsAvx2(const uint8_t* bytes, 
+                             size_t size, 
+                             uint64_t* bits)
+{
+    size_t i{ 0 };
+    for (; i + scanBitsPerWord <= size; i += scanBitsPerWord)
+    {
+        __m256i low = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(bytes + i));
+        __m256i high = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(bytes + i + 32));
+        bits[i / scanBitsPerWord] = 
+            static_cast<uint64_t>(static_cast<uint32_t>(
+                _mm256_movemask_epi8(low))) |
+            static_cast<uint64_t>(static_cast<uint32_t>(
+                _mm256_movemask_epi8(high))) << 32;
+    }
+
+    FindHighBitsScalar(bytes + i, size - i, bits + i / scanBitsPerWord);
+}
+
+#endif
+
+const char* ScanPathName(ScanPath path)
+{
+    switch (path)
+    {
+        case ScanPath::Scalar:
+            return "scalar";
+        case ScanPath::Sse2:
+            return "sse2";
+        case ScanPath::Avx2:
+            return "avx2";
+        default:
+            return "unknown";
+    }
+}
+
+bool ScanPathSupported(ScanPath path)
+{
+    switch (path)
+    {
+        case ScanPath::Scalar:
+            return true;
+#if defined(EVENT_SCANNER_X86) && (defined(__GNUC__) || defined(__clang__))
+        case ScanPath::Sse2:
+            return __builtin_cpu_supports("sse2");
+        case ScanPath::Avx2:
+            return __builtin_cpu_supports("avx2");
+#elif defined(EVENT_SCANNER_X86) && defined(_MSC_VER)
+        case ScanPath::Sse2:
+        {
+            int info[4];
+            __cpuid(info, 1);
+            return (info[3] & (1 << 26)) != 0;
+        }
+        case ScanPath::Avx2:
+        {
+            // The OS must also save the AVX registers on context switches.
+            int info[4];
+            __cpuid(info, 1);
+            bool osSavesAvx = (info[2] & (1 << 27)) != 0 && 
+                              (_xgetbv(0) & 0x6) == 0x6;
+            __cpuidex(info, 7, 0);
+            return osSavesAvx && (info[1] & (1 << 5)) != 0;
+        }
+#endif
+        default:
+            return false;
+    }
+}
+
+ScanPath BestScanPath()
+{
+    static const ScanPath best = []
+    {
+        if (ScanPathSupported(ScanPath::Avx2))
+            return ScanPath::Avx2;
+        if (ScanPathSupported(ScanPath::Sse2))
+            return ScanPath::Sse2;
+        return ScanPath::Scalar;
+    }();
+    return best;
+}
+
+bool EventScanner::Scan(ByteSpan track)
+{
+    offsets.clear();
+    reachedEndOfTrack = false;
+    error.clear();
+
+    FindHighBits(track);
+    if (FindEvents(track))
+        return true;
+
+    // The scanner only knows that the track is malformed, so the cursor
+    // decodes it again to say where and why.
+    EventCursor cursor{ track };
+    MidiEvent event;
+    while (cursor.Next(event)) { }
+    error = cursor.HasError() ? cursor.Error() : "Malformed track";
+    offsets.clear();
+    return false;
+}
+
+void EventScanner::FindHighBits(ByteSpan track)
+{
+    // The bitmap has a spare word at the end, so the word after any byte
+    // can always be read.
+    highBits.assign(track.size / scanBitsPerWord + 2, 0);
+    switch (path)
+    {
+#ifdef EVENT_SCANNER_X86
+        case ScanPath::Sse2:
+            FindHighBitsSse2(track.data, track.size, highBits.data());
+            break;
+        case ScanPath::Avx2:
+            FindHighBitsAvx2(track.data, track.size, highBits.data());
+            break;
+#endif
+        default:
+            FindHighBitsScalar(track.data, track.size, highBits.data());
+            break;
+    }
+}
+
+bool EventScanner::FindEvents(ByteSpan track)
+{
+    const uint8_t* bytes = track.data;
+    const size_t size = track.size;
+    const uint64_t* bits = highBits.data();
+
+    // Gets the bits of the 64 bytes starting at a position. Bytes past the
+    // end of the track read as 0, so every run of set bits ends.
+    auto bitsAt = [bits](size_t position)
+    {
+        size_t word = position / scanBitsPerWord;
+        unsigned shift = position % scanBitsPerWord;
+        uint64_t value = bits[word] >> shift;
+        if (shift != 0)
+            value |= bits[word + 1] << (scanBitsPerWord - shift);
+        return value;
+    };
+
+    // Gets the number of bytes in the variable length quantity at a 
+    // position, or 0 if it is too long or runs past the end of the track.
+    auto varLenSize = [&](size_t position) -> size_t
+    {
+        size_t numHigh = CountTrailingZeros(~bitsAt(position) | 
+                                            (uint64_t{ 1 } << 63));
+        if (numHigh >= midiMaxVarLenSize || position + numHigh >= size)
+            return 0;
+        return numHigh + 1;
+    };
+
+    offsets.reserve(size / 3 + 1);
+    size_t position{ 0 };
+    uint8_t runningStatus{ 0 };
+    while (position < size)
+    {
+        // Events with one byte delta times that use running status have no
+        // bytes with their top bit set, so when the next such byte is far
+        // enough away, every event until then is the same size.
+        if (runningStatus != 0 && position + 1 < size && 
+            (bytes[position] | bytes[position + 1]) < 0x80)
+        {
+            size_t eventSize = 1 + ChannelEventDataLength(runningStatus);
+            for (;;)
+            {
+                size_t numClear = CountTrailingZeros(
+                    bitsAt(position) | (uint64_t{ 1 } << 63));
+                size_t runEnd = std::min(position + numClear, size);
+                size_t runStart = position;
+                for (; position + eventSize <= runEnd; position += eventSize)
+                    offsets.push_back(static_cast<uint32_t>(position));
+
+                // A run of 63 is only as far as one look can see, so the run
+                // may carry on past it.
+                if (numClear < 63 || position == runStart)
+                    break;
+            }
+            if (position >= size)
+                break;
+        }
+
+        // Most delta times are a single byte, which needs no counting.
+        offsets.push_back(static_cast<uint32_t>(position));
+        if (bytes[position] < 0x80)
+        {
+            position++;
+        }
+        else
+        {
+            size_t deltaSize = varLenSize(position);
+            if (deltaSize == 0)
+                return false;
+            position += deltaSize;
+        }
+
+        if (position >= size)
+            return false;
+        uint8_t status = bytes[position];
+        if (status >= 0x80)
+            position++;
+        else if (runningStatus != 0)
+            status = runningStatus;
+        else
+            return false;
+
+        if (status < midiSysEx)
+        {
+            // The data bytes must all be clear in the bitmap, as only status
+            // bytes may have their top bit set.
+            uint32_t dataLength = ChannelEventDataLength(status);
+            runningStatus = status;
+            if (position + dataLength > size ||
+                (bitsAt(position) & ((uint64_t{ 1 } << dataLength) - 1)) != 0)
+            {
+                return false;
+            }
+            position += dataLength;
+            continue;
+        }
+
+        uint8_t metaType{ 0 };
+        if (status == midiMeta)
+        {
+            if (position >= size)
+                return false;
+            metaType = bytes[position++];
+        }
+        else if (status != midiSysEx && status != midiSysExEscape)
+        {
+            return false;
+        }
+
+        size_t lengthSize = varLenSize(position);
+        if (lengthSize == 0)
+            return false;
+        uint32_t length{ 0 };
+        for (size_t i = 0; i < lengthSize; i++)
+            length = (length << 7) | (bytes[position + i] & 0x7F);
+        position += lengthSize;
+
+        if (length > size - position)
+            return false;
+        position += length;
+
+        if (status == midiMeta && metaType == midiMetaEndOfTrack)
+        {
+            reachedEndOfTrack = true;
+            break;
+        }
+    }
+
+    return true;
+}
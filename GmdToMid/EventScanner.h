@@ -0,0 +1,121 @@
+// EventScanner.h - Declares the EventScanner class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef EVENT_SCANNER_H
+#define EVENT_SCANNER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ByteSpan.h"
+
+/// @brief The ways an EventScanner can find the bytes with their top bit
+/// set, from slowest to fastest.
+enum class ScanPath
+{
+    /// @brief One byte at a time, which works on every CPU.
+    Scalar,
+
+    /// @brief 16 bytes at a time with SSE2.
+    Sse2,
+
+    /// @brief 32 bytes at a time with AVX2.
+    Avx2
+};
+
+/// @brief Gets the name of a scan path, used in messages.
+/// @param path The scan path.
+/// @return The name, e.g. "avx2".
+const char* ScanPathName(ScanPath path);
+
+/// @brief Determines if the CPU the program is running on, and the 
+/// compiler it was built with, support a scan path.
+/// @param path The scan path.
+/// @return true if the path can be used, otherwise false.
+bool ScanPathSupported(ScanPath path);
+
+/// @brief Gets the fastest scan path the CPU supports.
+/// @return The scan path, which is detected once and then remembered.
+ScanPath BestScanPath();
+
+/// @brief Finds where every event in a MIDI track starts, without decoding
+/// the events.
+///
+/// The scanner first marks every byte of the track with its top bit set,
+/// 16 or 32 bytes at a time where the CPU allows, in a bitmap. Status bytes
+/// and the bytes of a variable length quantity that aren't its last are
+/// exactly those bytes, so the end of a delta time or length is found by
+/// counting the marked bits that follow it, and a run of events that all
+/// use running status and one byte delta times, which has no marked bytes
+/// at all, is stepped over in one go.
+///
+/// The scanner accepts exactly the tracks EventCursor does and finds the
+/// same events, so it can stand in for a first pass with EventCursor that
+/// only needs to know where the events are, or that the track is well 
+/// formed. When it isn't, the track is decoded again with EventCursor to
+/// describe the problem.
+class EventScanner
+{
+public:
+    /// @brief Constructor; creates a new EventScanner.
+    /// @param path The way to find the bytes with their top bit set, which
+    /// must be supported.
+    EventScanner(ScanPath path = BestScanPath()) : path{ path } { }
+
+    /// @brief Finds every event in a track.
+    /// @param track The data of the MIDI track chunk, excluding its header.
+    /// @return true if the track was scanned, or false if it is malformed
+    /// (see Error()).
+    ///
+    /// Like EventCursor, the scan stops after the end of track meta event.
+    bool Scan(ByteSpan track);
+
+    /// @brief Gets the offset of every event found by the last scan.
+    /// @return The offsets of the events, starting with their delta times,
+    /// in the order of the events.
+    const std::vector<uint32_t>& Offsets() const { return offsets; }
+
+    /// @brief Gets the number of events found by the last scan.
+    /// @return The number of events.
+    size_t NumEvents() const { return offsets.size(); }
+
+    /// @brief Determines if the last scan found the end of track meta 
+    /// event.
+    /// @return true if the end of track was reached.
+    bool ReachedEndOfTrack() const { return reachedEndOfTrack; }
+
+    /// @brief Gets a description of the error that stopped the last scan.
+    /// @return The error message, or an empty string if there was no error.
+    const std::string& Error() const { return error; }
+private:
+    ScanPath path;
+    std::vector<uint64_t> highBits;
+    std::vector<uint32_t> offsets;
+    bool reachedEndOfTrack{ false };
+    std::string error;
+
+    /// @brief Marks every byte of a track with its top bit set in highBits.
+    /// @param track The track data.
+    void FindHighBits(ByteSpan track);
+
+    /// @brief Steps from event to event using highBits.
+    /// @param track The track data.
+    /// @return true if every event was found, or false if the track is 
+    /// malformed.
+    bool FindEvents(ByteSpan track);
+};
+
+#endif
@@ -0,0 +1,84 @@
+// EventStore.cpp - Defines the EventStore class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "EventScanner.h"
+#include "EventStore.h"
+
+bool EventStore::Decode(ByteSpan track, EventArena& arena)
+{
+    this->track = track;
+    count = 0;
+    error.clear();
+
+    // The first pass only needs to know how many events there are, which
+    // the scanner finds without decoding them. Each thread keeps its own
+    // scanner so its buffers are reused from track to track.
+    thread_local EventScanner scanner;
+    if (!scanner.Scan(track))
+    {
+        error = scanner.Error();
+        return false;
+    }
+    count = scanner.NumEvents();
+
+    ticks = arena.Allocate<uint32_t>(count);
+    offsets = arena.Allocate<uint32_t>(count);
+    dataOffsets = arena.Allocate<uint32_t>(count);
+    dataLengths = arena.Allocate<uint32_t>(count);
+    statuses = arena.Allocate<uint8_t>(count);
+    metaTypes = arena.Allocate<uint8_t>(count);
+
+    // The first pass already proved the track is well formed, so the second
+    // pass should produce exactly count events. The two passes are separate
+    // decoders, though, so a disagreement is reported rather than trusted,
+    // and never writes past the arrays.
+    MidiEvent event;
+    EventCursor cursor{ track };
+    size_t numDecoded{ 0 };
+    while (numDecoded < count && cursor.Next(event))
+    {
+        ticks[numDecoded] = event.tick;
+        offsets[numDecoded] = event.offset;
+        dataOffsets[numDecoded] = event.dataOffset;
+        dataLengths[numDecoded] = event.dataLength;
+        statuses[numDecoded] = event.status;
+        metaTypes[numDecoded] = event.metaType;
+        numDecoded++;
+    }
+
+    if (numDecoded < count || cursor.Next(event) || cursor.HasError())
+    {
+        error = cursor.HasError() ? cursor.Error() : 
+            "The scanner and the decoder disagree on the number of events";
+        count = 0;
+        return false;
+    }
+
+    return true;
+}
+
+MidiEvent EventStore::Event(size_t i) const
+{
+    MidiEvent event;
+    event.tick = ticks[i];
+    event.delta = i > 0 ? ticks[i] - ticks[i - 1] : ticks[i];
+    event.offset = offsets[i];
+    event.status = statuses[i];
+    event.metaType = metaTypes[i];
+    event.dataOffset = dataOffsets[i];
+    event.dataLength = dataLengths[i];
+    return event;
+}
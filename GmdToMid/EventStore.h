@@ -0,0 +1,106 @@
+// EventStore.h - Declares the EventStore class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef EVENT_STORE_H
+#define EVENT_STORE_H
+
+#include <string>
+#include "ByteSpan.h"
+#include "EventArena.h"
+#include "MidiEvent.h"
+
+/// @brief Holds every event decoded from a MIDI track.
+///
+/// The events are stored as a structure of arrays: one array per field,
+/// each allocated from an EventArena. Scans that only care about one or
+/// two fields (e.g. looking for tempo changes) then walk densely packed
+/// memory instead of striding over whole event objects. Event data is not
+/// copied; the offsets refer to the bytes of the track.
+class EventStore
+{
+public:
+    /// @brief Decodes every event in a track into the store.
+    /// @param track The data of the MIDI track chunk, excluding its header.
+    /// @param arena The arena to allocate the event arrays from.
+    /// @return true if the track was decoded, otherwise false.
+    ///
+    /// The track is decoded in two passes: the first counts the events so
+    /// that every array can be allocated at its exact size, and the second
+    /// fills them in. Decoding fails if the second pass finds a different
+    /// number of events than the first.
+    bool Decode(ByteSpan track, EventArena& arena);
+
+    /// @brief Gets the number of events in the store.
+    /// @return The number of events.
+    size_t Size() const { return count; }
+
+    /// @brief Gets the track the events were decoded from.
+    /// @return The track data.
+    ByteSpan Track() const { return track; }
+
+    /// @brief Gets the tick of the specified event.
+    /// @param i The index of the event.
+    /// @return The number of ticks since the start of the track.
+    uint32_t Tick(size_t i) const { return ticks[i]; }
+
+    /// @brief Gets the status of the specified event.
+    /// @param i The index of the event.
+    /// @return The status byte, with running status already resolved.
+    uint8_t Status(size_t i) const { return statuses[i]; }
+
+    /// @brief Gets the meta event type of the specified event.
+    /// @param i The index of the event.
+    /// @return The meta event type, which is only valid for meta events.
+    uint8_t MetaType(size_t i) const { return metaTypes[i]; }
+
+    /// @brief Gets the offset of the specified event within the track.
+    /// @param i The index of the event.
+    /// @return The offset of the event, starting with its delta time.
+    uint32_t Offset(size_t i) const { return offsets[i]; }
+
+    /// @brief Gets the data bytes of the specified event.
+    /// @param i The index of the event.
+    /// @return The data that follows the status (and length, if any).
+    ByteSpan Data(size_t i) const
+    {
+        return ByteSpan{ track.data + dataOffsets[i], dataLengths[i] };
+    }
+
+    /// @brief Gets the specified event as a MidiEvent.
+    /// @param i The index of the event.
+    /// @return The event.
+    MidiEvent Event(size_t i) const;
+
+    /// @brief Gets the tick of the last event in the track.
+    /// @return The tick of the last event, or 0 if there are no events.
+    uint32_t EndTick() const { return count > 0 ? ticks[count - 1] : 0; }
+
+    /// @brief Gets a description of the error that stopped decoding.
+    /// @return The error message, or an empty string if there was no error.
+    const std::string& Error() const { return error; }
+private:
+    ByteSpan track;
+    size_t count{ 0 };
+    uint32_t* ticks{ nullptr };
+    uint32_t* offsets{ nullptr };
+    uint32_t* dataOffsets{ nullptr };
+    uint32_t* dataLengths{ nullptr };
+    uint8_t* statuses{ nullptr };
+    uint8_t* metaTypes{ nullptr };
+    std::string error;
+};
+
+#endif
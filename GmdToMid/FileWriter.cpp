@@ -0,0 +1,143 @@
+// FileWriter.cpp - Defines functions for writing files in pieces.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <filesystem>
+#include "FileWriter.h"
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+#endif
+
+#ifdef _WIN32
+
+bool WriteFilePieces(const std::string& path, 
+                     const ByteSpan* pieces, 
+                     size_t numPieces)
+{
+    std::error_code error;
+    std::filesystem::remove(path, error);
+
+    std::ofstream stream{ path, std::ios::binary | std::ios::trunc };
+    if (!stream)
+        return false;
+
+    for (size_t i = 0; i < numPieces; i++)
+    {
+        stream.write(reinterpret_cast<const char*>(pieces[i].data), 
+                     static_cast<std::streamsize>(pieces[i].size));
+    }
+
+    stream.close();
+    return !stream.fail();
+}
+
+#else
+
+/// @brief Opens a file for writing, replacing any existing file.
+/// @param path The path of the file.
+/// @return The file descriptor, or -1 if the file couldn't be opened.
+static int OpenOutputFile(const std::string& path)
+{
+    std::error_code error;
+    std::filesystem::remove(path, error);
+    return open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+}
+
+/// @brief Moves past the bytes of a vectored write that were written.
+/// @param vectors The vectors being written.
+/// @param first The first vector that isn't completely written.
+/// @param written The number of bytes the last write wrote.
+static void AdvanceVectors(std::vector<iovec>& vectors, 
+                           size_t& first, 
+                           size_t written)
+{
+    while (first < vectors.size() && written >= vectors[first].iov_len)
+    {
+        written -= vectors[first].iov_len;
+        first++;
+    }
+
+    if (written > 0)
+    {
+        vectors[first].iov_base = 
+            static_cast<uint8_t*>(vectors[first].iov_base) + written;
+        vectors[first].iov_len -= written;
+    }
+}
+
+/// @brief Gets the number of vectors that can be written at once.
+/// @param vectors The vectors being written.
+/// @param first The first vector that isn't completely written.
+/// @return The number of vectors to write.
+static int VectorCount(const std::vector<iovec>& vectors, size_t first)
+{
+    return static_cast<int>(
+        std::min<size_t>(vectors.size() - first, IOV_MAX));
+}
+
+bool WriteFilePieces(const std::string& path, 
+                     const ByteSpan* pieces, 
+                     size_t numPieces)
+{
+    int fd = OpenOutputFile(path);
+    if (fd < 0)
+        return false;
+
+    // Each thread keeps its vectors from file to file, so writing a file
+    // allocates nothing once the vectors have grown to fit.
+    thread_local std::vector<iovec> vectors;
+    vectors.clear();
+    for (size_t i = 0; i < numPieces; i++)
+    {
+        if (pieces[i].size > 0)
+        {
+            vectors.push_back(iovec{ const_cast<uint8_t*>(pieces[i].data), 
+                                     pieces[i].size });
+        }
+    }
+
+    // Normally the whole file goes out in one call, but writev may stop 
+    // short, in which case we carry on from where it stopped.
+    size_t first{ 0 };
+    bool succeeded{ true };
+    while (first < vectors.size())
+    {
+        ssize_t written = writev(fd, vectors.data() + first, 
+                                 VectorCount(vectors, first));
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            succeeded = false;
+            break;
+        }
+
+        AdvanceVectors(vectors, first, static_cast<size_t>(written));
+    }
+
+    return close(fd) == 0 && succeeded;
+}
+
+#endif
@@ -0,0 +1,40 @@
+// FileWriter.h - Declares functions for writing files in pieces.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FILE_WRITER_H
+#define FILE_WRITER_H
+
+#include <cstddef>
+#include <string>
+#include "ByteSpan.h"
+
+/// @brief Writes a file made up of the specified pieces, replacing any
+/// existing file.
+/// @param path The path of the file.
+/// @param pieces The pieces of the file, in order.
+/// @param numPieces The number of pieces.
+/// @return true if the file was written, otherwise false.
+///
+/// On POSIX systems the pieces normally go out in a single writev, so the
+/// headers of a MIDI file and its track data cost one system call between
+/// them, and nothing is allocated once the calling thread has written its
+/// first file. An existing file is removed rather than overwritten in 
+/// place, since it may be a hard link to a file restored from a cache.
+bool WriteFilePieces(const std::string& path, 
+                     const ByteSpan* pieces, 
+                     size_t numPieces);
+
+#endif
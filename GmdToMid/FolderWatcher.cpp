@@ -0,0 +1,283 @@
+// FolderWatcher.cpp - Defines the FolderWatcher class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstring>
+#include <set>
+#include <thread>
+#include "BatchConverter.h"
+#include "FolderWatcher.h"
+
+#ifdef __linux__
+#include <cerrno>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+FolderWatcher::~FolderWatcher()
+{
+#ifdef __linux__
+    // Closing the descriptor removes every watch along with it.
+    if (inotifyFd >= 0)
+        close(inotifyFd);
+#endif
+}
+
+bool FolderWatcher::Start()
+{
+    std::error_code fileError;
+    for (const std::filesystem::path& directory : directories)
+    {
+        if (!std::filesystem::is_directory(directory, fileError))
+        {
+            error = "Not a directory: " + directory.string();
+            return false;
+        }
+    }
+
+#ifdef __linux__
+    // Without inotify, e.g. when the limit on instances has been reached,
+    // we can still scan the directories, just not as promptly.
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    for (size_t i = 0; inotifyFd >= 0 && i < directories.size(); i++)
+    {
+        // IN_MODIFY arrives with every write, which keeps restarting the
+        // debounce of a file while it is still being written. Files that
+        // are removed or renamed away are forgotten.
+        int watch = inotify_add_watch(inotifyFd, directories[i].c_str(),
+                                      IN_CREATE | IN_MODIFY | 
+                                      IN_CLOSE_WRITE | IN_MOVED_TO |
+                                      IN_DELETE | IN_MOVED_FROM);
+        if (watch < 0)
+        {
+            error = "Unable to watch " + directories[i].string() + ": " + 
+                    std::strerror(errno);
+            return false;
+        }
+        watches[watch] = directories[i];
+    }
+#endif
+
+    // Files that arrived while we weren't watching are picked up by the
+    // first scan, which also finds every file when scanning is all we have.
+    Scan();
+    nextScan = Clock::now() + debounce;
+    return true;
+}
+
+bool FolderWatcher::Next(std::vector<std::filesystem::path>& ready)
+{
+    size_t numReadyBefore = ready.size();
+    while (!stopping)
+    {
+        TakeReady(ready);
+        if (ready.size() > numReadyBefore)
+            return true;
+
+        // We wake up in time for the next file to become ready, but also
+        // regularly enough to notice being stopped.
+        auto timeout = std::chrono::milliseconds{ folderWatcherWakeMs };
+        Clock::time_point now = Clock::now();
+        for (const auto& [file, pendingFile] : pending)
+        {
+            auto untilReady = std::chrono::ceil<std::chrono::milliseconds>(
+                pendingFile.deadline - now);
+            timeout = std::max(std::chrono::milliseconds{ 0 }, 
+                               std::min(timeout, untilReady));
+        }
+
+        WaitForChanges(timeout);
+    }
+
+    return false;
+}
+
+void FolderWatcher::WaitForChanges(std::chrono::milliseconds timeout)
+{
+#ifdef __linux__
+    if (inotifyFd >= 0)
+    {
+        pollfd descriptor{ inotifyFd, POLLIN, 0 };
+        if (poll(&descriptor, 1, static_cast<int>(timeout.count())) > 0)
+            ReadEvents();
+        return;
+    }
+#endif
+
+    std::this_thread::sleep_for(timeout);
+    if (Clock::now() >= nextScan)
+    {
+        Scan();
+        nextScan = Clock::now() + debounce;
+    }
+}
+
+void FolderWatcher::ReadEvents()
+{
+#ifdef __linux__
+    alignas(inotify_event) char buffer[4096];
+    while (true)
+    {
+        ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+        if (length <= 0)
+            break;
+
+        for (char* position = buffer; position < buffer + length; )
+        {
+            const inotify_event* event = 
+                reinterpret_cast<const inotify_event*>(position);
+            position += sizeof(inotify_event) + event->len;
+
+            // When events are dropped we can't know which files they were
+            // for, so we look at every file instead.
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                Scan();
+                continue;
+            }
+
+            auto watch = watches.find(event->wd);
+            if (watch == watches.end() || event->len == 0)
+                continue;
+
+            std::filesystem::path file = watch->second / event->name;
+            FileState state;
+            if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+                Forget(file);
+            else if (HasGmdExtension(file) && GetFileState(file, state))
+                Touch(file, state);
+        }
+    }
+#endif
+}
+
+void FolderWatcher::Scan()
+{
+    auto dirOptions = std::filesystem::directory_options::skip_permission_denied;
+    std::set<std::filesystem::path> found;
+    bool complete{ true };
+    for (const std::filesystem::path& directory : directories)
+    {
+        std::error_code fileError;
+        std::filesystem::directory_iterator it{ directory, dirOptions, 
+                                                fileError };
+        for (; !fileError && it != std::filesystem::directory_iterator{};
+             it.increment(fileError))
+        {
+            FileState state;
+            if (!HasGmdExtension(it->path()) || 
+                !GetFileState(it->path(), state))
+            {
+                continue;
+            }
+
+            found.insert(it->path());
+
+            // A file that is already pending only restarts its debounce if
+            // it has changed again, otherwise it would never become ready.
+            auto pendingFile = pending.find(it->path());
+            auto seenFile = seen.find(it->path());
+            if (pendingFile != pending.end())
+            {
+                if (!(pendingFile->second.state == state))
+                    Touch(it->path(), state);
+            }
+            else if (seenFile == seen.end() || !(seenFile->second == state))
+            {
+                Touch(it->path(), state);
+            }
+        }
+
+        if (fileError)
+            complete = false;
+    }
+
+    // Files the scan no longer finds were removed, but only a complete scan
+    // can tell, otherwise every file it missed would be reported again once
+    // it is found.
+    if (!complete)
+        return;
+
+    for (auto seenFile = seen.begin(); seenFile != seen.end(); )
+    {
+        if (found.count(seenFile->first) == 0)
+            seenFile = seen.erase(seenFile);
+        else
+            ++seenFile;
+    }
+}
+
+void FolderWatcher::Touch(const std::filesystem::path& file, 
+                          const FileState& state)
+{
+    pending[file] = PendingFile{ Clock::now() + debounce, state };
+}
+
+void FolderWatcher::Forget(const std::filesystem::path& file)
+{
+    pending.erase(file);
+    seen.erase(file);
+}
+
+void FolderWatcher::TakeReady(std::vector<std::filesystem::path>& ready)
+{
+    Clock::time_point now = Clock::now();
+    for (auto it = pending.begin(); it != pending.end(); )
+    {
+        PendingFile& pendingFile = it->second;
+        FileState state;
+        if (pendingFile.deadline > now)
+        {
+            ++it;
+        }
+        else if (!GetFileState(it->first, state))
+        {
+            // The file was removed or renamed away before it was ready.
+            seen.erase(it->first);
+            it = pending.erase(it);
+        }
+        else if (!(state == pendingFile.state))
+        {
+            // Some writers, such as those on network file systems, don't
+            // produce events for every write, so the size and write time
+            // have the last word on whether a file is still changing.
+            pendingFile = PendingFile{ now + debounce, state };
+            ++it;
+        }
+        else
+        {
+            seen[it->first] = state;
+            ready.push_back(it->first);
+            it = pending.erase(it);
+        }
+    }
+}
+
+bool FolderWatcher::GetFileState(const std::filesystem::path& file, 
+                                 FileState& state)
+{
+    std::error_code fileError;
+    if (!std::filesystem::is_regular_file(file, fileError))
+        return false;
+
+    state.size = std::filesystem::file_size(file, fileError);
+    if (fileError)
+        return false;
+
+    state.writeTime = std::filesystem::last_write_time(file, fileError);
+    return !fileError;
+}
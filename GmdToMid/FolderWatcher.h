@@ -0,0 +1,161 @@
+// FolderWatcher.h - Declares the FolderWatcher class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FOLDER_WATCHER_H
+#define FOLDER_WATCHER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+/// @brief The time a file must go without changing before it is ready, in
+/// milliseconds, unless another is specified.
+inline constexpr int folderWatcherDefaultDebounceMs{ 250 };
+
+/// @brief The longest FolderWatcher::Next() waits before checking if it has
+/// been stopped, in milliseconds.
+inline constexpr int folderWatcherWakeMs{ 100 };
+
+/// @brief Watches directories for .gmd files that are new or have changed.
+///
+/// A file is only reported once it has gone unchanged for the debounce time
+/// and its size is the same as when it last changed, so files that are 
+/// still being written or copied into a directory aren't picked up halfway.
+/// Every .gmd file already in the directories is reported when watching
+/// starts, so nothing dropped in while the watcher wasn't running is missed.
+///
+/// On Linux the directories are watched with inotify, so a file is noticed
+/// as soon as it is written. Elsewhere, or if inotify isn't available, the
+/// directories are scanned once per debounce time instead. Subdirectories
+/// are not watched. Files that are removed are forgotten, so a watcher that
+/// sees a steady stream of files come and go doesn't grow without bound.
+class FolderWatcher
+{
+public:
+    /// @brief Constructor; creates a new FolderWatcher.
+    /// @param directories The directories to watch.
+    /// @param debounce The time a file must go unchanged before it is ready.
+    FolderWatcher(std::vector<std::filesystem::path> directories,
+                  std::chrono::milliseconds debounce = 
+                      std::chrono::milliseconds{ 
+                          folderWatcherDefaultDebounceMs }) :
+        directories{ directories }, debounce{ debounce }
+    { }
+
+    /// @brief Destructor; stops watching the directories.
+    ~FolderWatcher();
+
+    FolderWatcher(const FolderWatcher&) = delete;
+    FolderWatcher& operator=(const FolderWatcher&) = delete;
+
+    /// @brief Starts watching the directories.
+    /// @return true if every directory is being watched, otherwise false.
+    bool Start();
+
+    /// @brief Waits until at least one file is ready or the watcher is 
+    /// stopped.
+    /// @param ready The list to add the ready files to.
+    /// @return true if files were added, or false if the watcher stopped.
+    bool Next(std::vector<std::filesystem::path>& ready);
+
+    /// @brief Makes Next() return false within folderWatcherWakeMs.
+    ///
+    /// Only sets a lock free flag, so it is safe to call from another thread
+    /// or a signal handler.
+    void Stop() { stopping = true; }
+
+    /// @brief Determines if the directories are watched with inotify.
+    /// @return true if inotify is used, or false if they are scanned.
+    bool UsesInotify() const { return inotifyFd >= 0; }
+
+    /// @brief Gets a description of the last error that occurred.
+    /// @return The error message, or an empty string if there was no error.
+    const std::string& Error() const { return error; }
+private:
+    using Clock = std::chrono::steady_clock;
+
+    /// @brief Represents the size and last write time of a file, which
+    /// change whenever it is written to.
+    struct FileState
+    {
+        uintmax_t size{ 0 };
+        std::filesystem::file_time_type writeTime;
+
+        bool operator==(const FileState& other) const
+        {
+            return size == other.size && writeTime == other.writeTime;
+        }
+    };
+
+    /// @brief Represents a file that has changed but isn't ready yet.
+    struct PendingFile
+    {
+        /// @brief The time the file is ready if it doesn't change again.
+        Clock::time_point deadline;
+
+        /// @brief The state of the file when it last changed.
+        FileState state;
+    };
+
+    std::vector<std::filesystem::path> directories;
+    std::chrono::milliseconds debounce;
+    std::atomic<bool> stopping{ false };
+    int inotifyFd{ -1 };
+    std::map<int, std::filesystem::path> watches;
+    std::map<std::filesystem::path, PendingFile> pending;
+    std::map<std::filesystem::path, FileState> seen;
+    Clock::time_point nextScan;
+    std::string error;
+
+    /// @brief Waits for changes to the directories and records them.
+    /// @param timeout The longest time to wait.
+    void WaitForChanges(std::chrono::milliseconds timeout);
+
+    /// @brief Reads and records the events waiting on the inotify 
+    /// descriptor.
+    void ReadEvents();
+
+    /// @brief Records every .gmd file that is new or has changed since the
+    /// last scan.
+    void Scan();
+
+    /// @brief Forgets a file that was removed or renamed away, so that one
+    /// with the same name is reported as new.
+    /// @param file The file.
+    void Forget(const std::filesystem::path& file);
+
+    /// @brief Records that a file has changed, restarting its debounce.
+    /// @param file The file that changed.
+    /// @param state The state of the file after the change.
+    void Touch(const std::filesystem::path& file, const FileState& state);
+
+    /// @brief Gets the current state of a file.
+    /// @param file The file.
+    /// @param state The state to read into.
+    /// @return true if the file exists and is a regular file.
+    static bool GetFileState(const std::filesystem::path& file, 
+                             FileState& state);
+
+    /// @brief Moves the files whose debounce has ended to the ready list.
+    /// @param ready The list to add the ready files to.
+    void TakeReady(std::vector<std::filesystem::path>& ready);
+};
+
+#endif
@@ -0,0 +1,63 @@
+// FourCC.h - Declares helpers for four character chunk IDs.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FOUR_CC_H
+#define FOUR_CC_H
+
+#include <cstdint>
+#include <string>
+
+/// @brief Packs a four character chunk ID into a big endian integer.
+/// @param id The 4 character chunk ID, e.g. "MTrk".
+/// @return The ID as it is read from a chunk header by ReadUInt32BE.
+///
+/// Being constexpr, the result can be used as a case label, so chunks can
+/// be dispatched on with a switch instead of comparing strings.
+constexpr uint32_t MakeFourCC(const char (&id)[5])
+{
+    return (static_cast<uint32_t>(static_cast<uint8_t>(id[0])) << 24) |
+           (static_cast<uint32_t>(static_cast<uint8_t>(id[1])) << 16) |
+           (static_cast<uint32_t>(static_cast<uint8_t>(id[2])) << 8) |
+           static_cast<uint32_t>(static_cast<uint8_t>(id[3]));
+}
+
+/// @brief Unpacks a chunk ID into its four characters.
+/// @param id The chunk ID as a big endian integer.
+/// @return The 4 character chunk ID.
+inline std::string FourCCString(uint32_t id)
+{
+    std::string idString(4, ' ');
+    idString[0] = static_cast<char>(id >> 24);
+    idString[1] = static_cast<char>(id >> 16);
+    idString[2] = static_cast<char>(id >> 8);
+    idString[3] = static_cast<char>(id);
+    return idString;
+}
+
+/// @brief The ID of the chunk that wraps the rest of a .gmd file.
+inline constexpr uint32_t gmdHeaderFourCC{ MakeFourCC("GMD ") };
+
+/// @brief The ID of the MIDI header chunk.
+inline constexpr uint32_t midiHeaderFourCC{ MakeFourCC("MThd") };
+
+/// @brief The ID of a MIDI track chunk.
+inline constexpr uint32_t midiTrackFourCC{ MakeFourCC("MTrk") };
+
+/// @brief The ID of the iMuse header chunk, which holds the settings iMuse
+/// starts the sound with. @see DecodeImuseHeader
+inline constexpr uint32_t imuseHeaderFourCC{ MakeFourCC("MDhd") };
+
+#endif
@@ -0,0 +1,139 @@
+// GmdCarver.cpp - Defines the GmdCarver class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include "BatchConverter.h"
+#include "ChunkIndex.h"
+#include "GmdCarver.h"
+#include "GmdFile.h"
+#include "MappedFile.h"
+#include "WorkerPool.h"
+
+std::vector<EmbeddedGmd> FindEmbeddedGmds(ByteSpan blob)
+{
+    std::vector<EmbeddedGmd> found;
+    if (blob.size < chunkHeaderSize)
+        return found;
+
+    const uint8_t* position = blob.data;
+    const uint8_t* lastHeader = blob.data + blob.size - chunkHeaderSize;
+    ChunkIndex index;
+
+    while (position <= lastHeader)
+    {
+        // memchr does the heavy lifting of skipping the bytes that can't 
+        // start a header; only the rare first-byte matches are compared.
+        const void* match = std::memchr(position, gmdHeaderID[0], 
+                                        lastHeader - position + 1);
+        if (match == nullptr)
+            break;
+
+        position = static_cast<const uint8_t*>(match);
+        size_t offset = position - blob.data;
+        if (std::memcmp(position, gmdHeaderID, 4) == 0)
+        {
+            size_t size = chunkHeaderSize + ReadUInt32BE(position + 4);
+            if (blob.Contains(offset, size))
+            {
+                ByteSpan candidate = blob.Subspan(offset, size);
+                if (index.Build(candidate) && 
+                    index.MidiHeaderPosition() != chunkIndexNone &&
+                    index.NumTracks() > 0)
+                {
+                    found.push_back(EmbeddedGmd{ offset, candidate });
+                    position += size;
+                    continue;
+                }
+            }
+        }
+
+        position++;
+    }
+
+    return found;
+}
+
+bool GmdCarver::Carve()
+{
+    MappedFile file{ fileName };
+    if (!file.Open())
+    {
+        std::cerr << "Unable to open " << fileName << std::endl;
+        return false;
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    std::vector<EmbeddedGmd> found = FindEmbeddedGmds(file.Data());
+    double searchSeconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - startTime).count();
+
+    std::cout << "Found " << found.size() << " embedded GMD files in " 
+              << fileName << " (" << file.Size() << " bytes, " << std::fixed 
+              << std::setprecision(3) << searchSeconds << "s)" << std::endl;
+
+    if (found.empty())
+        return false;
+
+    // Printing every chunk from several threads at once would be unreadable,
+    // so each embedded file only gets a line, as in batch mode.
+    ConversionOptions carveOptions{ options };
+    carveOptions.verbose = false;
+
+    stats.assign(found.size(), ConversionStats{});
+    std::mutex outputMutex;
+    size_t numFailed{ 0 };
+
+    {
+        WorkerPool pool{ numWorkers };
+        for (size_t i = 0; i < found.size(); i++)
+        {
+            pool.Submit([&, i]
+            {
+                std::string name = EmbeddedName(found[i].offset);
+                GmdFile gmd{ found[i].data, name, carveOptions };
+                bool succeeded = gmd.Convert();
+                stats[i] = gmd.Stats();
+
+                std::lock_guard<std::mutex> lock{ outputMutex };
+                std::cout << (succeeded ? "[OK]     " : "[FAILED] ") << name
+                          << " (offset " << found[i].offset << ", " 
+                          << found[i].data.size << " bytes)\n";
+                if (!succeeded)
+                    numFailed++;
+            });
+        }
+
+        pool.Wait();
+    }
+
+    std::cout << std::endl;
+    return numFailed == 0;
+}
+
+std::string GmdCarver::EmbeddedName(size_t offset) const
+{
+    std::stringstream name;
+    name << std::filesystem::path{ fileName }.stem().string() << "_" 
+         << std::uppercase << std::hex << std::setw(8) << std::setfill('0') 
+         << offset << gmdExtension;
+    return name.str();
+}
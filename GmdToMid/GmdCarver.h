@@ -0,0 +1,87 @@
+// GmdCarver.h - Declares the GmdCarver class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GMD_CARVER_H
+#define GMD_CARVER_H
+
+#include <string>
+#include <vector>
+#include "ByteSpan.h"
+#include "ConversionOptions.h"
+#include "ConversionStats.h"
+
+/// @brief Represents a .gmd file found inside a larger file.
+struct EmbeddedGmd
+{
+    /// @brief The offset of the GMD header from the start of the larger file.
+    size_t offset{ 0 };
+
+    /// @brief The bytes of the embedded .gmd file, including its header.
+    ByteSpan data;
+};
+
+/// @brief Finds every .gmd file embedded within a block of bytes.
+/// @param blob The bytes to search, e.g. a game resource or bundle file.
+/// @return The embedded .gmd files, in the order they appear.
+///
+/// Candidates are found by searching for the GMD header ID with memchr,
+/// which the C library vectorizes, and are only accepted if their declared
+/// size fits within the blob and their chunks, which must include a MIDI
+/// header and at least one track, exactly fill that size. The search resumes
+/// after the end of each accepted file, so files never overlap.
+std::vector<EmbeddedGmd> FindEmbeddedGmds(ByteSpan blob);
+
+/// @brief Converts every .gmd file embedded within a larger file.
+///
+/// Each embedded file is named after the larger file and the offset it was
+/// found at, e.g. the file at offset 0x1A2F0 in music.bun is converted to
+/// music_0001A2F0-0.mid, music_0001A2F0-1.mid, and so on. The embedded files
+/// are converted on a pool of workers while the rest of the file is still
+/// being searched.
+class GmdCarver
+{
+public:
+    /// @brief Constructor; creates a new GmdCarver.
+    /// @param fileName The name of the file to search.
+    /// @param options The options to convert each embedded file with.
+    /// @param numWorkers The number of workers, or 0 to match the hardware.
+    GmdCarver(std::string fileName, 
+              ConversionOptions options, 
+              size_t numWorkers) :
+        fileName{ fileName }, options{ options }, numWorkers{ numWorkers }
+    { }
+
+    /// @brief Searches the file and converts every embedded .gmd file.
+    /// @return true if at least one embedded file was found and every one 
+    /// found was converted successfully, otherwise false.
+    bool Carve();
+
+    /// @brief Gets the stats of every embedded file that was converted.
+    /// @return The stats of each embedded file, in the order they appear.
+    const std::vector<ConversionStats>& Stats() const { return stats; }
+private:
+    std::string fileName;
+    ConversionOptions options;
+    size_t numWorkers;
+    std::vector<ConversionStats> stats;
+
+    /// @brief Gets the name to convert an embedded file as.
+    /// @param offset The offset the embedded file was found at.
+    /// @return The name of the embedded file, e.g. music_0001A2F0.gmd.
+    std::string EmbeddedName(size_t offset) const;
+};
+
+#endif
@@ -14,134 +14,729 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iomanip>
+#include "AsyncWriter.h"
+#include "ConversionCache.h"
 #include "GmdFile.h"
+#include "GmdValidator.h"
+#include "IncrementalManifest.h"
+#include "Json.h"
+#include "TrackDeduplicator.h"
+#include "TrackStats.h"
+#include "WorkerPool.h"
 
 bool GmdFile::Convert()
 {
-    stream.Open();
-    bytesRemaining = stream.Size();
+    // Only a file read from disk has a size and time to compare, so files
+    // converted from memory are always converted.
+    ManifestEntry entry;
+    if (options.incremental != nullptr && mapFile &&
+        options.incremental->Check(fileName, options, entry))
+    {
+        stats = ConversionStats{};
+        stats.fileName = fileName;
+        stats.succeeded = true;
+        stats.inputsSkipped = 1;
+        error.clear();
+        if (options.verbose)
+        {
+            std::cout << fileName << " is up to date, skipped.\n\n" 
+                      << std::flush;
+        }
+        return true;
+    }
+
+    FileSink fileSink{ options.outputDirectory, options.atomicWrites };
+    if (options.asyncWriter != nullptr)
+    {
+        AsyncSink asyncSink{ *options.asyncWriter, fileSink };
+        return ConvertToDisk(asyncSink, entry);
+    }
 
-    if (!ReadFileHeader())
+    return ConvertToDisk(fileSink, entry);
+}
+
+bool GmdFile::ConvertToDisk(OutputSink& sink, ManifestEntry& entry)
+{
+    if (options.incremental == nullptr || !mapFile)
+        return Convert(sink);
+
+    // The names are only known once the tracks have been written, so the
+    // files are hashed once the conversion has finished.
+    IncrementalManifest::Recorder recorder{ sink };
+    if (!Convert(recorder))
         return false;
 
+    stats.orphansRemoved = options.incremental->Record(
+        fileName, options, std::move(entry), recorder.Names());
+    return true;
+}
+
+bool GmdFile::Convert(OutputSink& sink)
+{
+    this->sink = &sink;
+    stats = ConversionStats{};
+    stats.fileName = fileName;
+    error.clear();
+
+    {
+        StageTimer timer{ stats.totalSeconds };
+        stats.succeeded = ConvertFile();
+
+        // A sink that writes in the background only knows a file made it
+        // to its destination once it has been flushed, so this is part of
+        // writing.
+        StageTimer flushTimer{ stats.writeSeconds };
+        for (const std::string& name : sink.Flush())
+            stats.succeeded = Fail("Unable to write " + sink.PathOf(name));
+    }
+
+    if (options.verbose)
+        std::cout << std::flush;
+
+    return stats.succeeded;
+}
+
+bool GmdFile::ConvertFile()
+{
+    // A file that doesn't hold together, or has a track that can't be
+    // decoded, is rejected before anything is looked up or written.
+    if (!Open() || !CheckStructure() || !CheckEvents() || !HandleChunks())
+        return false;
+
+    // The tracks are written straight from the file, which stays open until
+    // the sink has been flushed.
+    sink->Pin(data);
+
+    if (options.cache == nullptr)
+        return ConvertChunks();
+
+    std::string key = ConversionCache::Key(data, options);
+    std::string stem = std::filesystem::path{ fileName }.stem().string();
+    size_t numFiles{ 0 };
+    if (options.cache->Restore(key, stem, *sink, numFiles))
+    {
+        stats.cacheHits++;
+        stats.filesWritten += numFiles;
+        if (options.verbose)
+            std::cout << "Restored " << numFiles << " files from cache.\n\n";
+        return true;
+    }
+
+    // Everything the conversion writes passes through the recorder on its
+    // way to the real sink, and is only stored if the conversion succeeds.
+    stats.cacheMisses++;
+    ConversionCache::Recorder recorder{ *options.cache, key, stem, *sink };
+    OutputSink* outputSink = sink;
+    sink = &recorder;
+    bool succeeded = ConvertChunks();
+    sink = outputSink;
+
+    if (succeeded)
+        recorder.Commit();
+
+    return succeeded;
+}
+
+bool GmdFile::ConvertChunks()
+{
+    if (options.extractTrack)
+        return ExtractTrack();
+
+    if (options.propagateSetup && !BuildSetupPrelude())
+        return false;
+
+    if (options.verbose)
+    {
+        PrintChunkHeader("File Header", index.FileHeader());
+        std::cout << "Converting file...\n\n";
+    }
+
     int trackNum{ 0 };
-    std::cout << "Converting file..." << std::endl << std::endl;
-    while (bytesRemaining > 0)
+    size_t metadataNum{ 0 };
+    std::vector<std::pair<int, Chunk>> pendingTracks;
+    for (const Chunk& nextChunk : index.Chunks())
     {
-        ChunkHeader nextHeader = ReadChunkHeader();
-        if (nextHeader.id.ToString() == midiHeaderID)
+        switch (nextChunk.id)
         {
-            PrintChunkHeader("MIDI Header", nextHeader);
-            ReadMidiHeaderData();
-            PrintMidiHeaderData(midiHeaderData);
+            case midiHeaderFourCC:
+                if (!ReadMidiHeaderData(nextChunk))
+                    return false;
+                if (options.verbose)
+                {
+                    PrintChunkHeader("MIDI Header", nextChunk);
+                    PrintMidiHeaderData(midiHeaderData);
+                }
+                break;
+            case midiTrackFourCC:
+                if (options.verbose)
+                    PrintChunkHeader("MIDI Track", nextChunk);
+
+                // In parallel and single file modes we only collect the
+                // tracks during the walk, since they are all exported at
+                // once afterward.
+                if (options.parallelTracks || options.singleFileFormat)
+                    pendingTracks.emplace_back(trackNum, nextChunk);
+                else if (!ExportTrack(trackNum, nextChunk))
+                    return false;
+                trackNum++;
+                break;
+            default:
+                // Every other chunk was already passed to its handler, if it
+                // has one. The rest, including the ones that have a size of
+                // zero, cost nothing since their data is never touched.
+                if (!options.verbose)
+                    break;
+                if (metadataNum < metadata.size() &&
+                    metadata[metadataNum].offset == nextChunk.offset)
+                {
+                    PrintChunkHeader("Decoded Chunk", nextChunk);
+                    PrintChunkMetadata(metadata[metadataNum++]);
+                }
+                else
+                {
+                    PrintChunkHeader("Skipped Chunk", nextChunk);
+                }
+                break;
         }
-        else if (nextHeader.id.ToString() == midiTrackID)
+
+        if (options.verbose)
         {
-            PrintChunkHeader("MIDI Track", nextHeader);
-            ExportTrack(trackNum, nextHeader);
-            trackNum++;
+            std::cout << "Bytes remaining: " << index.BytesAfter(nextChunk) 
+                      << "\n\n";
         }
-        else
-        {
-            PrintChunkHeader("Skipped Chunk", nextHeader);
+    }   
 
-            // Believe it or not, there are some chunks that have a size of
-            // zero. In that case, we simply ignore the chunk.
-            if (nextHeader.size.Value() > 0)
-            {
-                BinData::RawField skippedData
-                { 
-                    static_cast<size_t>(nextHeader.size.Value()) 
-                };
-                ReadData(&skippedData);
-            }
-        }
+    if (options.singleFileFormat)
+        return ExportSingleFile();
 
-        std::cout << "Bytes remaining: " << bytesRemaining << std::endl 
-                  << std::endl;
-    }   
+    if (!pendingTracks.empty())
+        return ExportTracks(pendingTracks);
 
     return true;
 }
 
-ChunkHeader GmdFile::ReadChunkHeader()
+bool GmdFile::List(bool json)
 {
-    ChunkHeader header;
-    stream.Read(&header.id);
-    stream.Read(&header.size);
-    bytesRemaining -= chunkHeaderSize;
-    return header;
+    if (!Open())
+        return false;
+
+    size_t headerPosition = index.MidiHeaderPosition();
+    if (headerPosition != chunkIndexNone &&
+        !ReadMidiHeaderData(index.Chunks()[headerPosition]))
+    {
+        return false;
+    }
+
+    if (!HandleChunks())
+        return false;
+
+    if (json)
+        PrintChunkIndexJson(fileName, index, midiHeaderData, metadata);
+    else
+        PrintChunkIndex(fileName, index);
+
+    return true;
 }
 
-bool GmdFile::ReadFileHeader()
+bool GmdFile::Validate(bool checkEvents)
 {
-    header = ReadChunkHeader();
-    if (header.id.ToString() != gmdHeaderID)
-    {
-        std::cerr << "Input file does not appear to be in the GMD format."
-                  << std::endl;
+    stats = ConversionStats{};
+    stats.fileName = fileName;
+    error.clear();
+
+    if (!Open() || !CheckStructure())
+        return false;
+
+    if (!checkEvents)
+        return true;
+
+    if (!CheckEvents())
         return false;
+
+    for (size_t trackNum = 0; trackNum < index.NumTracks(); trackNum++)
+        stats.bytesRead += index.Track(trackNum).data.size;
+
+    return true;
+}
+
+bool GmdFile::CheckStructure()
+{
+    StageTimer timer{ stats.indexSeconds };
+    std::string validateError;
+    if (!ValidateStructure(index, validateError))
+        return Fail(validateError);
+
+    return true;
+}
+
+bool GmdFile::CheckEvents()
+{
+    StageTimer timer{ stats.parseSeconds };
+    for (size_t trackNum = 0; trackNum < index.NumTracks(); trackNum++)
+    {
+        std::string validateError;
+        if (!ValidateTrack(index, trackNum, validateError))
+            return Fail(validateError);
+    }
+
+    return true;
+}
+
+bool GmdFile::HandleChunks()
+{
+    StageTimer timer{ stats.parseSeconds };
+    const ChunkRegistry& registry = options.chunkRegistry != nullptr ? 
+        *options.chunkRegistry : ChunkRegistry::BuiltIn();
+
+    metadata.clear();
+    for (const Chunk& chunk : index.Chunks())
+    {
+        if (chunk.id == midiHeaderFourCC || chunk.id == midiTrackFourCC)
+            continue;
+
+        const ChunkHandler* handler = registry.Find(chunk.id);
+        if (handler == nullptr)
+            continue;
+
+        ChunkMetadata chunkMetadata{ chunk.id, chunk.offset, {} };
+        std::string handlerError;
+        if (!(*handler)(chunk, chunkMetadata, handlerError))
+        {
+            std::stringstream message;
+            message << "Unable to decode chunk " << chunk.IdString() 
+                    << " at offset " << chunk.offset << ": " << handlerError;
+            return Fail(message.str());
+        }
+
+        stats.bytesRead += chunk.data.size;
+        metadata.push_back(std::move(chunkMetadata));
     }
-    else if (header.size.Value() != (bytesRemaining))
+
+    return true;
+}
+
+bool GmdFile::WriteTrackStats(std::ostream& output, bool json)
+{
+    if (!Open())
+        return false;
+
+    size_t headerPosition = index.MidiHeaderPosition();
+    if (headerPosition != chunkIndexNone &&
+        !ReadMidiHeaderData(index.Chunks()[headerPosition]))
     {
-        std::cerr << "GMD file appears corrupt due to file size mismatch."
-                  << std::endl << "Expected Size : " << header.size.Value()
-                  << std::endl << "Actual Size   : " << bytesRemaining
-                  << std::endl;
         return false;
     }
+
+    std::vector<TrackStats> tracks(index.NumTracks());
+    for (size_t trackNum = 0; trackNum < index.NumTracks(); trackNum++)
+    {
+        StageTimer timer{ stats.parseSeconds };
+        std::string analyzeError;
+        tracks[trackNum].trackNum = trackNum;
+        if (!AnalyzeTrack(index.Track(trackNum).data, 
+                          midiHeaderData.division.Value(), 
+                          tracks[trackNum], analyzeError))
+        {
+            return Fail("Unable to analyze track " + 
+                        std::to_string(trackNum) + " of " + fileName + 
+                        ": " + analyzeError);
+        }
+
+        stats.bytesRead += index.Track(trackNum).data.size;
+    }
+
+    if (json)
+    {
+        WriteTrackStatsJson(output, fileName, 
+                            midiHeaderData.division.Value(), tracks);
+    }
     else
     {
-        PrintChunkHeader("File Header", header);
-        return true;
+        WriteTrackStatsCsv(output, fileName, tracks);
     }
+
+    return true;
 }
 
-void GmdFile::ReadData(BinData::RawField* data)
+bool GmdFile::Open()
 {
-    stream.Read(data);
-    bytesRemaining -= data->Size();
+    if (mapFile)
+    {
+        StageTimer timer{ stats.openSeconds };
+        if (!file.Open())
+        {
+            return Fail("Unable to open " + fileName);
+        }
+
+        data = file.Data();
+    }
+
+    stats.inputBytes = data.size;
+
+    StageTimer timer{ stats.indexSeconds };
+    if (!index.Build(data))
+        return Fail(index.Error());
+
+    // Building the index reads the GMD header and every chunk header, but
+    // none of the chunk data.
+    stats.bytesRead += chunkHeaderSize * (index.Chunks().size() + 1);
+    for (const Chunk& chunk : index.Chunks())
+        stats.chunkCounts[chunk.id]++;
+
+    return true;
 }
 
-void GmdFile::ReadMidiHeaderData()
+bool GmdFile::BuildSetupPrelude()
 {
-    stream.Read(&midiHeaderData.format);
-    stream.Read(&midiHeaderData.numTracks);
-    stream.Read(&midiHeaderData.division);
-    bytesRemaining -= midiHeaderDataSize;
+    if (index.NumTracks() < 2)
+        return true;
+
+    StageTimer timer{ stats.parseSeconds };
+    stats.bytesRead += index.Track(0).data.size;
+
+    std::string setupError;
+    if (!exporter.BuildSetupPrelude(index.Track(0).data, setupError))
+        return Fail(setupError);
+
+    sink->Pin(exporter.SetupPrelude());
+
+    if (options.verbose)
+    {
+        std::cout << "Setup prelude for transition tracks: " 
+                  << exporter.SetupPrelude().size << " bytes\n\n";
+    }
+
+    return true;
+}
+
+bool GmdFile::ExtractTrack()
+{
+    size_t trackNum = *options.extractTrack;
+    if (trackNum >= index.NumTracks())
+    {
+        std::stringstream message;
+        message << "Cannot extract track " << trackNum << " from " 
+                << fileName << ", which only contains " 
+                << index.NumTracks() << " tracks.";
+        return Fail(message.str());
+    }
+
+    size_t headerPosition = index.MidiHeaderPosition();
+    if (headerPosition != chunkIndexNone &&
+        !ReadMidiHeaderData(index.Chunks()[headerPosition]))
+    {
+        return false;
+    }
+
+    // The index lets us go straight to the requested track, so none of the
+    // other tracks are touched unless we need the setup from the first one.
+    if (options.propagateSetup && trackNum > 0 && !BuildSetupPrelude())
+        return false;
+
+    const Chunk& track = index.Track(trackNum);
+    if (options.verbose)
+        PrintChunkHeader("MIDI Track", track);
+
+    return ExportTrack(static_cast<int>(trackNum), track);
 }
 
-void GmdFile::ExportTrack(int trackNum, const ChunkHeader& trackHeader)
+bool GmdFile::ReadMidiHeaderData(const Chunk& chunk)
 {
-    auto trackSize = static_cast<size_t>(trackHeader.size.Value());
-    BinData::RawField trackData{ trackSize };
-    ReadData(&trackData);
+    StageTimer timer{ stats.parseSeconds };
+
+    if (chunk.data.size < midiHeaderDataSize)
+    {
+        std::stringstream message;
+        message << "MIDI header at offset " << chunk.offset 
+                << " is too small (" << chunk.data.size << " bytes)";
+        return Fail(message.str());
+    }
+
+    midiHeaderData.format.SetValue(ReadUInt16BE(chunk.data.data));
+    midiHeaderData.numTracks.SetValue(ReadUInt16BE(chunk.data.data + 2));
+    midiHeaderData.division.SetValue(ReadUInt16BE(chunk.data.data + 4));
+    stats.bytesRead += midiHeaderDataSize;
+    return true;
+}
 
+bool GmdFile::ExportTrack(int trackNum, const Chunk& track)
+{
     // The exported file takes the same name as the .gmd, but we add a track
     // number prefix that increases with each successive track so we can tell
     // each track / .mid file apart.
+    std::string exportName = ExportName("-" + std::to_string(trackNum));
+
+    PreparedTrack prepared;
+    prepared.data = track.data;
+    if (!PrepareTrack(trackNum, prepared))
+        return false;
+
+    if (options.dedup != nullptr)
+        return ExportDeduplicatedTrack(trackNum, exportName, prepared);
+
+    return WriteTrack(exportName, prepared);
+}
+
+bool GmdFile::PrepareTrack(size_t trackNum, PreparedTrack& track)
+{
+    std::string prepareError;
+    bool prepared = exporter.Prepare(trackNum, track, prepareError);
+
+    {
+        // Tracks may be exported from several workers at once.
+        std::lock_guard<std::mutex> lock{ resultMutex };
+        stats.parseSeconds += track.parseSeconds;
+        stats.bytesOptimized += track.bytesOptimized;
+    }
+
+    if (!prepared)
+        return Fail(prepareError);
+
+    return true;
+}
+
+bool GmdFile::ExportDeduplicatedTrack(int trackNum, 
+                                      const std::string& exportName,
+                                      const PreparedTrack& track)
+{
+    TrackDeduplicator& dedup = *options.dedup;
+    TrackKey key = TrackDeduplicator::KeyOf(track.data, track.prelude, 
+                                            midiHeaderData.division.Value());
+    std::string path = sink->PathOf(exportName);
+    uint64_t fileSize = chunkHeaderSize * 2 + midiHeaderDataSize + 
+                        track.prelude.size + track.data.size;
+
+    std::string canonicalPath;
+    if (!dedup.Claim(key, path, canonicalPath))
+    {
+        // A duplicate that can't be linked, e.g. because the output is on
+        // another file system, is written as normal below.
+        bool isReferenced = !dedup.LinkDuplicates() || 
+                            sink->Link(exportName, canonicalPath);
+        if (isReferenced)
+        {
+            dedup.Record(fileName, trackNum, path, canonicalPath, fileSize);
+            std::lock_guard<std::mutex> lock{ resultMutex };
+            stats.tracksDeduplicated++;
+            stats.bytesDeduplicated += fileSize;
+            return true;
+        }
+
+        return WriteTrack(exportName, track);
+    }
+
+    bool written = WriteTrack(exportName, track);
+    dedup.Finish(key, written);
+    if (written)
+        dedup.Record(fileName, trackNum, path, path, fileSize);
+
+    return written;
+}
+
+bool GmdFile::WriteTrack(const std::string& exportName, 
+                         const PreparedTrack& track)
+{
+    ExportedFile file;
+    std::string writeError;
+    bool written = exporter.WriteTrack(*sink, exportName, track, file, 
+                                       writeError);
+    RecordWrite(file.writeSeconds, track.data.size, file.bytesWritten);
+    if (!written)
+        return Fail(writeError);
+
+    return true;
+}
+
+bool GmdFile::ExportSingleFile()
+{
+    // The file only borrows the tracks, so they have to outlive it.
+    std::vector<PreparedTrack> tracks(index.NumTracks());
+    size_t tracksSize{ 0 };
+    for (size_t trackNum = 0; trackNum < index.NumTracks(); trackNum++)
+    {
+        tracks[trackNum].data = index.Track(trackNum).data;
+        if (!PrepareTrack(trackNum, tracks[trackNum]))
+            return false;
+        tracksSize += index.Track(trackNum).data.size;
+    }
+
+    ExportedFile file;
+    std::string writeError;
+    bool written = exporter.WriteSingleFile(*sink, ExportName(""), tracks, 
+                                            file, writeError);
+    RecordWrite(file.writeSeconds, tracksSize, file.bytesWritten);
+    if (!written)
+        return Fail(writeError);
+
+    return true;
+}
+
+void GmdFile::RecordWrite(double seconds, 
+                          size_t trackBytes, 
+                          size_t bytesWritten)
+{
+    // Tracks may be exported from several workers at once.
+    std::lock_guard<std::mutex> lock{ resultMutex };
+    stats.writeSeconds += seconds;
+    stats.bytesRead += trackBytes;
+    stats.bytesWritten += bytesWritten;
+    if (bytesWritten > 0)
+        stats.filesWritten++;
+}
+
+bool GmdFile::Fail(const std::string& message)
+{
+    std::lock_guard<std::mutex> lock{ resultMutex };
+
+    // When several tracks fail at once, the first failure is the one that
+    // explains why the conversion stopped.
+    if (error.empty())
+        error = message;
+
+    if (options.printErrors)
+        std::cerr << message << std::endl;
+
+    return false;
+}
+
+std::string GmdFile::ExportName(const std::string& suffix) const
+{
     std::filesystem::path gmdPath{ fileName };
-    std::stringstream exportFileName;
-    exportFileName << gmdPath.stem().string() << "-" << trackNum << ".mid";
+    return gmdPath.stem().string() + suffix + ".mid";
+}
+
+bool GmdFile::ExportTracks(const std::vector<std::pair<int, Chunk>>& tracks)
+{
+    size_t numWorkers = options.trackWorkers != 0 ? options.trackWorkers : 
+                                                     DefaultWorkerCount();
+    numWorkers = std::min(tracks.size(), numWorkers);
+
+    // With a single worker, starting a thread only to wait for it gains 
+    // nothing over exporting the tracks here.
+    if (numWorkers <= 1)
+    {
+        for (const auto& [trackNum, track] : tracks)
+        {
+            if (!ExportTrack(trackNum, track))
+                return false;
+        }
+        return true;
+    }
+
+    std::atomic<bool> succeeded{ true };
+    {
+        WorkerPool pool{ numWorkers };
+        for (const auto& [trackNum, track] : tracks)
+        {
+            pool.Submit([this, &succeeded, trackNum = trackNum, track = track]
+            {
+                if (!ExportTrack(trackNum, track))
+                    succeeded = false;
+            });
+        }
+    }
 
-    unsigned int division = midiHeaderData.division.Value();
-    MidiFile exportFile{ exportFileName.str(), division };
-    exportFile.WriteTrack(trackHeader, &trackData);
+    return succeeded;
 }
 
-void PrintChunkHeader(std::string title, const ChunkHeader& header)
+void PrintChunkHeader(std::string title, const Chunk& chunk)
 {
-    std::cout << title << std::endl
-              << "--------------------" << std::endl
-              << "ID       : " << header.id.ToString() << std::endl
-              << "Size     : " << header.size.Value() << std::endl
-              << std::endl;
+    // These are printed for every chunk, so we leave flushing to the caller
+    // rather than flushing standard output on every line.
+    std::cout << title << '\n'
+              << "--------------------\n"
+              << "ID       : " << chunk.IdString() << '\n'
+              << "Size     : " << chunk.data.size << '\n'
+              << '\n';
+}
+
+void PrintChunkMetadata(const ChunkMetadata& metadata)
+{
+    for (const ChunkField& field : metadata.fields)
+    {
+        std::cout << std::left << std::setw(9) << field.name << std::right 
+                  << ": " << field.value << '\n';
+    }
+    std::cout << '\n';
 }
 
 void PrintMidiHeaderData(const MidiHeaderData& data)
 {
-    std::cout << "Format   : " << data.format.ToString() << std::endl
-              << "Tracks   : " << data.numTracks.Value() << std::endl
-              << "Division : " << data.division.Value() << std::endl
+    std::cout << "Format   : " << data.format.ToString() << '\n'
+              << "Tracks   : " << data.numTracks.Value() << '\n'
+              << "Division : " << data.division.Value() << '\n'
+              << '\n';
+}
+
+void PrintChunkIndex(const std::string& fileName, const ChunkIndex& index)
+{
+    std::cout << fileName << std::endl
+              << "Offset      ID     Size        Track" << std::endl
+              << "----------  ----   ----------  -----" << std::endl;
+
+    size_t trackNum{ 0 };
+    for (const Chunk& chunk : index.Chunks())
+    {
+        std::cout << std::left << std::setw(12) << chunk.offset
+                  << std::setw(7) << chunk.IdString()
+                  << std::setw(12) << chunk.data.size;
+        if (chunk.id == midiTrackFourCC)
+            std::cout << trackNum++;
+        std::cout << '\n';
+    }
+
+    std::cout << std::right << "Tracks: " << index.NumTracks() << std::endl 
               << std::endl;
+}
+
+void PrintChunkIndexJson(const std::string& fileName, 
+                         const ChunkIndex& index,
+                         const MidiHeaderData& data,
+                         const std::vector<ChunkMetadata>& metadata)
+{
+    // Each file is printed as a single line so that listing many files
+    // produces JSON Lines output that tools can consume as it streams.
+    std::stringstream json;
+    json << "{\"file\":" << JsonString(fileName)
+         << ",\"size\":" << index.FileHeader().data.size + chunkHeaderSize
+         << ",\"format\":" << data.format.Value()
+         << ",\"numTracks\":" << data.numTracks.Value()
+         << ",\"division\":" << data.division.Value()
+         << ",\"chunks\":[";
+
+    size_t trackNum{ 0 };
+    size_t metadataNum{ 0 };
+    for (size_t i = 0; i < index.Chunks().size(); i++)
+    {
+        const Chunk& chunk = index.Chunks()[i];
+        json << (i > 0 ? "," : "") 
+             << "{\"id\":" << JsonString(chunk.IdString())
+             << ",\"offset\":" << chunk.offset
+             << ",\"size\":" << chunk.data.size;
+        if (chunk.id == midiTrackFourCC)
+            json << ",\"track\":" << trackNum++;
+
+        // The metadata is in the same order as the chunks it came from.
+        if (metadataNum < metadata.size() && 
+            metadata[metadataNum].offset == chunk.offset)
+        {
+            json << ",\"fields\":{";
+            const std::vector<ChunkField>& fields = 
+                metadata[metadataNum++].fields;
+            for (size_t f = 0; f < fields.size(); f++)
+            {
+                json << (f > 0 ? "," : "") << JsonString(fields[f].name) 
+                     << ":" << fields[f].value;
+            }
+            json << "}";
+        }
+        json << "}";
+    }
+
+    json << "]}";
+    std::cout << json.str() << std::endl;
 }
\ No newline at end of file
@@ -20,10 +20,24 @@
 #include <string>
 #include <sstream>
 #include <filesystem>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
 #include "BinData.h"
 #include "ChunkHeader.h"
+#include "ChunkIndex.h"
+#include "ChunkRegistry.h"
+#include "ConversionOptions.h"
+#include "ConversionStats.h"
+#include "GmdReader.h"
+#include "MappedFile.h"
 #include "MidiFile.h"
 #include "MidiHeaderData.h"
+#include "OutputSink.h"
+#include "TrackExporter.h"
+
+struct ManifestEntry;
 
 /// @brief The chunk ID used to indicate the beginning of a .gmd file.
 inline const char* gmdHeaderID{ "GMD " };
@@ -46,64 +60,249 @@ inline const char* gmdHeaderID{ "GMD " };
 /// track as a separate Type 0 MIDI file with the same file name as the GMD
 /// file, but with a track number suffix and a .mid extension.
 ///
-/// @todo The first track usually sounds fine, but the transitionary tracks
-/// sound like they need initializaiton from the first track and cannot stand
-/// on their own. Add logic that identifies "setup" events from the first track
-/// and copies those events to the other tracks (at least offer a command line
-/// option to do so).
+/// The first track usually sounds fine, but the transitionary tracks sound
+/// like they need initializaiton from the first track and cannot stand on
+/// their own. When ConversionOptions::propagateSetup is set, the setup the
+/// first track sends each channel before it plays is restored at the start
+/// of every other track. @see MidiState
 class GmdFile
 {
 public:
     /// @brief Constructor; creates a new instance of a GmdFile from file name.
     /// @param fileName The file name of the .gmd file to convert.
+    /// @param options The options that control the conversion.
     /// @todo Define and enforce class invariants.
-    GmdFile(std::string fileName) : 
-        fileName{ fileName }, stream{ fileName }, bytesRemaining{ 0 } 
+    GmdFile(std::string fileName, ConversionOptions options = {}) : 
+        fileName{ fileName }, 
+        options{ options }, 
+        file{ fileName },
+        mapFile{ true }
+    { }
+
+    /// @brief Constructor; creates a new instance of a GmdFile from memory.
+    /// @param data The bytes of the .gmd file, which must remain valid for
+    /// the lifetime of the GmdFile.
+    /// @param fileName The name of the .gmd file, which the names of the .mid
+    /// files are derived from. Nothing is read from this file.
+    /// @param options The options that control the conversion.
+    GmdFile(ByteSpan data, 
+            std::string fileName, 
+            ConversionOptions options = {}) : 
+        fileName{ fileName }, 
+        options{ options }, 
+        file{ fileName },
+        data{ data },
+        mapFile{ false }
     { }
 
     /// @brief Converts the file to multiple .mid files, one for each track.
     /// @return true if the conversion was successful, otherwise false.
+    ///
+    /// The .mid files are written to options.outputDirectory.
     bool Convert();
+
+    /// @brief Converts the file, handing each .mid file to the given sink.
+    /// @param sink The sink to write the .mid files to.
+    /// @return true if the conversion was successful, otherwise false.
+    bool Convert(OutputSink& sink);
+
+    /// @brief Gets the name of the .gmd file.
+    /// @return The file name.
+    const std::string& FileName() const { return fileName; }
+
+    /// @brief Gets a description of the error that stopped the conversion.
+    /// @return The error message, or an empty string if there was no error.
+    const std::string& Error() const { return error; }
+
+    /// @brief Gets the timings and counters from the last conversion.
+    /// @return The stats of the last call to Convert().
+    const ConversionStats& Stats() const { return stats; }
+
+    /// @brief Gets what the chunk handlers decoded during the last call to
+    /// Convert() or List().
+    /// @return The metadata of every chunk that has a handler, in the order
+    /// the chunks appear in the file. @see ChunkRegistry
+    const std::vector<ChunkMetadata>& Metadata() const { return metadata; }
+
+    /// @brief Prints the chunk index of the file without converting it.
+    /// @param json Determines if the index is printed as a line of JSON.
+    /// @return true if the file was successfully indexed, otherwise false.
+    bool List(bool json);
+
+    /// @brief Checks the file for corruption without converting it.
+    /// @param checkEvents Determines if the events of every track are
+    /// decoded as well, rather than only the chunk structure.
+    /// @return true if the file is valid, otherwise false.
+    /// @see ValidateStructure
+    bool Validate(bool checkEvents);
+
+    /// @brief Writes the statistics of every track without converting them.
+    /// @param output The stream to write the statistics to.
+    /// @param json Determines if the statistics are written as a line of 
+    /// JSON rather than rows of CSV.
+    /// @return true if every track was analyzed, otherwise false.
+    bool WriteTrackStats(std::ostream& output, bool json);
 private:
     std::string fileName;
-    BinData::StdFileStream stream;
-    ChunkHeader header;
+    ConversionOptions options;
+    MappedFile file;
+    ByteSpan data;
+    bool mapFile;
+    OutputSink* sink{ nullptr };
+    ChunkIndex index;
     MidiHeaderData midiHeaderData;
-    size_t bytesRemaining;
+    TrackExporter exporter{ options, midiHeaderData };
+    std::vector<ChunkMetadata> metadata;
+    ConversionStats stats;
+    std::string error;
+    std::mutex resultMutex;
 
-    /// @brief Reads the next ChunkHeader from the file.
-    /// @return The next ChunkHeader.
-    /// @pre The file is open and the stream pointing to a valid ChunkHeader.
-    ChunkHeader ReadChunkHeader();
+    /// @brief Converts the file to a sink that writes to disk, recording
+    /// the outputs in options.incremental if it is set.
+    /// @param sink The sink to write the .mid files to.
+    /// @param entry The fingerprint of the file. @see IncrementalManifest
+    /// @return true if the conversion was successful, otherwise false.
+    bool ConvertToDisk(OutputSink& sink, ManifestEntry& entry);
 
-    /// @brief Reads the GMD header and loads it into the file.
-    /// @return true if the header was successfuly read, otherwise false.
-    /// @pre The file is open and at the beginning of the stream.
-    bool ReadFileHeader();
+    /// @brief Converts the file; Convert() wraps this to time it.
+    /// @return true if the conversion was successful, otherwise false.
+    bool ConvertFile();
 
-    /// @brief Reads data from the file into the specified BinData::RawField. 
-    /// @param data The field to read the data into.
+    /// @brief Converts every chunk of the file, once it has been opened and
+    /// was not found in the cache.
+    /// @return true if the conversion was successful, otherwise false.
     /// @pre The file is open.
-    void ReadData(BinData::RawField* data);
+    bool ConvertChunks();
+
+    /// @brief Maps the file, unless it is already in memory, and builds the
+    /// chunk index.
+    /// @return true if the file was successfully indexed, otherwise false.
+    bool Open();
+
+    /// @brief Checks that the chunks of the file fit together.
+    /// @return true if the structure is valid, otherwise false.
+    /// @pre The file is open.
+    bool CheckStructure();
+
+    /// @brief Checks that the events of every track can be decoded.
+    /// @return true if every track is valid, otherwise false.
+    /// @pre The file is open and its structure has been checked.
+    /// @see ValidateTrack
+    bool CheckEvents();
+
+    /// @brief Passes every chunk that has a handler to its handler.
+    /// @return true if every handler succeeded, otherwise false.
+    /// @pre The file is open.
+    ///
+    /// This runs before the cache is consulted, so the metadata is available
+    /// even when the .mid files are restored from the cache.
+    bool HandleChunks();
+
+    /// @brief Builds the prelude that gives transition tracks their setup.
+    /// @return true if the prelude was built, otherwise false.
+    /// @pre The file is open.
+    ///
+    /// The first track is decoded and scanned once, no matter how many
+    /// transition tracks the prelude is later added to.
+    bool BuildSetupPrelude();
+
+    /// @brief Exports only the track selected by options.extractTrack.
+    /// @return true if the track was successfully exported, otherwise false.
+    /// @pre The file is open.
+    bool ExtractTrack();
 
     /// @brief Reads data from the MIDI header and loads it into the file.
-    /// @pre The file is open and the stream is pointing to MidiHeaderData.
-    void ReadMidiHeaderData();
+    /// @param chunk The MIDI header chunk to read the data from.
+    /// @return true if the data was successfully read, otherwise false.
+    bool ReadMidiHeaderData(const Chunk& chunk);
 
-    /// @brief Exports the current MIDI track as a MIDI file.
+    /// @brief Exports the specified MIDI track as a MIDI file.
     /// @param trackNum Specifies the track number suffix for the MIDI file.
-    /// @param trackHeader The header of the current MIDI track.
-    /// @pre The file is open and the stream is pointing to MIDI track data.
-    void ExportTrack(int trackNum, const ChunkHeader& trackHeader);
+    /// @param track The MIDI track chunk to export.
+    /// @return true if the track was successfully exported, otherwise false.
+    /// @pre The file is open.
+    bool ExportTrack(int trackNum, const Chunk& track);
+
+    /// @brief Prepares a track to be written with the exporter and adds 
+    /// what it cost to the stats.
+    /// @param trackNum The track number of the MIDI track.
+    /// @param track The track, with data set to the MIDI track chunk's data.
+    /// @return true if the track was prepared, otherwise false.
+    /// @pre The MIDI header has been read.
+    bool PrepareTrack(size_t trackNum, PreparedTrack& track);
+
+    /// @brief Exports a MIDI track, unless an identical track has already
+    /// been exported, in which case it is linked or referenced instead.
+    /// @param trackNum The track number of the MIDI track.
+    /// @param exportName The name of the .mid file.
+    /// @param track The prepared track to export.
+    /// @return true if the track was successfully exported, otherwise false.
+    /// @pre options.dedup is set.
+    bool ExportDeduplicatedTrack(int trackNum, 
+                                 const std::string& exportName,
+                                 const PreparedTrack& track);
+
+    /// @brief Writes a MIDI track as a type 0 MIDI file.
+    /// @param exportName The name of the .mid file.
+    /// @param track The prepared track to write.
+    /// @return true if the file was successfully written, otherwise false.
+    bool WriteTrack(const std::string& exportName, 
+                    const PreparedTrack& track);
+
+    /// @brief Exports every MIDI track into a single type 1 or 2 MIDI file.
+    /// @return true if the file was successfully exported, otherwise false.
+    /// @pre The file is open and the MIDI header has been read.
+    bool ExportSingleFile();
+
+    /// @brief Adds the result of writing a .mid file to the stats.
+    /// @param seconds The time spent writing the file.
+    /// @param trackBytes The number of track bytes read from the .gmd file.
+    /// @param bytesWritten The number of bytes written to the .mid file.
+    void RecordWrite(double seconds, size_t trackBytes, size_t bytesWritten);
+
+    /// @brief Records an error and prints it if options.printErrors is set.
+    /// @param message The error message.
+    /// @return false, so that callers can return the result directly.
+    bool Fail(const std::string& message);
+
+    /// @brief Gets the name of the .mid file with the specified suffix.
+    /// @param suffix The suffix to add to the .gmd file name's stem.
+    /// @return The name of the .mid file.
+    std::string ExportName(const std::string& suffix) const;
+
+    /// @brief Exports the specified MIDI tracks concurrently.
+    /// @param tracks The track numbers and chunks of the tracks to export.
+    /// @return true if every track was successfully exported.
+    /// @pre The file is open and the MIDI header has been read.
+    bool ExportTracks(const std::vector<std::pair<int, Chunk>>& tracks);
 };
 
-/// @brief Prints the specified ChunkHeader to standard output.
+/// @brief Prints the header of the specified Chunk to standard output.
 /// @param title The title to use when printing the chunk.
-/// @param header The ChunkHeader to print.
-void PrintChunkHeader(std::string title, const ChunkHeader& header);
+/// @param chunk The Chunk to print.
+void PrintChunkHeader(std::string title, const Chunk& chunk);
+
+/// @brief Prints the fields decoded from a chunk to standard output.
+/// @param metadata The ChunkMetadata to print.
+void PrintChunkMetadata(const ChunkMetadata& metadata);
 
 /// @brief Prints the specified MidiHeaderData to standard output.
 /// @param data The MidiHeaderData to print.
 void PrintMidiHeaderData(const MidiHeaderData& data);
 
+/// @brief Prints a table of every chunk in the index to standard output.
+/// @param fileName The name of the file the index was built from.
+/// @param index The index to print.
+void PrintChunkIndex(const std::string& fileName, const ChunkIndex& index);
+
+/// @brief Prints the index to standard output as a single line of JSON.
+/// @param fileName The name of the file the index was built from.
+/// @param index The index to print.
+/// @param data The MIDI header data of the file.
+/// @param metadata The metadata decoded from the chunks of the file.
+void PrintChunkIndexJson(const std::string& fileName, 
+                         const ChunkIndex& index,
+                         const MidiHeaderData& data,
+                         const std::vector<ChunkMetadata>& metadata);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,60 @@
+// GmdReader.cpp - Defines the GmdReader class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sstream>
+#include "GmdReader.h"
+
+bool GmdReader::ReadChunk(Chunk& chunk)
+{
+    if (!data.Contains(position, chunkHeaderSize))
+    {
+        std::stringstream message;
+        message << "Truncated chunk header at offset " << position << " ("
+                << BytesRemaining() << " bytes remaining)";
+        error = message.str();
+        return false;
+    }
+
+    const uint8_t* headerBytes = data.data + position;
+    size_t dataOffset = position + chunkHeaderSize;
+    size_t dataSize = ReadUInt32BE(headerBytes + 4);
+
+    chunk.id = ReadUInt32BE(headerBytes);
+    chunk.offset = position;
+
+    if (!data.Contains(dataOffset, dataSize))
+    {
+        std::stringstream message;
+        message << "Chunk " << chunk.IdString() << " at offset " << position
+                << " declares " << dataSize << " bytes but only "
+                << data.size - dataOffset << " remain";
+        error = message.str();
+        return false;
+    }
+
+    chunk.data = data.Subspan(dataOffset, dataSize);
+    position = dataOffset + dataSize;
+    return true;
+}
+
+bool GmdReader::Seek(size_t offset)
+{
+    if (offset > data.size)
+        return false;
+
+    position = offset;
+    return true;
+}
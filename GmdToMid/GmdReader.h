@@ -0,0 +1,87 @@
+// GmdReader.h - Declares the GmdReader class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GMD_READER_H
+#define GMD_READER_H
+
+#include <string>
+#include "ByteSpan.h"
+#include "ChunkHeader.h"
+#include "FourCC.h"
+
+/// @brief Represents a chunk located within the bytes of a .gmd file.
+///
+/// Unlike ChunkHeader, a Chunk doesn't hold a copy of anything; its data
+/// refers directly to the bytes the chunk was read from.
+struct Chunk
+{
+    /// @brief The 4-byte ID of the chunk as a big endian integer.
+    ///
+    /// Compare it against the constants in FourCC.h rather than IdString(),
+    /// which allocates.
+    uint32_t id{ 0 };
+
+    /// @brief The offset of the chunk header from the start of the file.
+    size_t offset{ 0 };
+
+    /// @brief The data section of the chunk, excluding the header.
+    ByteSpan data;
+
+    /// @brief Gets the chunk ID as a string.
+    /// @return The 4 character chunk ID.
+    std::string IdString() const { return FourCCString(id); }
+};
+
+/// @brief Walks the chunks contained in the bytes of a .gmd file.
+///
+/// Every read is checked against the bounds of the data, so a chunk whose
+/// declared size runs past the end of the file is reported as an error
+/// instead of being read.
+class GmdReader
+{
+public:
+    /// @brief Constructor; creates a new GmdReader over the specified bytes.
+    /// @param data The bytes of the entire .gmd file.
+    GmdReader(ByteSpan data = ByteSpan{}) : data{ data }, position{ 0 } { }
+
+    /// @brief Reads the next chunk and advances past its data.
+    /// @param chunk The chunk to read into.
+    /// @return true if a complete chunk was read, otherwise false.
+    bool ReadChunk(Chunk& chunk);
+
+    /// @brief Moves the reader to the specified offset.
+    /// @param offset The offset of the next chunk header to read.
+    /// @return true if the offset lies within the data, otherwise false.
+    bool Seek(size_t offset);
+
+    /// @brief Gets the number of bytes that have not been read yet.
+    /// @return The number of bytes remaining.
+    size_t BytesRemaining() const { return data.size - position; }
+
+    /// @brief Gets the offset of the next chunk header to read.
+    /// @return The current offset from the start of the data.
+    size_t Position() const { return position; }
+
+    /// @brief Gets a description of the last error that occurred.
+    /// @return The error message, or an empty string if there was no error.
+    const std::string& Error() const { return error; }
+private:
+    ByteSpan data;
+    size_t position;
+    std::string error;
+};
+
+#endif
@@ -0,0 +1,44 @@
+// GmdToMid.cpp - Defines the in-memory conversion API of the library.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "GmdFile.h"
+#include "GmdToMid.h"
+
+ConversionResult ConvertGmd(ByteSpan gmdData, 
+                            const std::string& fileName,
+                            ConversionOptions options)
+{
+    // A library shouldn't write to the console of the program embedding it;
+    // the caller gets the error and stats back in the result instead.
+    options.verbose = false;
+    options.printErrors = false;
+
+    // Nor should it touch the disk, which the cache, the deduplicator, and
+    // the manifest all do, since they store or link .mid files there.
+    options.cache = nullptr;
+    options.dedup = nullptr;
+    options.incremental = nullptr;
+
+    MemorySink sink;
+    GmdFile gmd{ gmdData, fileName, options };
+
+    ConversionResult result;
+    result.succeeded = gmd.Convert(sink);
+    result.error = gmd.Error();
+    result.outputs = sink.TakeOutputs();
+    result.stats = gmd.Stats();
+    return result;
+}
@@ -0,0 +1,62 @@
+// GmdToMid.h - Declares the in-memory conversion API of the library.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GMD_TO_MID_H
+#define GMD_TO_MID_H
+
+#include <string>
+#include <vector>
+#include "ByteSpan.h"
+#include "ConversionOptions.h"
+#include "ConversionStats.h"
+#include "OutputSink.h"
+
+/// @brief Holds the result of converting a .gmd file in memory.
+struct ConversionResult
+{
+    /// @brief Determines if the conversion was successful.
+    bool succeeded{ false };
+
+    /// @brief A description of the error that stopped the conversion.
+    ///
+    /// This is empty when the conversion was successful.
+    std::string error;
+
+    /// @brief The converted .mid files with their suggested names.
+    ///
+    /// The files are in the order they were written, which, when tracks are
+    /// exported in parallel, is not necessarily the order of the tracks.
+    std::vector<MemorySink::Output> outputs;
+
+    /// @brief The timings and counters gathered during the conversion.
+    ConversionStats stats;
+};
+
+/// @brief Converts a .gmd file that is already in memory.
+/// @param gmdData The bytes of the .gmd file.
+/// @param fileName The name of the .gmd file, which the suggested names of
+/// the .mid files are derived from. Nothing is read from or written to disk.
+/// @param options The options that control the conversion. Nothing is 
+/// printed, so options.verbose and options.printErrors are ignored, and
+/// options.cache, options.dedup, and options.incremental are ignored since
+/// they would read from or write to disk.
+/// @return The converted .mid files, or the error that stopped the 
+/// conversion.
+ConversionResult ConvertGmd(ByteSpan gmdData, 
+                            const std::string& fileName,
+                            ConversionOptions options = {});
+
+#endif
@@ -0,0 +1,139 @@
+// GmdValidator.cpp - Defines the checks that reject malformed .gmd files.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sstream>
+#include "ChunkHeader.h"
+#include "EventScanner.h"
+#include "GmdValidator.h"
+#include "MidiEvent.h"
+#include "MidiFile.h"
+#include "MidiHeaderData.h"
+
+bool ValidateStructure(const ChunkIndex& index, std::string& error)
+{
+    std::stringstream message;
+    size_t headerPosition = index.MidiHeaderPosition();
+    if (headerPosition == chunkIndexNone)
+    {
+        error = "GMD file has no MThd chunk";
+        return false;
+    }
+
+    const Chunk& header = index.Chunks()[headerPosition];
+    for (size_t i = headerPosition + 1; i < index.Chunks().size(); i++)
+    {
+        if (index.Chunks()[i].id == midiHeaderFourCC)
+        {
+            message << "GMD file has a second MThd chunk at offset " 
+                    << index.Chunks()[i].offset << " (the first is at offset "
+                    << header.offset << ")";
+            error = message.str();
+            return false;
+        }
+    }
+
+    if (header.data.size < midiHeaderDataSize)
+    {
+        message << "MThd chunk at offset " << header.offset << " is " 
+                << header.data.size << " bytes, but must be at least " 
+                << midiHeaderDataSize;
+        error = message.str();
+        return false;
+    }
+
+    if (index.NumTracks() > 0 && index.Track(0).offset < header.offset)
+    {
+        message << "MTrk chunk at offset " << index.Track(0).offset 
+                << " comes before the MThd chunk at offset " << header.offset;
+        error = message.str();
+        return false;
+    }
+
+    uint16_t format = ReadUInt16BE(header.data.data);
+    uint16_t numTracks = ReadUInt16BE(header.data.data + 2);
+    uint16_t division = ReadUInt16BE(header.data.data + 4);
+    if (format > midiType2ID)
+    {
+        message << "MThd chunk at offset " << header.offset 
+                << " declares unknown MIDI format " << format;
+        error = message.str();
+        return false;
+    }
+
+    if (division == 0)
+    {
+        message << "MThd chunk at offset " << header.offset 
+                << " declares a division of 0 ticks per quarter note";
+        error = message.str();
+        return false;
+    }
+
+    if (numTracks != index.NumTracks())
+    {
+        message << "MThd chunk at offset " << header.offset << " declares " 
+                << numTracks << " tracks, but the file contains " 
+                << index.NumTracks() << " MTrk chunks";
+        error = message.str();
+        return false;
+    }
+
+    return true;
+}
+
+bool ValidateTrack(const ChunkIndex& index, 
+                   size_t trackNum, 
+                   std::string& error)
+{
+    return ValidateTrack(trackNum, index.Track(trackNum), error);
+}
+
+bool ValidateTrack(size_t trackNum, const Chunk& track, std::string& error)
+{
+    // Nearly every track is well formed, which the scanner can tell much
+    // faster than decoding every event. Only a track it rejects is decoded
+    // again to describe the problem.
+    thread_local EventScanner scanner;
+    if (scanner.Scan(track.data) && scanner.ReachedEndOfTrack())
+        return true;
+
+    EventCursor cursor{ track.data };
+    MidiEvent event;
+    while (cursor.Next(event)) { }
+
+    if (cursor.HasError() || !cursor.ReachedEndOfTrack())
+    {
+        // The cursor reports offsets within the track, which we turn into
+        // an offset within the file as well so the byte can be found with a
+        // hex editor.
+        std::stringstream message;
+        message << "Track " << trackNum << " (MTrk chunk at offset " 
+                << track.offset << "): ";
+        if (cursor.HasError())
+        {
+            message << cursor.Error() << " (file offset " 
+                    << track.offset + chunkHeaderSize + cursor.Position() 
+                    << ")";
+        }
+        else
+        {
+            message << "Track ends without an end of track event";
+        }
+        error = message.str();
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,62 @@
+// GmdValidator.h - Declares the checks that reject malformed .gmd files.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GMD_VALIDATOR_H
+#define GMD_VALIDATOR_H
+
+#include <string>
+#include "ChunkIndex.h"
+
+/// @brief Checks that the chunks of a .gmd file fit together.
+/// @param index The chunk index of the file.
+/// @param error A description of the first problem found, if any.
+/// @return true if the structure is valid, otherwise false.
+///
+/// Building the index already checks every chunk against the real size of
+/// the file, so this only has to check the chunks against each other: there
+/// must be exactly one MIDI header, it must be large enough and come before
+/// every track, its format and division must be usable, and it must declare
+/// as many tracks as there are. Only the chunk headers and the 6 bytes of
+/// MIDI header data are read, so this takes microseconds even for large
+/// files, and nothing has been allocated or written by the time it fails.
+bool ValidateStructure(const ChunkIndex& index, std::string& error);
+
+/// @brief Checks that the events of a track can be decoded.
+/// @param index The chunk index of the file.
+/// @param trackNum The zero-based number of the track.
+/// @param error A description of the first problem found, if any.
+/// @return true if the track is valid, otherwise false.
+/// @pre trackNum is less than index.NumTracks().
+///
+/// Every event is decoded, so every length, status byte, and variable
+/// length quantity is checked, and the track must end with an end of track
+/// event. Unlike ValidateStructure this reads the whole track.
+bool ValidateTrack(const ChunkIndex& index, 
+                   size_t trackNum, 
+                   std::string& error);
+
+/// @brief Checks that the events of a track can be decoded.
+/// @param trackNum The zero-based number of the track, which is only used
+/// to describe the problem.
+/// @param track The MTrk chunk of the track.
+/// @param error A description of the first problem found, if any.
+/// @return true if the track is valid, otherwise false.
+///
+/// This is for callers without a chunk index, such as the stream converter,
+/// which sees each track only once it has been read.
+bool ValidateTrack(size_t trackNum, const Chunk& track, std::string& error);
+
+#endif
@@ -0,0 +1,139 @@
+// Hash.cpp - Defines the hash functions used to identify file contents.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstring>
+#include "Hash.h"
+
+inline constexpr uint64_t xxh64Prime1{ 0x9E3779B185EBCA87ULL };
+inline constexpr uint64_t xxh64Prime2{ 0xC2B2AE3D27D4EB4FULL };
+inline constexpr uint64_t xxh64Prime3{ 0x165667B19E3779F9ULL };
+inline constexpr uint64_t xxh64Prime4{ 0x85EBCA77C2B2AE63ULL };
+inline constexpr uint64_t xxh64Prime5{ 0x27D4EB2F165667C5ULL };
+
+/// @brief The number of bytes consumed by each round of the main loop.
+inline constexpr size_t xxh64StripeSize{ 32 };
+
+static uint64_t RotateLeft(uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+/// @brief Reads a little endian 64-bit integer, as XXH64 is defined.
+static uint64_t ReadUInt64LE(const uint8_t* bytes)
+{
+    uint64_t value{ 0 };
+    for (int i = 7; i >= 0; i--)
+        value = (value << 8) | bytes[i];
+    return value;
+}
+
+/// @brief Reads a little endian 32-bit integer, as XXH64 is defined.
+static uint32_t ReadUInt32LE(const uint8_t* bytes)
+{
+    return static_cast<uint32_t>(bytes[0]) | 
+           static_cast<uint32_t>(bytes[1]) << 8 |
+           static_cast<uint32_t>(bytes[2]) << 16 | 
+           static_cast<uint32_t>(bytes[3]) << 24;
+}
+
+static uint64_t Round(uint64_t accumulator, uint64_t input)
+{
+    accumulator += input * xxh64Prime2;
+    accumulator = RotateLeft(accumulator, 31);
+    return accumulator * xxh64Prime1;
+}
+
+static uint64_t MergeRound(uint64_t accumulator, uint64_t value)
+{
+    accumulator ^= Round(0, value);
+    return accumulator * xxh64Prime1 + xxh64Prime4;
+}
+
+uint64_t Xxh64(ByteSpan data, uint64_t seed)
+{
+    const uint8_t* position = data.data;
+    const uint8_t* end = data.data + data.size;
+    uint64_t hash;
+
+    if (data.size >= xxh64StripeSize)
+    {
+        uint64_t v1 = seed + xxh64Prime1 + xxh64Prime2;
+        uint64_t v2 = seed + xxh64Prime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - xxh64Prime1;
+
+        const uint8_t* lastStripe = end - xxh64StripeSize;
+        do
+        {
+            v1 = Round(v1, ReadUInt64LE(position));
+            v2 = Round(v2, ReadUInt64LE(position + 8));
+            v3 = Round(v3, ReadUInt64LE(position + 16));
+            v4 = Round(v4, ReadUInt64LE(position + 24));
+            position += xxh64StripeSize;
+        } while (position <= lastStripe);
+
+        hash = RotateLeft(v1, 1) + RotateLeft(v2, 7) + 
+               RotateLeft(v3, 12) + RotateLeft(v4, 18);
+        hash = MergeRound(hash, v1);
+        hash = MergeRound(hash, v2);
+        hash = MergeRound(hash, v3);
+        hash = MergeRound(hash, v4);
+    }
+    else
+    {
+        hash = seed + xxh64Prime5;
+    }
+
+    hash += static_cast<uint64_t>(data.size);
+
+    for (; position + 8 <= end; position += 8)
+    {
+        hash ^= Round(0, ReadUInt64LE(position));
+        hash = RotateLeft(hash, 27) * xxh64Prime1 + xxh64Prime4;
+    }
+
+    if (position + 4 <= end)
+    {
+        hash ^= static_cast<uint64_t>(ReadUInt32LE(position)) * xxh64Prime1;
+        hash = RotateLeft(hash, 23) * xxh64Prime2 + xxh64Prime3;
+        position += 4;
+    }
+
+    for (; position < end; position++)
+    {
+        hash ^= static_cast<uint64_t>(*position) * xxh64Prime5;
+        hash = RotateLeft(hash, 11) * xxh64Prime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= xxh64Prime2;
+    hash ^= hash >> 29;
+    hash *= xxh64Prime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+std::string HashToString(uint64_t hash)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string text(16, '0');
+    for (int i = 15; i >= 0; i--)
+    {
+        text[i] = digits[hash & 0xF];
+        hash >>= 4;
+    }
+    return text;
+}
@@ -0,0 +1,38 @@
+// Hash.h - Declares the hash functions used to identify file contents.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstdint>
+#include <string>
+#include "ByteSpan.h"
+
+/// @brief Computes the 64-bit xxHash (XXH64) of a block of bytes.
+/// @param data The bytes to hash.
+/// @param seed The seed, which gives a different hash for the same bytes.
+/// @return The hash, identical to the reference XXH64 implementation.
+///
+/// XXH64 runs at close to memory bandwidth, so hashing an input costs less
+/// than reading it from disk. It is not a cryptographic hash.
+uint64_t Xxh64(ByteSpan data, uint64_t seed = 0);
+
+/// @brief Formats a hash as 16 lowercase hexadecimal digits.
+/// @param hash The hash to format.
+/// @return The formatted hash.
+std::string HashToString(uint64_t hash);
+
+#endif
@@ -0,0 +1,427 @@
+// IncrementalManifest.cpp - Defines the IncrementalManifest class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include "ConversionCache.h"
+#include "Hash.h"
+#include "IncrementalManifest.h"
+#include "MappedFile.h"
+
+/// @brief The word the first line of every manifest starts with.
+inline const char* incrementalManifestMagic{ "gmdtomid-manifest" };
+
+/// @brief Gets the output directory the files of a conversion are written to.
+/// @param options The options of the conversion.
+/// @return The output directory.
+static std::filesystem::path OutputDirectoryOf(
+    const ConversionOptions& options)
+{
+    if (options.outputDirectory.empty())
+        return ".";
+    return options.outputDirectory;
+}
+
+/// @brief Gets the key of the entry of an input.
+/// @param input The path of the .gmd file.
+/// @return The absolute path of the input, or empty if it can't be kept in
+/// a manifest.
+static std::string EntryKeyOf(const std::string& input)
+{
+    std::error_code error;
+    std::filesystem::path path = std::filesystem::absolute(input, error);
+    std::string key = path.lexically_normal().string();
+
+    // The manifest is made of tab separated lines.
+    if (error || key.find_first_of("\t\r\n") != std::string::npos)
+        return {};
+    return key;
+}
+
+/// @brief Determines if an output name read from a manifest is a plain 
+/// file name.
+/// @param name The name of the output.
+/// @return true if the name refers to a file within the output directory,
+/// or false if it could refer to anything else, e.g. ../song.gmd or an
+/// absolute path.
+static bool IsPlainFileName(const std::string& name)
+{
+    // Outputs are removed by name, so a manifest that was tampered with or
+    // damaged must not be able to point anywhere else.
+    std::filesystem::path path{ name };
+    return !name.empty() && name != "." && name != ".." &&
+           name.find_first_of("/\\") == std::string::npos &&
+           !path.has_root_path() && path.filename() == path;
+}
+
+/// @brief Hashes a file on disk.
+/// @param path The path of the file.
+/// @param hash Set to the XXH64 hash of the file.
+/// @return true if the file was read, otherwise false.
+static bool HashFile(const std::filesystem::path& path, uint64_t& hash)
+{
+    MappedFile file{ path.string() };
+    if (!file.Open())
+        return false;
+
+    hash = Xxh64(file.Data());
+    return true;
+}
+
+bool IncrementalManifest::Check(const std::string& input, 
+                                const ConversionOptions& options, 
+                                ManifestEntry& entry)
+{
+    entry = ManifestEntry{};
+    std::error_code sizeError;
+    std::error_code timeError;
+    entry.inputSize = std::filesystem::file_size(input, sizeError);
+    entry.inputModified = 
+        std::filesystem::last_write_time(input, timeError)
+            .time_since_epoch().count();
+    entry.optionsKey = ConversionCache::OptionsKey(options);
+
+    std::string key = EntryKeyOf(input);
+    std::filesystem::path directory = OutputDirectoryOf(options);
+    ManifestEntry recorded;
+    std::filesystem::file_time_type savedTime;
+    bool found{ false };
+    if (!sizeError && !timeError && !key.empty())
+    {
+        std::lock_guard<std::mutex> lock{ mutex };
+        Directory& manifest = DirectoryOf(directory);
+        auto it = manifest.entries.find(key);
+        if (it != manifest.entries.end())
+        {
+            recorded = it->second;
+            savedTime = manifest.savedTime;
+            found = true;
+        }
+    }
+
+    // The outputs are checked without holding the lock, since any of them
+    // may have to be hashed.
+    if (found && recorded.inputSize == entry.inputSize &&
+        recorded.inputModified == entry.inputModified &&
+        recorded.optionsKey == entry.optionsKey &&
+        OutputsIntact(directory, savedTime, recorded))
+    {
+        upToDate++;
+        return true;
+    }
+
+    stale++;
+    return false;
+}
+
+uint64_t IncrementalManifest::Record(const std::string& input,
+                                     const ConversionOptions& options,
+                                     ManifestEntry entry,
+                                     std::vector<std::string> names)
+{
+    std::string key = EntryKeyOf(input);
+    if (key.empty())
+        return 0;
+
+    // Parallel tracks finish in any order, but the manifest shouldn't
+    // change just because they did.
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+
+    std::filesystem::path directory = OutputDirectoryOf(options);
+    bool recorded{ true };
+    for (const std::string& name : names)
+    {
+        ManifestOutput output;
+        output.name = name;
+        std::error_code error;
+        output.size = std::filesystem::file_size(directory / name, error);
+        if (error || !HashFile(directory / name, output.hash))
+        {
+            recorded = false;
+            break;
+        }
+        entry.outputs.push_back(output);
+    }
+
+    std::vector<std::string> orphans;
+    {
+        std::lock_guard<std::mutex> lock{ mutex };
+        Directory& manifest = DirectoryOf(directory);
+        manifest.changed = true;
+        auto it = manifest.entries.find(key);
+        if (it != manifest.entries.end())
+        {
+            for (const ManifestOutput& output : it->second.outputs)
+            {
+                if (!std::binary_search(names.begin(), names.end(), 
+                                        output.name))
+                {
+                    orphans.push_back(output.name);
+                }
+            }
+            manifest.entries.erase(it);
+        }
+
+        // Two inputs with the same name in different directories write 
+        // the same outputs, so whatever the other one wrote stays.
+        std::set<std::string> claimed;
+        for (const auto& [otherKey, otherEntry] : manifest.entries)
+        {
+            for (const ManifestOutput& output : otherEntry.outputs)
+                claimed.insert(output.name);
+        }
+        orphans.erase(std::remove_if(orphans.begin(), orphans.end(),
+                                     [&claimed](const std::string& name)
+                                     {
+                                         return claimed.count(name) > 0;
+                                     }),
+                      orphans.end());
+
+        // An input whose outputs can't be checked is left out, so that it
+        // is converted again next time.
+        if (recorded)
+            manifest.entries[key] = std::move(entry);
+    }
+
+    uint64_t numRemoved{ 0 };
+    for (const std::string& name : orphans)
+    {
+        std::error_code error;
+        if (std::filesystem::remove(directory / name, error))
+            numRemoved++;
+    }
+
+    orphansRemoved += numRemoved;
+    return numRemoved;
+}
+
+bool IncrementalManifest::Save()
+{
+    std::lock_guard<std::mutex> lock{ mutex };
+    bool saved{ true };
+    for (auto& [path, manifest] : directories)
+    {
+        if (!manifest->changed)
+            continue;
+
+        // The manifest is replaced in one step, so a run that is 
+        // interrupted leaves the last one intact.
+        std::filesystem::path manifestPath = 
+            std::filesystem::path{ path } / incrementalManifestName;
+        std::filesystem::path tempPath = manifestPath;
+        tempPath += ".tmp";
+
+        std::ofstream stream{ tempPath, std::ios::binary };
+        stream << incrementalManifestMagic << ' ' 
+               << incrementalManifestVersion << '\n';
+        for (const auto& [input, entry] : manifest->entries)
+        {
+            stream << input << '\t' << entry.inputSize << '\t' 
+                   << entry.inputModified << '\t' << entry.optionsKey << '\t' 
+                   << entry.outputs.size() << '\n';
+            for (const ManifestOutput& output : entry.outputs)
+            {
+                stream << output.name << '\t' << output.size << '\t' 
+                       << HashToString(output.hash) << '\n';
+            }
+        }
+        stream.close();
+
+        std::error_code error;
+        if (!stream.fail())
+            std::filesystem::rename(tempPath, manifestPath, error);
+        if (stream.fail() || error)
+        {
+            std::filesystem::remove(tempPath, error);
+            saved = false;
+            continue;
+        }
+
+        // Every output recorded so far was hashed when it was recorded, so
+        // only outputs modified from now on need hashing again.
+        auto savedTime = std::filesystem::last_write_time(manifestPath, 
+                                                          error);
+        if (!error)
+            manifest->savedTime = savedTime;
+        manifest->changed = false;
+    }
+
+    return saved;
+}
+
+IncrementalManifestStats IncrementalManifest::Stats() const
+{
+    IncrementalManifestStats stats;
+    stats.upToDate = upToDate;
+    stats.stale = stale;
+    stats.orphansRemoved = orphansRemoved;
+    return stats;
+}
+
+bool IncrementalManifest::Recorder::Write(const std::string& name, 
+                                          const std::vector<ByteSpan>& pieces)
+{
+    if (!sink.Write(name, pieces))
+        return false;
+
+    Add(name);
+    return true;
+}
+
+bool IncrementalManifest::Recorder::WriteBuffer(
+    const std::string& name, 
+    std::vector<uint8_t>&& buffer)
+{
+    if (!sink.WriteBuffer(name, std::move(buffer)))
+        return false;
+
+    Add(name);
+    return true;
+}
+
+bool IncrementalManifest::Recorder::Link(const std::string& name, 
+                                         const std::filesystem::path& source)
+{
+    if (!sink.Link(name, source))
+        return false;
+
+    Add(name);
+    return true;
+}
+
+std::vector<std::string> IncrementalManifest::Recorder::Names()
+{
+    std::lock_guard<std::mutex> lock{ mutex };
+    return names;
+}
+
+void IncrementalManifest::Recorder::Add(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock{ mutex };
+    names.push_back(name);
+}
+
+IncrementalManifest::Directory& IncrementalManifest::DirectoryOf(
+    const std::filesystem::path& directory)
+{
+    std::string key = directory.lexically_normal().string();
+    auto it = directories.find(key);
+    if (it != directories.end())
+        return *it->second;
+
+    auto manifest = std::make_unique<Directory>();
+    if (!Load(directory, *manifest))
+        *manifest = Directory{};
+
+    Directory& loaded = *manifest;
+    directories.emplace(key, std::move(manifest));
+    return loaded;
+}
+
+bool IncrementalManifest::Load(const std::filesystem::path& directory, 
+                               Directory& manifest)
+{
+    std::filesystem::path manifestPath = directory / incrementalManifestName;
+    std::error_code error;
+    manifest.savedTime = std::filesystem::last_write_time(manifestPath, 
+                                                          error);
+    if (error)
+        return false;
+
+    std::ifstream stream{ manifestPath, std::ios::binary };
+    std::string magic;
+    int version{ 0 };
+    std::string line;
+    if (!(stream >> magic >> version) || !std::getline(stream, line) ||
+        magic != incrementalManifestMagic || 
+        version != incrementalManifestVersion)
+    {
+        return false;
+    }
+
+    while (std::getline(stream, line))
+    {
+        std::istringstream fields{ line };
+        std::string input;
+        ManifestEntry entry;
+        size_t numOutputs{ 0 };
+        if (!std::getline(fields, input, '\t') || 
+            !(fields >> entry.inputSize >> entry.inputModified >> 
+              entry.optionsKey >> numOutputs))
+        {
+            return false;
+        }
+
+        for (size_t outputNum = 0; outputNum < numOutputs; outputNum++)
+        {
+            ManifestOutput output;
+            std::string hash;
+            if (!std::getline(stream, line))
+                return false;
+
+            std::istringstream outputFields{ line };
+            if (!std::getline(outputFields, output.name, '\t') ||
+                !IsPlainFileName(output.name) ||
+                !(outputFields >> output.size >> hash) || hash.size() != 16 ||
+                hash.find_first_not_of("0123456789abcdef") != 
+                std::string::npos)
+            {
+                return false;
+            }
+
+            output.hash = std::stoull(hash, nullptr, 16);
+            entry.outputs.push_back(output);
+        }
+
+        manifest.entries[input] = std::move(entry);
+    }
+
+    return true;
+}
+
+bool IncrementalManifest::OutputsIntact(
+    const std::filesystem::path& directory,
+    std::filesystem::file_time_type savedTime,
+    const ManifestEntry& entry)
+{
+    for (const ManifestOutput& output : entry.outputs)
+    {
+        std::filesystem::path path = directory / output.name;
+        std::error_code error;
+        if (std::filesystem::file_size(path, error) != output.size || error)
+            return false;
+
+        // An output that hasn't been touched since the manifest was written
+        // is trusted, anything else has to prove it still holds the same 
+        // bytes. Equal times are hashed too, as some file systems only keep
+        // the time to the second.
+        auto modified = std::filesystem::last_write_time(path, error);
+        if (error)
+            return false;
+
+        uint64_t hash{ 0 };
+        if (modified >= savedTime && 
+            (!HashFile(path, hash) || hash != output.hash))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,225 @@
+// IncrementalManifest.h - Declares the IncrementalManifest class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INCREMENTAL_MANIFEST_H
+#define INCREMENTAL_MANIFEST_H
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ConversionOptions.h"
+#include "OutputSink.h"
+
+/// @brief The name of the manifest kept in each output directory.
+inline const char* incrementalManifestName{ ".gmdtomid-manifest" };
+
+/// @brief The version written on the first line of each manifest.
+///
+/// A manifest with any other version is ignored, so every input in its
+/// directory is converted again and the manifest rewritten.
+inline constexpr int incrementalManifestVersion{ 1 };
+
+/// @brief Describes a .mid file recorded in a manifest.
+struct ManifestOutput
+{
+    /// @brief The name of the file within the output directory.
+    std::string name;
+
+    /// @brief The size of the file in bytes.
+    uint64_t size{ 0 };
+
+    /// @brief The XXH64 hash of the file. @see Xxh64
+    uint64_t hash{ 0 };
+};
+
+/// @brief Describes the conversion of one input recorded in a manifest.
+struct ManifestEntry
+{
+    /// @brief The size of the .gmd file when it was converted, in bytes.
+    uint64_t inputSize{ 0 };
+
+    /// @brief The time the .gmd file was last modified when it was 
+    /// converted, in the ticks of std::filesystem::file_time_type.
+    int64_t inputModified{ 0 };
+
+    /// @brief The options the file was converted with. 
+    /// @see ConversionCache::OptionsKey
+    std::string optionsKey;
+
+    /// @brief Every .mid file the conversion wrote.
+    std::vector<ManifestOutput> outputs;
+};
+
+/// @brief Holds the counters of an IncrementalManifest.
+struct IncrementalManifestStats
+{
+    /// @brief The number of inputs skipped because they were up to date.
+    uint64_t upToDate{ 0 };
+
+    /// @brief The number of inputs converted because they were new or had
+    /// changed, or their outputs had.
+    uint64_t stale{ 0 };
+
+    /// @brief The number of outputs of earlier conversions that were
+    /// removed because the new conversion no longer wrote them.
+    uint64_t orphansRemoved{ 0 };
+};
+
+/// @brief Remembers what each input was converted into, so that a run over
+/// the same library only converts the inputs that changed.
+///
+/// Every output directory keeps its own manifest, a small text file named 
+/// incrementalManifestName, with an entry for each input converted into
+/// it. An entry records the size and modification time of the input, the
+/// options it was converted with, and the size and hash of every output. An
+/// input is up to date when all of these still match, which costs a few 
+/// calls to stat: the input is never read, and an output is only hashed
+/// when it was modified after the manifest was written.
+///
+/// When an input is converted again, outputs of the last conversion that
+/// it no longer writes, e.g. because the .gmd file now has fewer tracks, 
+/// are removed. Nothing else in the directory is ever removed.
+///
+/// The manifests are loaded the first time a directory is used and written
+/// back by Save(), which can be called as often as needed, e.g. after every
+/// conversion of a long running watch. Several threads can share an 
+/// IncrementalManifest, but not several processes.
+class IncrementalManifest
+{
+public:
+    /// @brief Determines if an input is up to date.
+    /// @param input The path of the .gmd file.
+    /// @param options The options the file is converted with.
+    /// @param entry Set to the fingerprint of the input as it is now, to 
+    /// pass to Record() once it has been converted.
+    /// @return true if the outputs of the input are up to date, or false if
+    /// it needs to be converted.
+    bool Check(const std::string& input, 
+               const ConversionOptions& options, 
+               ManifestEntry& entry);
+
+    /// @brief Records the outputs of a successful conversion and removes
+    /// the outputs of the last one that weren't written again.
+    /// @param input The path of the .gmd file.
+    /// @param options The options the file was converted with.
+    /// @param entry The fingerprint set by Check() before the conversion.
+    /// @param names The names of the files the conversion wrote to 
+    /// options.outputDirectory.
+    /// @return The number of orphaned outputs removed.
+    uint64_t Record(const std::string& input,
+                    const ConversionOptions& options,
+                    ManifestEntry entry,
+                    std::vector<std::string> names);
+
+    /// @brief Writes every manifest that has changed since it was loaded or
+    /// last written.
+    /// @return true if every manifest was written, otherwise false.
+    bool Save();
+
+    /// @brief Gets the counters of the manifest.
+    /// @return The counters.
+    IncrementalManifestStats Stats() const;
+
+    /// @brief Records the names of the files written to another sink, 
+    /// which the files are forwarded to.
+    class Recorder : public OutputSink
+    {
+    public:
+        /// @brief Constructor; creates a new Recorder.
+        /// @param sink The sink to forward the files to.
+        Recorder(OutputSink& sink) : sink{ sink } { }
+
+        bool Write(const std::string& name, 
+                   const std::vector<ByteSpan>& pieces) override;
+
+        bool WriteBuffer(const std::string& name, 
+                         std::vector<uint8_t>&& buffer) override;
+
+        bool Link(const std::string& name, 
+                  const std::filesystem::path& source) override;
+
+        void Pin(ByteSpan bytes) override { sink.Pin(bytes); }
+
+        std::vector<std::string> Flush() override { return sink.Flush(); }
+
+        std::string PathOf(const std::string& name) const override
+        {
+            return sink.PathOf(name);
+        }
+
+        /// @brief Gets the names of the files written so far.
+        /// @return The names, in the order the files were written.
+        std::vector<std::string> Names();
+    private:
+        OutputSink& sink;
+        std::mutex mutex;
+        std::vector<std::string> names;
+
+        /// @brief Records the name of a file that was written.
+        /// @param name The name of the file.
+        void Add(const std::string& name);
+    };
+private:
+    /// @brief Holds the manifest of one output directory.
+    struct Directory
+    {
+        /// @brief The entries, keyed by the absolute path of the input.
+        std::map<std::string, ManifestEntry> entries;
+
+        /// @brief The time the manifest was last written.
+        std::filesystem::file_time_type savedTime;
+
+        /// @brief Determines if an entry has changed since the manifest was
+        /// loaded or last written.
+        bool changed{ false };
+    };
+
+    std::mutex mutex;
+    std::map<std::string, std::unique_ptr<Directory>> directories;
+    std::atomic<uint64_t> upToDate{ 0 };
+    std::atomic<uint64_t> stale{ 0 };
+    std::atomic<uint64_t> orphansRemoved{ 0 };
+
+    /// @brief Gets the manifest of an output directory, loading it the 
+    /// first time.
+    /// @param directory The output directory.
+    /// @return The manifest, which is only used while holding mutex.
+    Directory& DirectoryOf(const std::filesystem::path& directory);
+
+    /// @brief Reads the manifest of an output directory.
+    /// @param directory The output directory.
+    /// @param manifest Set to the entries of the manifest.
+    /// @return true if the manifest was read, or false if there isn't one
+    /// or it can't be used.
+    static bool Load(const std::filesystem::path& directory, 
+                     Directory& manifest);
+
+    /// @brief Determines if every output of an entry is intact.
+    /// @param directory The output directory.
+    /// @param savedTime The time the manifest was last written.
+    /// @param entry The entry.
+    /// @return true if every output exists and is unchanged.
+    static bool OutputsIntact(const std::filesystem::path& directory,
+                              std::filesystem::file_time_type savedTime,
+                              const ManifestEntry& entry);
+};
+
+#endif
@@ -0,0 +1,116 @@
+// Json.h - Declares helpers for writing JSON output.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef JSON_H
+#define JSON_H
+
+#include <cstddef>
+#include <string>
+
+/// @brief Measures the UTF-8 sequence that starts at a position.
+/// @param value The string the sequence is in.
+/// @param position The position of the first byte of the sequence.
+/// @return The number of bytes in the sequence, or 0 if the bytes there
+/// aren't valid UTF-8, including overlong forms and surrogates.
+inline size_t Utf8SequenceLength(const std::string& value, size_t position)
+{
+    auto byteAt = [&](size_t offset)
+    {
+        return static_cast<unsigned char>(value[position + offset]);
+    };
+
+    unsigned char lead = byteAt(0);
+    size_t length{ 0 };
+    unsigned char low{ 0x80 };
+    unsigned char high{ 0xBF };
+    if (lead >= 0xC2 && lead <= 0xDF)
+        length = 2;
+    else if (lead >= 0xE0 && lead <= 0xEF)
+        length = 3;
+    else if (lead >= 0xF0 && lead <= 0xF4)
+        length = 4;
+    else
+        return 0;
+
+    // Only the second byte has a narrower range, which rules out the
+    // overlong forms, the surrogates, and anything past U+10FFFF.
+    if (lead == 0xE0)
+        low = 0xA0;
+    else if (lead == 0xED)
+        high = 0x9F;
+    else if (lead == 0xF0)
+        low = 0x90;
+    else if (lead == 0xF4)
+        high = 0x8F;
+
+    if (position + length > value.size())
+        return 0;
+
+    if (byteAt(1) < low || byteAt(1) > high)
+        return 0;
+
+    for (size_t i = 2; i < length; i++)
+    {
+        if (byteAt(i) < 0x80 || byteAt(i) > 0xBF)
+            return 0;
+    }
+
+    return length;
+}
+
+/// @brief Quotes and escapes a string so it can be written as a JSON value.
+/// @param value The string to quote.
+/// @return The quoted and escaped string.
+///
+/// Chunk IDs come straight from the input file and may contain any byte,
+/// so control characters are escaped rather than written as-is, and so is
+/// every byte that isn't part of a valid UTF-8 sequence, as the Latin-1
+/// character with the same value, since JSON must be valid UTF-8. Valid
+/// UTF-8, such as in file names, is passed through unchanged.
+inline std::string JsonString(const std::string& value)
+{
+    static const char* hexDigits{ "0123456789abcdef" };
+
+    std::string quoted{ "\"" };
+    for (size_t i = 0; i < value.size(); i++)
+    {
+        char c = value[i];
+        auto byte = static_cast<unsigned char>(c);
+        size_t sequenceLength = byte >= 0x80 ? 
+            Utf8SequenceLength(value, i) : 1;
+        if (c == '"' || c == '\\')
+        {
+            quoted += '\\';
+            quoted += c;
+        }
+        else if (byte < 0x20 || byte == 0x7F || sequenceLength == 0)
+        {
+            quoted += "\\u00";
+            quoted += hexDigits[byte >> 4];
+            quoted += hexDigits[byte & 0x0F];
+        }
+        else
+        {
+            quoted.append(value, i, sequenceLength);
+            i += sequenceLength - 1;
+        }
+    }
+
+    quoted += '"';
+    return quoted;
+}
+
+#endif
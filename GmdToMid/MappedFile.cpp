@@ -0,0 +1,152 @@
+// MappedFile.cpp - Defines the MappedFile class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open()
+{
+    Close();
+
+    HANDLE fileHandle = CreateFileA(fileName.c_str(), GENERIC_READ,
+                                    FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                    FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize))
+    {
+        CloseHandle(fileHandle);
+        return false;
+    }
+
+    size = static_cast<size_t>(fileSize.QuadPart);
+
+    // Windows refuses to map an empty file, but an empty file is still a
+    // valid (if useless) input, so we treat it as an empty mapping.
+    if (size == 0)
+    {
+        CloseHandle(fileHandle);
+        isOpen = true;
+        return true;
+    }
+
+    HANDLE mappingHandle = CreateFileMappingA(fileHandle, nullptr,
+                                              PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(fileHandle);
+    if (mappingHandle == nullptr)
+        return false;
+
+    // The view keeps the mapping alive, so both handles can be closed now.
+    void* view = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mappingHandle);
+    if (view == nullptr)
+        return false;
+
+    data = static_cast<const uint8_t*>(view);
+    isOpen = true;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data != nullptr)
+        UnmapViewOfFile(data);
+
+    data = nullptr;
+    size = 0;
+    isOpen = false;
+}
+
+#else
+
+bool MappedFile::Open()
+{
+    Close();
+
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || !S_ISREG(fileStat.st_mode))
+    {
+        close(fd);
+        return false;
+    }
+
+    size = static_cast<size_t>(fileStat.st_size);
+
+    // mmap() rejects zero length mappings, but an empty file is still a
+    // valid (if useless) input, so we treat it as an empty mapping.
+    if (size == 0)
+    {
+        close(fd);
+        isOpen = true;
+        return true;
+    }
+
+    // The mapping holds its own reference to the file, so the descriptor
+    // can be closed as soon as the mapping exists.
+    void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED)
+    {
+        size = 0;
+        return false;
+    }
+
+    // Chunks are walked front to back, so let the kernel read ahead.
+    madvise(view, size, MADV_SEQUENTIAL);
+
+    data = static_cast<const uint8_t*>(view);
+    isOpen = true;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data != nullptr)
+        munmap(const_cast<uint8_t*>(data), size);
+
+    data = nullptr;
+    size = 0;
+    isOpen = false;
+}
+
+#endif
@@ -0,0 +1,68 @@
+// MappedFile.h - Declares the MappedFile class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include "ByteSpan.h"
+
+/// @brief Represents a read-only file mapped into memory.
+///
+/// Mapping the file lets the OS page the data in on demand, so reading a
+/// chunk is just pointer arithmetic and chunks we skip are never copied. The
+/// mapping is released when the MappedFile is destroyed, which invalidates
+/// every ByteSpan obtained from Data().
+class MappedFile
+{
+public:
+    /// @brief Constructor; creates a new MappedFile instance from file name.
+    /// @param fileName The name of the file to map.
+    MappedFile(std::string fileName) : fileName{ fileName } { }
+
+    /// @brief Destructor; unmaps the file if it is mapped.
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /// @brief Maps the file into memory.
+    /// @return true if the file was mapped, otherwise false.
+    bool Open();
+
+    /// @brief Determines if the file is currently mapped.
+    /// @return true if the file is mapped, otherwise false.
+    bool IsOpen() const { return isOpen; }
+
+    /// @brief Gets the mapped bytes of the file.
+    /// @return A span covering the entire file.
+    /// @pre The file is open.
+    ByteSpan Data() const { return ByteSpan{ data, size }; }
+
+    /// @brief Gets the size of the mapped file.
+    /// @return The size of the file in bytes.
+    size_t Size() const { return size; }
+private:
+    std::string fileName;
+    const uint8_t* data{ nullptr };
+    size_t size{ 0 };
+    bool isOpen{ false };
+
+    /// @brief Unmaps the file if it is mapped.
+    void Close();
+};
+
+#endif
@@ -0,0 +1,172 @@
+// MidiEvent.cpp - Defines the EventCursor class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sstream>
+#include "MidiEvent.h"
+
+bool EventCursor::Next(MidiEvent& event)
+{
+    if (reachedEndOfTrack || HasError() || position >= track.size)
+        return false;
+
+    event.offset = static_cast<uint32_t>(position);
+    if (!ReadVarLen(event.delta))
+        return false;
+
+    tick += event.delta;
+    event.tick = tick;
+
+    if (position >= track.size)
+        return Fail("Event is missing its status byte");
+
+    uint8_t status = track.data[position];
+    if (status >= 0x80)
+    {
+        position++;
+    }
+    else if (runningStatus != 0)
+    {
+        // Running status: the byte we just peeked at is the first data byte
+        // and the status is the same as the previous channel event's.
+        status = runningStatus;
+    }
+    else
+    {
+        return Fail("Data byte found without a running status");
+    }
+
+    event.status = status;
+    event.metaType = 0;
+
+    if (status < midiSysEx)
+    {
+        runningStatus = status;
+        event.dataOffset = static_cast<uint32_t>(position);
+        event.dataLength = ChannelEventDataLength(status);
+    }
+    else if (status == midiMeta)
+    {
+        if (position >= track.size)
+            return Fail("Meta event is missing its type");
+
+        event.metaType = track.data[position++];
+        if (!ReadVarLen(event.dataLength))
+            return false;
+        event.dataOffset = static_cast<uint32_t>(position);
+    }
+    else if (status == midiSysEx || status == midiSysExEscape)
+    {
+        if (!ReadVarLen(event.dataLength))
+            return false;
+        event.dataOffset = static_cast<uint32_t>(position);
+    }
+    else
+    {
+        std::stringstream message;
+        message << "Unsupported status byte 0x" << std::hex 
+                << static_cast<int>(status);
+        return Fail(message.str());
+    }
+
+    if (!track.Contains(event.dataOffset, event.dataLength))
+        return Fail("Event data runs past the end of the track");
+
+    position = event.dataOffset + event.dataLength;
+
+    // A channel event that is cut short runs into the next status byte, 
+    // which would otherwise be taken as its data.
+    if (status < midiSysEx)
+    {
+        for (uint32_t i = 0; i < event.dataLength; i++)
+        {
+            if (track.data[event.dataOffset + i] >= 0x80)
+            {
+                position = event.dataOffset + i;
+                return Fail("Channel event data byte has its top bit set");
+            }
+        }
+    }
+
+    if (status == midiMeta && event.metaType == midiMetaEndOfTrack)
+        reachedEndOfTrack = true;
+
+    return true;
+}
+
+void EventCursor::Seek(size_t position, uint32_t tick, uint8_t runningStatus)
+{
+    this->position = position;
+    this->tick = tick;
+    this->runningStatus = runningStatus;
+    reachedEndOfTrack = false;
+    error.clear();
+}
+
+bool EventCursor::ReadVarLen(uint32_t& value)
+{
+    value = 0;
+    for (int i = 0; i < midiMaxVarLenSize; i++)
+    {
+        if (position >= track.size)
+            return Fail("Variable length quantity runs past the end of the "
+                        "track");
+
+        uint8_t byte = track.data[position++];
+        value = (value << 7) | (byte & 0x7F);
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+
+    return Fail("Variable length quantity is longer than 4 bytes");
+}
+
+bool EventCursor::Fail(const std::string& message)
+{
+    std::stringstream fullMessage;
+    fullMessage << message << " at track offset " << position;
+    error = fullMessage.str();
+    return false;
+}
+
+void AppendVarLen(std::vector<uint8_t>& buffer, uint32_t value)
+{
+    uint8_t bytes[midiMaxVarLenSize];
+    int numBytes{ 0 };
+    do
+    {
+        bytes[numBytes++] = value & 0x7F;
+        value >>= 7;
+    } while (value > 0 && numBytes < midiMaxVarLenSize);
+
+    while (numBytes > 1)
+        buffer.push_back(bytes[--numBytes] | 0x80);
+    buffer.push_back(bytes[0]);
+}
+
+void AppendEvent(std::vector<uint8_t>& buffer, 
+                 uint32_t delta, 
+                 const MidiEvent& event, 
+                 ByteSpan data)
+{
+    AppendVarLen(buffer, delta);
+    buffer.push_back(event.status);
+    if (event.status == midiMeta)
+        buffer.push_back(event.metaType);
+    if (!event.IsChannelEvent())
+        AppendVarLen(buffer, static_cast<uint32_t>(data.size));
+
+    buffer.insert(buffer.end(), data.data, data.data + data.size);
+}
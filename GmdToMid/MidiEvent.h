@@ -0,0 +1,234 @@
+// MidiEvent.h - Declares the MidiEvent struct and the EventCursor class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MIDI_EVENT_H
+#define MIDI_EVENT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ByteSpan.h"
+
+/// @brief The status of a note off channel event (without the channel).
+inline constexpr uint8_t midiNoteOff{ 0x80 };
+
+/// @brief The status of a note on channel event (without the channel).
+inline constexpr uint8_t midiNoteOn{ 0x90 };
+
+/// @brief The status of a polyphonic key pressure channel event.
+inline constexpr uint8_t midiPolyPressure{ 0xA0 };
+
+/// @brief The status of a control change channel event.
+inline constexpr uint8_t midiControlChange{ 0xB0 };
+
+/// @brief The status of a program change channel event.
+inline constexpr uint8_t midiProgramChange{ 0xC0 };
+
+/// @brief The status of a channel pressure channel event.
+inline constexpr uint8_t midiChannelPressure{ 0xD0 };
+
+/// @brief The status of a pitch bend channel event.
+inline constexpr uint8_t midiPitchBend{ 0xE0 };
+
+/// @brief The status of a SysEx event.
+inline constexpr uint8_t midiSysEx{ 0xF0 };
+
+/// @brief The status of a SysEx continuation or escape event.
+inline constexpr uint8_t midiSysExEscape{ 0xF7 };
+
+/// @brief The status of a meta event.
+inline constexpr uint8_t midiMeta{ 0xFF };
+
+/// @brief The meta event type of a text event.
+inline constexpr uint8_t midiMetaText{ 0x01 };
+
+/// @brief The meta event type of a marker.
+inline constexpr uint8_t midiMetaMarker{ 0x06 };
+
+/// @brief The meta event type that ends a track.
+inline constexpr uint8_t midiMetaEndOfTrack{ 0x2F };
+
+/// @brief The meta event type of a tempo change.
+inline constexpr uint8_t midiMetaTempo{ 0x51 };
+
+/// @brief The meta event type of a time signature.
+inline constexpr uint8_t midiMetaTimeSignature{ 0x58 };
+
+/// @brief The meta event type of a key signature.
+inline constexpr uint8_t midiMetaKeySignature{ 0x59 };
+
+/// @brief The tempo a track plays at until its first tempo change, in 
+/// microseconds per quarter note (120 BPM).
+inline constexpr uint32_t midiDefaultTempo{ 500000 };
+
+/// @brief The SysEx manufacturer ID iMuse uses for its own events.
+///
+/// iMuse hooks, markers, and part allocations are all stored as SysEx
+/// events with the non-commercial manufacturer ID.
+inline constexpr uint8_t imuseManufacturerID{ 0x7D };
+
+/// @brief The largest number of bytes in a variable length quantity.
+inline constexpr int midiMaxVarLenSize{ 4 };
+
+/// @brief Represents a single event decoded from a MIDI track.
+///
+/// The event doesn't copy any of its data; the offsets refer to the bytes
+/// of the track it was decoded from.
+struct MidiEvent
+{
+    /// @brief The number of ticks since the previous event.
+    uint32_t delta{ 0 };
+
+    /// @brief The number of ticks since the start of the track.
+    uint32_t tick{ 0 };
+
+    /// @brief The offset of the event (starting with its delta time).
+    uint32_t offset{ 0 };
+
+    /// @brief The status byte, with running status already resolved.
+    uint8_t status{ 0 };
+
+    /// @brief The meta event type, which is only valid for meta events.
+    uint8_t metaType{ 0 };
+
+    /// @brief The offset of the data bytes that follow the status.
+    ///
+    /// For SysEx and meta events, the data follows the length field and
+    /// excludes it. For SysEx events, the data includes the trailing 0xF7.
+    uint32_t dataOffset{ 0 };
+
+    /// @brief The number of data bytes.
+    uint32_t dataLength{ 0 };
+
+    /// @brief Determines if the event is a channel event.
+    /// @return true if the event is a channel event, otherwise false.
+    bool IsChannelEvent() const { return status < midiSysEx; }
+
+    /// @brief Gets the command of a channel event (the status sans channel).
+    /// @return The command nibble of the status.
+    uint8_t Command() const { return status & 0xF0; }
+
+    /// @brief Gets the channel of a channel event.
+    /// @return The zero-based channel number.
+    uint8_t Channel() const { return status & 0x0F; }
+};
+
+/// @brief Decodes the events of a MIDI track one at a time.
+///
+/// The cursor handles variable length delta times and lengths, running
+/// status, meta events, and SysEx events. It stops after the end of track
+/// meta event, so any padding after it is ignored. Meta and SysEx events
+/// don't cancel running status, which matches how the events in real GMD
+/// files are encoded. The data bytes of channel events must be below 0x80,
+/// as only status bytes may have their top bit set.
+class EventCursor
+{
+public:
+    /// @brief Constructor; creates a new cursor at the start of a track.
+    /// @param track The data of the MIDI track chunk, excluding its header.
+    EventCursor(ByteSpan track) : track{ track } { }
+
+    /// @brief Decodes the next event and advances past it.
+    /// @param event The event to decode into.
+    /// @return true if an event was decoded, false at the end of the track
+    /// or if the track is malformed (see HasError()).
+    bool Next(MidiEvent& event);
+
+    /// @brief Moves the cursor to a previously recorded position.
+    /// @param position The offset of the next event to decode.
+    /// @param tick The tick of the event preceding the position.
+    /// @param runningStatus The running status at the position.
+    void Seek(size_t position, uint32_t tick, uint8_t runningStatus);
+
+    /// @brief Gets the offset of the next event to decode.
+    /// @return The offset from the start of the track.
+    size_t Position() const { return position; }
+
+    /// @brief Gets the tick of the last decoded event.
+    /// @return The number of ticks since the start of the track.
+    uint32_t Tick() const { return tick; }
+
+    /// @brief Gets the running status that applies to the next event.
+    /// @return The running status, or 0 if there is none.
+    uint8_t RunningStatus() const { return runningStatus; }
+
+    /// @brief Determines if the end of track meta event has been decoded.
+    /// @return true if the end of track has been reached.
+    bool ReachedEndOfTrack() const { return reachedEndOfTrack; }
+
+    /// @brief Determines if decoding stopped because the track is malformed.
+    /// @return true if there was an error, otherwise false.
+    bool HasError() const { return !error.empty(); }
+
+    /// @brief Gets a description of the error that stopped decoding.
+    /// @return The error message, or an empty string if there was no error.
+    const std::string& Error() const { return error; }
+private:
+    ByteSpan track;
+    size_t position{ 0 };
+    uint32_t tick{ 0 };
+    uint8_t runningStatus{ 0 };
+    bool reachedEndOfTrack{ false };
+    std::string error;
+
+    /// @brief Reads a variable length quantity and advances past it.
+    /// @param value The value to read into.
+    /// @return true if the value was read, otherwise false.
+    bool ReadVarLen(uint32_t& value);
+
+    /// @brief Records an error at the current position.
+    /// @param message A description of the error.
+    /// @return false, so errors can be returned in one statement.
+    bool Fail(const std::string& message);
+};
+
+/// @brief Gets the number of data bytes that follow a channel event status.
+/// @param status The status byte of the channel event.
+/// @return 1 for program change and channel pressure events, otherwise 2.
+inline uint32_t ChannelEventDataLength(uint8_t status)
+{
+    uint8_t command = status & 0xF0;
+    return command == midiProgramChange || command == midiChannelPressure ? 
+           1 : 2;
+}
+
+/// @brief Appends a variable length quantity to a buffer.
+/// @param buffer The buffer to append to.
+/// @param value The value to encode, which must fit in 28 bits.
+void AppendVarLen(std::vector<uint8_t>& buffer, uint32_t value);
+
+/// @brief Appends an event to an encoded track.
+/// @param buffer The encoded track to append to.
+/// @param delta The number of ticks since the previous event in the buffer.
+/// @param event The event to append.
+/// @param data The data bytes of the event.
+///
+/// The event is always written with an explicit status byte, so it doesn't
+/// depend on the running status of whatever precedes it in the buffer.
+void AppendEvent(std::vector<uint8_t>& buffer, 
+                 uint32_t delta, 
+                 const MidiEvent& event, 
+                 ByteSpan data);
+
+/// @brief Determines if SysEx data is specific to iMuse.
+/// @param data The data of the SysEx event.
+/// @return true if the data starts with the iMuse manufacturer ID.
+inline bool IsImuseSysEx(ByteSpan data)
+{
+    return data.size > 0 && data.data[0] == imuseManufacturerID;
+}
+
+#endif
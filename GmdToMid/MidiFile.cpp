@@ -14,14 +14,15 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <cstring>
 #include "MidiFile.h"
 
-MidiFile::MidiFile(std::string fileName, BinData::UInt16Field division) :
-    stream{ fileName }
+MidiFile::MidiFile(OutputSink& sink, 
+                   std::string fileName, 
+                   BinData::UInt16Field division) :
+    sink{ sink },
+    fileName{ fileName }
 {
-    header.id.SetData(midiHeaderID);
-    header.size.SetValue(midiHeaderDataSize);
-
     // We're creating a type 0 MIDI file. GMD files are type 2, but we export
     // each MIDI track from the GMD as a single type 0 track.
     headerData.format.SetValue(midiType0ID);
@@ -33,32 +34,91 @@ MidiFile::MidiFile(std::string fileName, BinData::UInt16Field division) :
     headerData.division.SetValue(division.Value());
 }
 
-void MidiFile::WriteChunkHeader(ChunkHeader header)
+MidiFile::MidiFile(OutputSink& sink,
+                   std::string fileName, 
+                   int format, 
+                   BinData::UInt16Field division) :
+    MidiFile{ sink, fileName, division }
+{
+    headerData.format.SetValue(format);
+}
+
+void MidiFile::AddTrack(ByteSpan trackData, ByteSpan prelude)
+{
+    tracks.push_back(Track{ trackData, prelude });
+}
+
+bool MidiFile::Write()
 {
-    if (!stream.IsOpen())
-        stream.Open(BinData::FileMode::Write);
+    if (tracks.size() > midiMaxTracks)
+        return false;
 
-    stream.Write(&header.id);
-    stream.Write(&header.size);
+    // Every header goes into one buffer and the sink receives the tracks
+    // straight from their spans, so the track data is never copied on its
+    // way to disk. Each thread keeps its buffers from file to file.
+    thread_local std::vector<uint8_t> headers;
+    thread_local std::vector<ByteSpan> pieces;
+    headers.resize(chunkHeaderSize + midiHeaderDataSize + 
+                   chunkHeaderSize * tracks.size());
+    pieces.clear();
+
+    uint8_t* position = headers.data();
+    EncodeFileHeader(tracks.size(), position);
+    pieces.push_back(ByteSpan{ position, chunkHeaderSize + 
+                                         midiHeaderDataSize });
+    position += chunkHeaderSize + midiHeaderDataSize;
+
+    size_t fileSize = chunkHeaderSize + midiHeaderDataSize;
+    for (const Track& track : tracks)
+    {
+        EncodeTrackHeader(track.prelude.size + track.data.size, position);
+        pieces.push_back(ByteSpan{ position, chunkHeaderSize });
+        pieces.push_back(track.prelude);
+        pieces.push_back(track.data);
+        position += chunkHeaderSize;
+        fileSize += chunkHeaderSize + track.prelude.size + track.data.size;
+    }
+
+    if (!sink.Write(fileName, pieces))
+        return false;
+
+    bytesWritten += fileSize;
+    return true;
 }
 
-void MidiFile::WriteMidiHeaderData(MidiHeaderData data)
+bool MidiFile::WriteTrack(ByteSpan trackData, ByteSpan prelude)
 {
-    stream.Write(&data.format);
-    stream.Write(&data.numTracks);
-    stream.Write(&data.division);
+    // Everything ahead of the track data is encoded into one small block so
+    // the sink receives the whole file as just three pieces, which a
+    // FileSink writes with a single system call.
+    uint8_t headers[chunkHeaderSize * 2 + midiHeaderDataSize];
+    EncodeFileHeader(headerData.numTracks.Value(), headers);
+    EncodeTrackHeader(prelude.size + trackData.size, 
+                      headers + chunkHeaderSize + midiHeaderDataSize);
+
+    // The list of pieces is kept from file to file, so a run of thousands
+    // of tiny tracks allocates nothing here.
+    ByteSpan headersSpan{ headers, sizeof(headers) };
+    thread_local std::vector<ByteSpan> pieces;
+    pieces.assign({ headersSpan, prelude, trackData });
+    if (!sink.Write(fileName, pieces))
+        return false;
+
+    bytesWritten += headersSpan.size + prelude.size + trackData.size;
+    return true;
 }
 
-void MidiFile::WriteData(BinData::RawField* data)
+void MidiFile::EncodeFileHeader(size_t numTracks, uint8_t* bytes) const
 {
-    stream.Write(data);
+    std::memcpy(bytes, midiHeaderID, 4);
+    WriteUInt32BE(bytes + 4, midiHeaderDataSize);
+    WriteUInt16BE(bytes + 8, headerData.format.Value());
+    WriteUInt16BE(bytes + 10, static_cast<uint16_t>(numTracks));
+    WriteUInt16BE(bytes + 12, headerData.division.Value());
 }
 
-void MidiFile::WriteTrack(ChunkHeader trackHeader, 
-                          BinData::RawField* trackData)
+void MidiFile::EncodeTrackHeader(size_t size, uint8_t* bytes)
 {
-    WriteChunkHeader(header);
-    WriteMidiHeaderData(headerData);
-    WriteChunkHeader(trackHeader);
-    WriteData(trackData);
-}
\ No newline at end of file
+    std::memcpy(bytes, midiTrackID, 4);
+    WriteUInt32BE(bytes + 4, static_cast<uint32_t>(size));
+}
@@ -18,9 +18,12 @@
 #define MIDI_FILE_H
 
 #include <string>
+#include <vector>
 #include "BinData.h"
+#include "ByteSpan.h"
 #include "ChunkHeader.h"
 #include "MidiHeaderData.h"
+#include "OutputSink.h"
 
 /// @brief The chunk ID used to indicate the beginning of a MIDI header.
 inline const char* midiHeaderID{ "MThd" };
@@ -31,44 +34,102 @@ inline const char* midiTrackID{ "MTrk" };
 /// @brief The integer value representing MIDI type 0.
 inline constexpr int midiType0ID{ 0 };
 
+/// @brief The integer value representing MIDI type 1.
+inline constexpr int midiType1ID{ 1 };
+
+/// @brief The integer value representing MIDI type 2.
+inline constexpr int midiType2ID{ 2 };
+
 /// @brief The number of tracks a type 0 MIDI file should contain.
 inline constexpr int midiType0TrackNum{ 1 };
 
+/// @brief The largest number of tracks a MIDI header can describe.
+inline constexpr size_t midiMaxTracks{ 0xFFFF };
+
 /// @brief Represents a MIDI (.mid) file.
 ///
 /// This class supports writing an individual type 0 MIDI track encapsulated
-/// within an entire type 0 MIDI file.
+/// within an entire type 0 MIDI file, or any number of tracks within a
+/// single type 1 or type 2 MIDI file. The finished file is handed to an
+/// OutputSink, which decides whether it is written to disk or kept in memory.
 class MidiFile
 {
 public:
     /// @brief Constructor; creates a new MidiFile instance of type 0.
+    /// @param sink The sink to write the file to.
     /// @param fileName The file name of the .mid file. 
     /// @param division The division value the type 0 MIDI track should use.
-    MidiFile(std::string fileName, BinData::UInt16Field division); 
+    MidiFile(OutputSink& sink, 
+             std::string fileName, 
+             BinData::UInt16Field division); 
+
+    /// @brief Constructor; creates a new MidiFile instance of any type.
+    /// @param sink The sink to write the file to.
+    /// @param fileName The file name of the .mid file.
+    /// @param format The MIDI type of the file (0, 1, or 2).
+    /// @param division The division value the MIDI tracks should use.
+    MidiFile(OutputSink& sink,
+             std::string fileName, 
+             int format, 
+             BinData::UInt16Field division);
+
+    /// @brief Adds a track to be written by Write().
+    /// @param trackData The track data, excluding the chunk header.
+    /// @param prelude Events to write at the start of the track, if any.
+    ///
+    /// Only the spans are stored, so the bytes they refer to must remain
+    /// valid until the file has been written.
+    void AddTrack(ByteSpan trackData, ByteSpan prelude = ByteSpan{});
 
-    /// @brief Writes the specified track header and data as a new MIDI file.
-    /// @param trackHeader The header of the track to write.
-    /// @param trackData The track data to write.
-    void WriteTrack(ChunkHeader trackHeader, 
-                    BinData::RawField* trackData);
+    /// @brief Gets the number of tracks added with AddTrack().
+    /// @return The number of tracks.
+    size_t NumTracks() const { return tracks.size(); }
+
+    /// @brief Writes every track added with AddTrack() as a new MIDI file.
+    /// @return true if the file was successfully written, otherwise false.
+    ///
+    /// The headers of every chunk are encoded into one buffer, kept from 
+    /// file to file, and handed to the sink along with the track data as
+    /// the pieces of one file, so a file with many small tracks costs one
+    /// vectored write, not one per chunk.
+    bool Write();
+
+    /// @brief Gets the number of bytes written to the file so far.
+    /// @return The number of bytes written.
+    size_t BytesWritten() const { return bytesWritten; }
+
+    /// @brief Writes the specified track data as a new MIDI file.
+    /// @param trackData The track data to write, excluding the chunk header.
+    /// @param prelude Events to write at the start of the track, if any.
+    /// @return true if the file was successfully written, otherwise false.
+    ///
+    /// The track data is handed to the sink straight from the span, so when
+    /// the span refers to a MappedFile and the sink writes to disk the bytes
+    /// are never copied into a buffer.
+    bool WriteTrack(ByteSpan trackData, ByteSpan prelude = ByteSpan{});
 private:
-    BinData::StdFileStream stream;
-    ChunkHeader header;
-    MidiHeaderData headerData;
+    struct Track
+    {
+        ByteSpan data;
+        ByteSpan prelude;
+    };
 
-    /// @brief Writes the specified chunk header to the file.
-    /// @param header The header to write at the current position.
-    /// @pre The file is open.
-    void WriteChunkHeader(ChunkHeader header);
+    OutputSink& sink;
+    std::string fileName;
+    MidiHeaderData headerData;
+    std::vector<Track> tracks;
+    size_t bytesWritten{ 0 };
 
-    /// @brief Writes the specified MidiHeaderData to the file.
-    /// @param data The data to write to the file.
-    /// @pre The file is open.
-    void WriteMidiHeaderData(MidiHeaderData data);
+    /// @brief Encodes the MThd chunk, header and data, that starts the file.
+    /// @param numTracks The number of tracks in the file.
+    /// @param bytes The chunkHeaderSize + midiHeaderDataSize bytes to encode
+    /// the chunk into.
+    void EncodeFileHeader(size_t numTracks, uint8_t* bytes) const;
 
-    /// @brief Writes the specified data to the file.
-    /// @param data The data to write to the file.
-    void WriteData(BinData::RawField* data);
+    /// @brief Encodes the header of an MTrk chunk.
+    /// @param size The size of the track data.
+    /// @param bytes The chunkHeaderSize bytes to encode the header into.
+    static void EncodeTrackHeader(size_t size, uint8_t* bytes);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,304 @@
+// MidiState.cpp - Defines the MidiState class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstring>
+#include "MidiState.h"
+
+/// @brief Controller numbers with special meaning to MidiState.
+enum MidiController : uint8_t
+{
+    ccBankSelectMsb = 0,
+    ccModulation = 1,
+    ccDataEntryMsb = 6,
+    ccExpression = 11,
+    ccBankSelectLsb = 32,
+    ccDataEntryLsb = 38,
+    ccFirstPedal = 64,
+    ccLastPedal = 69,
+    ccDataIncrement = 96,
+    ccNrpnLsb = 98,
+    ccNrpnMsb = 99,
+    ccRpnLsb = 100,
+    ccRpnMsb = 101,
+    ccResetAllControllers = 121,
+    ccFirstChannelMode = 120
+};
+
+void MidiState::Reset()
+{
+    for (ChannelState& channel : channels)
+    {
+        std::fill(std::begin(channel.controllers), 
+                  std::end(channel.controllers), unset);
+        for (auto& rpn : channel.rpnData)
+            rpn[0] = rpn[1] = unset;
+        channel.program = unset;
+        channel.bankMsb = unset;
+        channel.bankLsb = unset;
+        channel.channelPressure = unset;
+        channel.pitchBend = unset;
+        channel.rpnMsb = rpnNull;
+        channel.rpnLsb = rpnNull;
+    }
+
+    hasTempo = false;
+    hasTimeSignature = false;
+    hasKeySignature = false;
+}
+
+void MidiState::Apply(const MidiEvent& event, ByteSpan data)
+{
+    if (event.IsChannelEvent())
+    {
+        ChannelState& channel = channels[event.Channel()];
+        switch (event.Command())
+        {
+            case midiControlChange:
+                ApplyControlChange(channel, data.data[0], data.data[1]);
+                break;
+            case midiProgramChange:
+                channel.program = data.data[0];
+                break;
+            case midiChannelPressure:
+                channel.channelPressure = data.data[0];
+                break;
+            case midiPitchBend:
+                channel.pitchBend = data.data[0] | (data.data[1] << 7);
+                break;
+            default:
+                break;
+        }
+    }
+    else if (event.status == midiMeta)
+    {
+        if (event.metaType == midiMetaTempo && data.size >= sizeof(tempo))
+        {
+            std::memcpy(tempo, data.data, sizeof(tempo));
+            hasTempo = true;
+        }
+        else if (event.metaType == midiMetaTimeSignature && 
+                 data.size >= sizeof(timeSignature))
+        {
+            std::memcpy(timeSignature, data.data, sizeof(timeSignature));
+            hasTimeSignature = true;
+        }
+        else if (event.metaType == midiMetaKeySignature &&
+                 data.size >= sizeof(keySignature))
+        {
+            std::memcpy(keySignature, data.data, sizeof(keySignature));
+            hasKeySignature = true;
+        }
+    }
+}
+
+void MidiState::Apply(const EventStore& events)
+{
+    for (size_t i = 0; i < events.Size(); i++)
+        Apply(events.Event(i), events.Data(i));
+}
+
+void MidiState::ApplySetup(const EventStore& events)
+{
+    // The events are scanned once to find where each channel starts to 
+    // play, and again to apply everything before that.
+    size_t none = events.Size();
+    size_t firstNotes[midiNumChannels];
+    std::fill(std::begin(firstNotes), std::end(firstNotes), none);
+    size_t setupEnd{ none };
+    for (size_t i = 0; i < events.Size(); i++)
+    {
+        uint8_t status = events.Status(i);
+        ByteSpan data = events.Data(i);
+        if ((status & 0xF0) != midiNoteOn || data.size < 2 || data.data[1] == 0)
+            continue;
+
+        size_t& firstNote = firstNotes[status & 0x0F];
+        firstNote = std::min(firstNote, i);
+        setupEnd = std::min(setupEnd, i);
+    }
+
+    if (setupEnd == none)
+    {
+        setupEnd = 0;
+        while (setupEnd < events.Size() && 
+               events.Tick(setupEnd) == events.Tick(0))
+        {
+            setupEnd++;
+        }
+    }
+
+    for (size_t i = 0; i < events.Size(); i++)
+    {
+        MidiEvent event = events.Event(i);
+        size_t end = setupEnd;
+        if (event.IsChannelEvent() && firstNotes[event.Channel()] != none)
+            end = firstNotes[event.Channel()];
+        if (i < end)
+            Apply(event, events.Data(i));
+    }
+}
+
+void MidiState::AppendPrelude(std::vector<uint8_t>& track) const
+{
+    auto appendEvent = [&track](std::initializer_list<uint8_t> bytes)
+    {
+        track.push_back(0);
+        track.insert(track.end(), bytes);
+    };
+
+    if (hasTempo)
+        appendEvent({ midiMeta, midiMetaTempo, 3, 
+                      tempo[0], tempo[1], tempo[2] });
+    if (hasTimeSignature)
+        appendEvent({ midiMeta, midiMetaTimeSignature, 4, 
+                      timeSignature[0], timeSignature[1], 
+                      timeSignature[2], timeSignature[3] });
+    if (hasKeySignature)
+        appendEvent({ midiMeta, midiMetaKeySignature, 2, 
+                      keySignature[0], keySignature[1] });
+
+    for (int i = 0; i < midiNumChannels; i++)
+    {
+        const ChannelState& channel = channels[i];
+        auto cc = static_cast<uint8_t>(midiControlChange | i);
+
+        // The bank select has to come before the program change, since the
+        // bank only takes effect when the next program change is received.
+        if (channel.bankMsb != unset)
+            appendEvent({ cc, ccBankSelectMsb, 
+                          static_cast<uint8_t>(channel.bankMsb) });
+        if (channel.bankLsb != unset)
+            appendEvent({ cc, ccBankSelectLsb, 
+                          static_cast<uint8_t>(channel.bankLsb) });
+        if (channel.program != unset)
+            appendEvent({ static_cast<uint8_t>(midiProgramChange | i),
+                          static_cast<uint8_t>(channel.program) });
+
+        for (int controller = 0; controller < midiNumControllers; controller++)
+        {
+            if (channel.controllers[controller] != unset)
+            {
+                appendEvent({ cc, static_cast<uint8_t>(controller), 
+                              static_cast<uint8_t>(
+                                  channel.controllers[controller]) });
+            }
+        }
+
+        bool selectedRpn{ false };
+        for (int rpn = 0; rpn < midiNumTrackedRpns; rpn++)
+        {
+            const int16_t* value = channel.rpnData[rpn];
+            if (value[0] == unset && value[1] == unset)
+                continue;
+
+            appendEvent({ cc, ccRpnMsb, 0 });
+            appendEvent({ cc, ccRpnLsb, static_cast<uint8_t>(rpn) });
+            if (value[0] != unset)
+                appendEvent({ cc, ccDataEntryMsb, 
+                              static_cast<uint8_t>(value[0]) });
+            if (value[1] != unset)
+                appendEvent({ cc, ccDataEntryLsb, 
+                              static_cast<uint8_t>(value[1]) });
+            selectedRpn = true;
+        }
+
+        // Deselect the RPN so stray data entry in the track that follows
+        // can't accidentally change the parameters we just restored.
+        if (selectedRpn)
+        {
+            appendEvent({ cc, ccRpnMsb, rpnNull });
+            appendEvent({ cc, ccRpnLsb, rpnNull });
+        }
+
+        if (channel.pitchBend != unset)
+            appendEvent({ static_cast<uint8_t>(midiPitchBend | i),
+                          static_cast<uint8_t>(channel.pitchBend & 0x7F),
+                          static_cast<uint8_t>(channel.pitchBend >> 7) });
+        if (channel.channelPressure != unset)
+            appendEvent({ static_cast<uint8_t>(midiChannelPressure | i),
+                          static_cast<uint8_t>(channel.channelPressure) });
+    }
+}
+
+bool MidiState::IsEmpty() const
+{
+    std::vector<uint8_t> prelude;
+    AppendPrelude(prelude);
+    return prelude.empty();
+}
+
+void MidiState::ApplyControlChange(ChannelState& channel, 
+                                   uint8_t controller, 
+                                   uint8_t value)
+{
+    switch (controller)
+    {
+        case ccBankSelectMsb:
+            channel.bankMsb = value;
+            break;
+        case ccBankSelectLsb:
+            channel.bankLsb = value;
+            break;
+        case ccRpnMsb:
+            channel.rpnMsb = value;
+            break;
+        case ccRpnLsb:
+            channel.rpnLsb = value;
+            break;
+        case ccNrpnMsb:
+        case ccNrpnLsb:
+            // Data entry now targets an NRPN, which we don't track.
+            channel.rpnMsb = rpnNull;
+            channel.rpnLsb = rpnNull;
+            break;
+        case ccDataEntryMsb:
+        case ccDataEntryLsb:
+            if (channel.rpnMsb == 0 && channel.rpnLsb < midiNumTrackedRpns)
+            {
+                int part = controller == ccDataEntryMsb ? 0 : 1;
+                channel.rpnData[channel.rpnLsb][part] = value;
+            }
+            break;
+        case ccResetAllControllers:
+            // Reset all controllers puts these back to their power on
+            // defaults, which is the same as never having set them.
+            channel.controllers[ccModulation] = unset;
+            channel.controllers[ccExpression] = unset;
+            channel.pitchBend = unset;
+            channel.channelPressure = unset;
+            channel.rpnMsb = rpnNull;
+            channel.rpnLsb = rpnNull;
+            break;
+        default:
+            if (IsSetupController(controller))
+                channel.controllers[controller] = value;
+            break;
+    }
+}
+
+bool IsSetupController(uint8_t controller)
+{
+    if (controller >= ccFirstChannelMode)
+        return false;
+    if (controller >= ccFirstPedal && controller <= ccLastPedal)
+        return false;
+    if (controller >= ccDataIncrement && controller <= ccRpnMsb)
+        return false;
+
+    return controller != ccBankSelectMsb && controller != ccBankSelectLsb &&
+           controller != ccDataEntryMsb && controller != ccDataEntryLsb;
+}
@@ -0,0 +1,134 @@
+// MidiState.h - Declares the MidiState class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MIDI_STATE_H
+#define MIDI_STATE_H
+
+#include <cstdint>
+#include <vector>
+#include "ByteSpan.h"
+#include "EventStore.h"
+#include "MidiEvent.h"
+
+/// @brief The number of MIDI channels.
+inline constexpr int midiNumChannels{ 16 };
+
+/// @brief The number of MIDI controllers.
+inline constexpr int midiNumControllers{ 128 };
+
+/// @brief The number of registered parameters (RPNs) that are tracked.
+///
+/// RPN 0 is the pitch bend range, RPN 1 is fine tuning, and RPN 2 is
+/// coarse tuning, which covers every RPN general MIDI defines.
+inline constexpr int midiNumTrackedRpns{ 3 };
+
+/// @brief Represents the state a synthesizer is left in by a MIDI stream.
+///
+/// The state is accumulated by applying events in order, which makes it a
+/// single forward scan no matter how many times the state is used. It can
+/// then be turned into a prelude: a series of events at tick 0 that put a
+/// synthesizer back into the same state. That is how transition tracks get
+/// the setup they depend on from the main track of a GMD.
+///
+/// Only state a general MIDI synthesizer holds on to is tracked: the
+/// program and bank, controllers, the registered parameters, pitch bend,
+/// channel pressure, tempo, and the time and key signatures. Notes and
+/// pedals (controllers 64 to 69) are left out because they describe what
+/// is being played, not how the synthesizer is set up.
+class MidiState
+{
+public:
+    /// @brief Constructor; creates a new MidiState with nothing set.
+    MidiState() { Reset(); }
+
+    /// @brief Clears the state back to nothing set.
+    void Reset();
+
+    /// @brief Updates the state with the specified event.
+    /// @param event The event to apply.
+    /// @param data The data bytes of the event.
+    void Apply(const MidiEvent& event, ByteSpan data);
+
+    /// @brief Updates the state with every event in the store, in order.
+    /// @param events The events to apply.
+    void Apply(const EventStore& events);
+
+    /// @brief Updates the state with only the events in the store that set
+    /// up the synthesizer before the music starts.
+    /// @param events The events to apply.
+    ///
+    /// The events of each channel count as setup until the channel plays its
+    /// first note, so a channel that only comes in later still gets the
+    /// setup it is given then, but a fade out or a program change in the
+    /// middle of the music is left out. Tempo, the signatures, and channels
+    /// that never play a note only count until the first note of the track,
+    /// or, if there are no notes, at the first tick.
+    void ApplySetup(const EventStore& events);
+
+    /// @brief Appends events that restore the state to the specified track.
+    /// @param track The encoded track data to append the events to.
+    ///
+    /// Every event has a delta time of 0 and an explicit status byte, so
+    /// the prelude can be placed in front of any track without affecting
+    /// the running status or timing of the events that follow it.
+    void AppendPrelude(std::vector<uint8_t>& track) const;
+
+    /// @brief Determines if any state has been set.
+    /// @return true if at least one event changed the state.
+    bool IsEmpty() const;
+private:
+    /// @brief Indicates a value that has not been set by any event.
+    static constexpr int16_t unset{ -1 };
+
+    /// @brief The value of an RPN selector meaning "no parameter".
+    static constexpr uint8_t rpnNull{ 127 };
+
+    struct ChannelState
+    {
+        int16_t controllers[midiNumControllers];
+        int16_t rpnData[midiNumTrackedRpns][2];
+        int16_t program;
+        int16_t bankMsb;
+        int16_t bankLsb;
+        int16_t channelPressure;
+        int32_t pitchBend;
+        uint8_t rpnMsb;
+        uint8_t rpnLsb;
+    };
+
+    ChannelState channels[midiNumChannels];
+    uint8_t tempo[3];
+    uint8_t timeSignature[4];
+    uint8_t keySignature[2];
+    bool hasTempo;
+    bool hasTimeSignature;
+    bool hasKeySignature;
+
+    /// @brief Updates the state of a channel with a control change.
+    /// @param channel The channel state to update.
+    /// @param controller The controller number.
+    /// @param value The controller value.
+    void ApplyControlChange(ChannelState& channel, 
+                            uint8_t controller, 
+                            uint8_t value);
+};
+
+/// @brief Determines if a controller is restored by a MidiState prelude.
+/// @param controller The controller number.
+/// @return true if the controller holds synthesizer setup state.
+bool IsSetupController(uint8_t controller);
+
+#endif
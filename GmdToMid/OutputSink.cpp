@@ -0,0 +1,179 @@
+// OutputSink.cpp - Defines the FileSink and MemorySink classes.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include "FileWriter.h"
+#include "MappedFile.h"
+#include "OutputSink.h"
+
+bool OutputSink::Link(const std::string& name, 
+                      const std::filesystem::path& source)
+{
+    MappedFile file{ source.string() };
+    if (!file.Open())
+        return false;
+
+    return Write(name, { file.Data() });
+}
+
+bool FileSink::Write(const std::string& name, 
+                     const std::vector<ByteSpan>& pieces)
+{
+    // An existing file may be a hard link to a file we restored from a
+    // cache, so it is replaced rather than overwritten in place, which would
+    // change the cached file as well. Renaming over it has the same effect.
+    if (!atomic)
+        return WriteFilePieces(PathOf(name), pieces.data(), pieces.size());
+
+    std::filesystem::path tempPath = TempPathOf(name);
+    return Commit(tempPath, name, WriteFilePieces(tempPath.string(), 
+                                                  pieces.data(), 
+                                                  pieces.size()));
+}
+
+bool FileSink::Link(const std::string& name, 
+                    const std::filesystem::path& source)
+{
+    std::filesystem::path path = atomic ? TempPathOf(name) : 
+                                          std::filesystem::path{ PathOf(name) };
+    std::error_code error;
+    if (!atomic)
+        std::filesystem::remove(path, error);
+
+    std::filesystem::create_hard_link(source, path, error);
+    bool linked = !error || std::filesystem::copy_file(
+        source, path, std::filesystem::copy_options::overwrite_existing, error);
+
+    if (atomic)
+        return Commit(path, name, linked);
+
+    return linked;
+}
+
+std::filesystem::path FileSink::TempPathOf(const std::string& name) const
+{
+    // Other processes may be writing to the same directory, so the counter
+    // starts from the clock rather than from zero.
+    static std::atomic<uint64_t> nextTempNum{ static_cast<uint64_t>(
+        std::chrono::steady_clock::now().time_since_epoch().count()) };
+    return directory / ("." + name + "." + std::to_string(nextTempNum++) + 
+                        ".tmp");
+}
+
+bool FileSink::Commit(const std::filesystem::path& tempPath, 
+                      const std::string& name,
+                      bool completed) const
+{
+    std::error_code error;
+    if (completed)
+    {
+        std::filesystem::rename(tempPath, PathOf(name), error);
+        if (!error)
+            return true;
+    }
+
+    std::filesystem::remove(tempPath, error);
+    return false;
+}
+
+std::string FileSink::PathOf(const std::string& name) const
+{
+    return (directory / name).string();
+}
+
+bool MemorySink::Write(const std::string& name, 
+                       const std::vector<ByteSpan>& pieces)
+{
+    size_t size{ 0 };
+    for (const ByteSpan& piece : pieces)
+        size += piece.size;
+
+    Output output;
+    output.name = name;
+    output.data.resize(size);
+
+    uint8_t* position = output.data.data();
+    for (const ByteSpan& piece : pieces)
+    {
+        if (piece.size > 0)
+            std::memcpy(position, piece.data, piece.size);
+        position += piece.size;
+    }
+
+    std::lock_guard<std::mutex> lock{ mutex };
+    outputs.push_back(std::move(output));
+    return true;
+}
+
+bool MemorySink::WriteBuffer(const std::string& name, 
+                             std::vector<uint8_t>&& buffer)
+{
+    // The buffer was assembled just for us, so we take it rather than
+    // copying it.
+    std::lock_guard<std::mutex> lock{ mutex };
+    outputs.push_back(Output{ name, std::move(buffer) });
+    return true;
+}
+
+std::vector<MemorySink::Output> MemorySink::TakeOutputs()
+{
+    std::lock_guard<std::mutex> lock{ mutex };
+    std::vector<Output> taken = std::move(outputs);
+    outputs.clear();
+    return taken;
+}
+
+bool StreamSink::Write(const std::string& name, 
+                       const std::vector<ByteSpan>& pieces)
+{
+    size_t size{ 0 };
+    for (const ByteSpan& piece : pieces)
+        size += piece.size;
+
+    std::lock_guard<std::mutex> lock{ mutex };
+    if (!framed && numFilesWritten > 0)
+        return false;
+
+    if (framed)
+    {
+        uint8_t nameLength[4];
+        uint8_t fileSize[4];
+        WriteUInt32BE(nameLength, static_cast<uint32_t>(name.size()));
+        WriteUInt32BE(fileSize, static_cast<uint32_t>(size));
+        stream.write(reinterpret_cast<const char*>(nameLength), 4);
+        stream.write(name.data(), static_cast<std::streamsize>(name.size()));
+        stream.write(reinterpret_cast<const char*>(fileSize), 4);
+    }
+
+    for (const ByteSpan& piece : pieces)
+    {
+        stream.write(reinterpret_cast<const char*>(piece.data), 
+                     static_cast<std::streamsize>(piece.size));
+    }
+
+    // Whatever is reading the other end of a pipe can start on each file as
+    // soon as it is complete.
+    stream.flush();
+    numFilesWritten++;
+    return !stream.fail();
+}
+
+std::string StreamSink::PathOf(const std::string& name) const
+{
+    return name + " (to stream)";
+}
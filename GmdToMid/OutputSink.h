@@ -0,0 +1,199 @@
+// OutputSink.h - Declares the OutputSink, FileSink, and MemorySink classes.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef OUTPUT_SINK_H
+#define OUTPUT_SINK_H
+
+#include <filesystem>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "ByteSpan.h"
+
+/// @brief Receives the files produced by a conversion.
+///
+/// GmdFile and MidiFile only ever hand complete files to a sink, so where
+/// the files end up, whether on disk or in memory, is entirely up to the
+/// sink. Sinks may be written to from several threads at once.
+class OutputSink
+{
+public:
+    virtual ~OutputSink() = default;
+
+    /// @brief Writes a complete file made up of the specified pieces.
+    /// @param name The name of the file, e.g. "song-0.mid".
+    /// @param pieces The pieces of the file, in order.
+    /// @return true if the file was written, otherwise false.
+    ///
+    /// The pieces are only borrowed for the duration of the call, which lets
+    /// a file be written straight from the memory of the .gmd file.
+    virtual bool Write(const std::string& name, 
+                       const std::vector<ByteSpan>& pieces) = 0;
+
+    /// @brief Writes a complete file that has already been assembled.
+    /// @param name The name of the file, e.g. "song.mid".
+    /// @param buffer The bytes of the file, which the sink may take.
+    /// @return true if the file was written, otherwise false.
+    virtual bool WriteBuffer(const std::string& name, 
+                             std::vector<uint8_t>&& buffer)
+    {
+        return Write(name, { ByteSpan{ buffer.data(), buffer.size() } });
+    }
+
+    /// @brief Writes a file that already exists on disk under a new name.
+    /// @param name The name of the file, e.g. "song-0.mid".
+    /// @param source The path of the existing file.
+    /// @return true if the file was written, otherwise false.
+    ///
+    /// By default the existing file is read and written like any other, but
+    /// sinks that write to disk can link or copy the file instead.
+    virtual bool Link(const std::string& name, 
+                      const std::filesystem::path& source);
+
+    /// @brief Promises that the specified bytes stay valid until Flush() 
+    /// returns, so pieces within them needn't be copied.
+    /// @param bytes The bytes.
+    ///
+    /// Sinks that finish each file before Write returns have no use for
+    /// this, but sinks that write in the background can then keep a piece
+    /// rather than copying it.
+    virtual void Pin(ByteSpan bytes) { }
+
+    /// @brief Waits for every file written so far to reach its destination.
+    /// @return The names of the files that couldn't be written.
+    ///
+    /// Most sinks finish each file before Write returns, so there is nothing
+    /// to wait for, but sinks that write in the background only discover
+    /// some errors here.
+    virtual std::vector<std::string> Flush() { return {}; }
+
+    /// @brief Describes where a file with the specified name is written.
+    /// @param name The name of the file.
+    /// @return A description of the destination, used in messages.
+    virtual std::string PathOf(const std::string& name) const { return name; }
+};
+
+/// @brief Writes files to a directory on disk.
+///
+/// When atomic, each file is written under a temporary name in the same
+/// directory, starting with a dot and ending with .tmp, and renamed into
+/// place once it is complete. Anything watching the directory then only
+/// ever sees complete files, and an existing file is replaced in one step.
+class FileSink : public OutputSink
+{
+public:
+    /// @brief Constructor; creates a new FileSink.
+    /// @param directory The directory to write to, or empty for the current 
+    /// directory.
+    /// @param atomic Determines if files are renamed into place once they
+    /// have been written.
+    FileSink(std::filesystem::path directory = {}, bool atomic = false) : 
+        directory{ directory }, atomic{ atomic }
+    { }
+
+    bool Write(const std::string& name, 
+               const std::vector<ByteSpan>& pieces) override;
+
+    /// @brief Hard links the existing file into the directory, or copies it
+    /// if it can't be linked, e.g. because it is on another file system.
+    bool Link(const std::string& name, 
+              const std::filesystem::path& source) override;
+
+    std::string PathOf(const std::string& name) const override;
+private:
+    std::filesystem::path directory;
+    bool atomic;
+
+    /// @brief Gets a unique temporary path to write a file to before it is
+    /// renamed into place.
+    /// @param name The name of the file.
+    /// @return The temporary path, in the same directory as the file.
+    std::filesystem::path TempPathOf(const std::string& name) const;
+
+    /// @brief Renames a temporary file into place, or removes it if it 
+    /// couldn't be completed.
+    /// @param tempPath The temporary path the file was written to.
+    /// @param name The name of the file.
+    /// @param completed Determines if the file was completely written.
+    /// @return true if the file was renamed into place, otherwise false.
+    bool Commit(const std::filesystem::path& tempPath, 
+                const std::string& name,
+                bool completed) const;
+};
+
+/// @brief Collects files in memory instead of writing them to disk.
+class MemorySink : public OutputSink
+{
+public:
+    /// @brief Represents a file collected by the sink.
+    struct Output
+    {
+        /// @brief The suggested name of the file.
+        std::string name;
+
+        /// @brief The bytes of the file.
+        std::vector<uint8_t> data;
+    };
+
+    bool Write(const std::string& name, 
+               const std::vector<ByteSpan>& pieces) override;
+
+    bool WriteBuffer(const std::string& name, 
+                     std::vector<uint8_t>&& buffer) override;
+
+    /// @brief Takes every file collected so far, leaving the sink empty.
+    /// @return The files, in the order they were written.
+    std::vector<Output> TakeOutputs();
+private:
+    std::mutex mutex;
+    std::vector<Output> outputs;
+};
+
+/// @brief Writes files one after another to an output stream.
+///
+/// When framed, each file is preceded by its name and size so that several
+/// files can share one stream:
+///
+///     uint32 BE   length of the name in bytes
+///     bytes       the name, e.g. "song-0.mid"
+///     uint32 BE   size of the file in bytes
+///     bytes       the file
+///
+/// Unframed, the stream holds the bytes of a single file and nothing else,
+/// so only one file may be written.
+class StreamSink : public OutputSink
+{
+public:
+    /// @brief Constructor; creates a new StreamSink.
+    /// @param stream The stream to write to, which must be binary.
+    /// @param framed Determines if each file is preceded by its name and size.
+    StreamSink(std::ostream& stream, bool framed) : 
+        stream{ stream }, framed{ framed }
+    { }
+
+    bool Write(const std::string& name, 
+               const std::vector<ByteSpan>& pieces) override;
+
+    std::string PathOf(const std::string& name) const override;
+private:
+    std::mutex mutex;
+    std::ostream& stream;
+    bool framed;
+    size_t numFilesWritten{ 0 };
+};
+
+#endif
@@ -14,8 +14,25 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include "Json.h"
 #include "Program.h"
 
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
 Program::Program(std::vector<std::string> args)
 {
     CmdLine::ProgParam::Definition progDef;
@@ -25,30 +42,348 @@ Program::Program(std::vector<std::string> args)
     
     CmdLine::PosParam::Definition inputFileDef;
     inputFileDef.name = "gmd";
-    inputFileDef.description = "The .GMD file to convert";
-    inputFileDef.isMandatory = true;
+    inputFileDef.description = "The .GMD file, directory, or glob to convert";
     inputFileParam = std::make_unique<CmdLine::PosParam>(inputFileDef);
 
+    CmdLine::ValueParam::Definition inputListDef;
+    inputListDef.name = "input-list";
+    inputListDef.shortName = 'i';
+    inputListDef.description = "A file listing .GMD files, directories, "
+                               "or globs to convert, one per line";
+    inputListParam = std::make_unique<CmdLine::ValueParam>(inputListDef);
+
+    CmdLine::ValueParam::Definition outputDirDef;
+    outputDirDef.name = "output";
+    outputDirDef.shortName = 'o';
+    outputDirDef.description = "The directory to write .mid files to";
+    outputDirParam = std::make_unique<CmdLine::ValueParam>(outputDirDef);
+
+    CmdLine::ValueParam::Definition jobsDef;
+    jobsDef.name = "jobs";
+    jobsDef.shortName = 'j';
+    jobsDef.description = "The number of files to convert at once in batch "
+                          "mode (0, the default, for the number of CPU "
+                          "threads)";
+    jobsParam = std::make_unique<CmdLine::ValueParam>(jobsDef);
+
+    CmdLine::OptionParam::Definition parallelTracksDef;
+    parallelTracksDef.name = "parallel-tracks";
+    parallelTracksDef.shortName = 'p';
+    parallelTracksDef.description = "Export the tracks within each file "
+                                    "in parallel";
+    parallelTracksParam = 
+        std::make_unique<CmdLine::OptionParam>(parallelTracksDef);
+
+    CmdLine::OptionParam::Definition listDef;
+    listDef.name = "list";
+    listDef.shortName = 'l';
+    listDef.description = "List the chunks in each file without converting";
+    listParam = std::make_unique<CmdLine::OptionParam>(listDef);
+
+    CmdLine::OptionParam::Definition statsDef;
+    statsDef.name = "stats";
+    statsDef.description = "Print the duration, tempo map, and note and "
+                           "event counts of each track as CSV, or as JSON "
+                           "Lines with --json, without converting";
+    statsParam = std::make_unique<CmdLine::OptionParam>(statsDef);
+
+    CmdLine::OptionParam::Definition validateDef;
+    validateDef.name = "validate-only";
+    validateDef.description = "Check each file for corruption, decoding "
+                              "every event, without converting";
+    validateParam = std::make_unique<CmdLine::OptionParam>(validateDef);
+
+    CmdLine::OptionParam::Definition jsonDef;
+    jsonDef.name = "json";
+    jsonDef.description = "Print machine-readable JSON Lines output";
+    jsonParam = std::make_unique<CmdLine::OptionParam>(jsonDef);
+
+    CmdLine::ValueParam::Definition extractDef;
+    extractDef.name = "extract";
+    extractDef.shortName = 'x';
+    extractDef.description = "Export only the specified zero-based track";
+    extractParam = std::make_unique<CmdLine::ValueParam>(extractDef);
+
+    CmdLine::OptionParam::Definition propagateSetupDef;
+    propagateSetupDef.name = "propagate-setup";
+    propagateSetupDef.shortName = 's';
+    propagateSetupDef.description = "Add the setup from the first track "
+                                    "(programs, controllers, tempo, etc.) to "
+                                    "the start of every transition track";
+    propagateSetupParam = 
+        std::make_unique<CmdLine::OptionParam>(propagateSetupDef);
+
+    CmdLine::ValueParam::Definition formatDef;
+    formatDef.name = "format";
+    formatDef.shortName = 'f';
+    formatDef.description = "Export every track into a single MIDI file of "
+                            "type 1 or 2 instead of one type 0 file per track";
+    formatParam = std::make_unique<CmdLine::ValueParam>(formatDef);
+
+    CmdLine::OptionParam::Definition quietDef;
+    quietDef.name = "quiet";
+    quietDef.shortName = 'q';
+    quietDef.description = "Don't print the details of each chunk";
+    quietParam = std::make_unique<CmdLine::OptionParam>(quietDef);
+
+    CmdLine::ValueParam::Definition reportDef;
+    reportDef.name = "report";
+    reportDef.shortName = 'r';
+    reportDef.description = "Write the timings and byte counts of each stage "
+                            "to the specified JSON file";
+    reportParam = std::make_unique<CmdLine::ValueParam>(reportDef);
+
+    CmdLine::OptionParam::Definition carveDef;
+    carveDef.name = "carve";
+    carveDef.shortName = 'c';
+    carveDef.description = "Search the inputs for embedded GMD data, such as "
+                           "in game resource files, and convert every GMD "
+                           "found";
+    carveParam = std::make_unique<CmdLine::OptionParam>(carveDef);
+
+    CmdLine::ValueParam::Definition cacheDef;
+    cacheDef.name = "cache";
+    cacheDef.description = "Reuse the .mid files of inputs that were already "
+                           "converted with the same options, keeping them in "
+                           "the specified directory";
+    cacheParam = std::make_unique<CmdLine::ValueParam>(cacheDef);
+
+    CmdLine::ValueParam::Definition cacheSizeDef;
+    cacheSizeDef.name = "cache-size";
+    cacheSizeDef.description = "The size in MB to trim the cache to after "
+                               "converting (defaults to 1024)";
+    cacheSizeParam = std::make_unique<CmdLine::ValueParam>(cacheSizeDef);
+
+    CmdLine::ValueParam::Definition dedupDef;
+    dedupDef.name = "dedup";
+    dedupDef.description = "Hard link tracks identical to one already "
+                           "exported instead of writing them again, and "
+                           "write a manifest of every track to the specified "
+                           "JSON file";
+    dedupParam = std::make_unique<CmdLine::ValueParam>(dedupDef);
+
+    CmdLine::OptionParam::Definition dedupRefsDef;
+    dedupRefsDef.name = "dedup-refs";
+    dedupRefsDef.description = "With --dedup, don't create duplicate tracks "
+                               "at all and only reference them in the "
+                               "manifest";
+    dedupRefsParam = std::make_unique<CmdLine::OptionParam>(dedupRefsDef);
+
+    CmdLine::ValueParam::Definition rangeDef;
+    rangeDef.name = "range";
+    rangeDef.description = "Export only the window start:end of each track, "
+                           "in ticks or in seconds with an s suffix (e.g. "
+                           "7680:15360 or 12.5s:30s), with the state at the "
+                           "start of the window restored";
+    rangeParam = std::make_unique<CmdLine::ValueParam>(rangeDef);
+
+    CmdLine::OptionParam::Definition asyncWriteDef;
+    asyncWriteDef.name = "async-write";
+    asyncWriteDef.description = "Write the .mid files on background threads "
+                                "while the next tracks are converted";
+    asyncWriteParam = std::make_unique<CmdLine::OptionParam>(asyncWriteDef);
+
+    CmdLine::OptionParam::Definition optimizeDef;
+    optimizeDef.name = "optimize";
+    optimizeDef.description = "Re-encode each track into as few bytes as "
+                              "possible, using running status and leaving "
+                              "out events that change nothing";
+    optimizeParam = std::make_unique<CmdLine::OptionParam>(optimizeDef);
+
+    CmdLine::OptionParam::Definition stripImuseDef;
+    stripImuseDef.name = "strip-imuse";
+    stripImuseDef.description = "With --optimize, also leave out the iMuse "
+                                "SysEx messages general MIDI players ignore";
+    stripImuseParam = std::make_unique<CmdLine::OptionParam>(stripImuseDef);
+
+    CmdLine::OptionParam::Definition watchDef;
+    watchDef.name = "watch";
+    watchDef.shortName = 'w';
+    watchDef.description = "Keep watching the specified directories and "
+                           "convert each .gmd file as it arrives, until "
+                           "interrupted";
+    watchParam = std::make_unique<CmdLine::OptionParam>(watchDef);
+
+    CmdLine::ValueParam::Definition debounceDef;
+    debounceDef.name = "debounce";
+    debounceDef.description = "With --watch, the milliseconds a file must go "
+                              "unchanged before it is converted (defaults "
+                              "to 250)";
+    debounceParam = std::make_unique<CmdLine::ValueParam>(debounceDef);
+
+    CmdLine::ValueParam::Definition serveDef;
+    serveDef.name = "serve";
+    serveDef.description = "Instead of converting files, answer conversion "
+                           "requests on the Unix domain socket at the "
+                           "specified path, until interrupted";
+    serveParam = std::make_unique<CmdLine::ValueParam>(serveDef);
+
+    CmdLine::ValueParam::Definition serveCacheDef;
+    serveCacheDef.name = "serve-cache";
+    serveCacheDef.description = "With --serve, the size in MB of the recent "
+                                "results kept in memory (defaults to 64)";
+    serveCacheParam = std::make_unique<CmdLine::ValueParam>(serveCacheDef);
+
+    CmdLine::OptionParam::Definition incrementalDef;
+    incrementalDef.name = "incremental";
+    incrementalDef.description = "Skip inputs whose .mid files are up to "
+                                 "date with the last run, and remove .mid "
+                                 "files an input no longer produces";
+    incrementalParam = std::make_unique<CmdLine::OptionParam>(incrementalDef);
+
     cmdLineParser = std::make_unique<CmdLine::Parser>(progParam.get(), args);
     cmdLineParser->Add(inputFileParam.get());
+    cmdLineParser->Add(inputListParam.get());
+    cmdLineParser->Add(outputDirParam.get());
+    cmdLineParser->Add(jobsParam.get());
+    cmdLineParser->Add(parallelTracksParam.get());
+    cmdLineParser->Add(listParam.get());
+    cmdLineParser->Add(statsParam.get());
+    cmdLineParser->Add(validateParam.get());
+    cmdLineParser->Add(jsonParam.get());
+    cmdLineParser->Add(extractParam.get());
+    cmdLineParser->Add(propagateSetupParam.get());
+    cmdLineParser->Add(formatParam.get());
+    cmdLineParser->Add(quietParam.get());
+    cmdLineParser->Add(reportParam.get());
+    cmdLineParser->Add(carveParam.get());
+    cmdLineParser->Add(cacheParam.get());
+    cmdLineParser->Add(cacheSizeParam.get());
+    cmdLineParser->Add(dedupParam.get());
+    cmdLineParser->Add(dedupRefsParam.get());
+    cmdLineParser->Add(rangeParam.get());
+    cmdLineParser->Add(asyncWriteParam.get());
+    cmdLineParser->Add(optimizeParam.get());
+    cmdLineParser->Add(stripImuseParam.get());
+    cmdLineParser->Add(watchParam.get());
+    cmdLineParser->Add(debounceParam.get());
+    cmdLineParser->Add(serveParam.get());
+    cmdLineParser->Add(serveCacheParam.get());
+    cmdLineParser->Add(incrementalParam.get());
 }
 
 int Program::Run()
 {
-    std::cout << PROGRAM_NAME << " v" << VERSION_MAJOR << "." << VERSION_MINOR
-              << " " << PROGRAM_RELEASE << " " << PROGRAM_BUILD_TYPE
-              << std::endl << PROGRAM_COPYRIGHT << std::endl << std::endl;
-
     if (!ParseArguments())
         return exitCodeInvalidArgs;
 
-    GmdFile gmd{ inputFileParam->Value() };
-    if (!gmd.Convert())
+    // JSON output and streamed .mid files are meant to be piped into other
+    // tools, so we keep anything else off of standard output.
+    if (!jsonParam->IsSpecified() && !statsParam->IsSpecified() && 
+        !IsStream())
+    {
+        PrintBanner();
+    }
+
+    if (serveParam->IsSpecified())
+        return RunServe();
+
+    if (listParam->IsSpecified())
+        return RunList();
+
+    if (statsParam->IsSpecified())
+        return RunStats();
+
+    if (validateParam->IsSpecified())
+        return RunValidate();
+
+    if (IsStream())
+        return RunStream();
+
+    if (!OpenCache() || !CreateOutputDirectory())
+        return exitCodeConversionError;
+
+    if (dedupParam->IsSpecified())
+    {
+        bool linkDuplicates = !dedupRefsParam->IsSpecified();
+        dedup = std::make_unique<TrackDeduplicator>(linkDuplicates);
+    }
+
+    if (asyncWriteParam->IsSpecified())
+        asyncWriter = std::make_unique<AsyncWriter>();
+
+    if (incrementalParam->IsSpecified())
+        incremental = std::make_unique<IncrementalManifest>();
+
+    int exitCode;
+    if (watchParam->IsSpecified())
+        exitCode = RunWatch();
+    else if (carveParam->IsSpecified())
+        exitCode = RunCarve();
+    else if (IsBatch())
+        exitCode = RunBatch();
+    else
+        exitCode = RunSingle();
+
+    CloseCache();
+    if (!WriteDedupManifest() && exitCode == exitCodeSuccess)
+        exitCode = exitCodeConversionError;
+    if (!SaveIncrementalManifest() && exitCode == exitCodeSuccess)
+        exitCode = exitCodeConversionError;
+
+    return exitCode;
+}
+
+int Program::RunSingle()
+{
+    GmdFile gmd{ inputFileParam->Value(), BuildOptions() };
+    bool converted = gmd.Convert();
+    bool reported = WriteReport({ gmd.Stats() }, gmd.Stats().totalSeconds);
+
+    if (!converted || !reported)
         return exitCodeConversionError;
     else
         return exitCodeSuccess;
 }
 
+/// @brief Parses a whole number given on the command line.
+/// @param text The text of the number, which may only contain digits.
+/// @param maxValue The largest value allowed.
+/// @param value Set to the number if it was parsed.
+/// @return true if the text is a number no larger than maxValue, otherwise
+/// false.
+template <typename T>
+static bool ParseNumber(const std::string& text, T maxValue, T& value)
+{
+    if (text.empty() || text.find_first_not_of("0123456789") != 
+        std::string::npos)
+    {
+        return false;
+    }
+
+    T number{ 0 };
+    for (char digit : text)
+    {
+        T digitValue = static_cast<T>(digit - '0');
+        if (number > (maxValue - digitValue) / 10)
+            return false;
+        number = number * 10 + digitValue;
+    }
+
+    value = number;
+    return true;
+}
+
+/// @brief Parses a size given on the command line in MB.
+/// @param text The text of the size, which may only contain digits.
+/// @param maxBytes The largest size allowed, in bytes.
+/// @param bytes Set to the size in bytes if it was parsed.
+/// @return true if the text is a size no larger than maxBytes, otherwise
+/// false.
+template <typename T>
+static bool ParseMegabytes(const std::string& text, T maxBytes, T& bytes)
+{
+    T megabytes{ 0 };
+    if (!ParseNumber(text, static_cast<T>(maxBytes / (1024 * 1024)), 
+                     megabytes))
+    {
+        return false;
+    }
+
+    bytes = megabytes * 1024 * 1024;
+    return true;
+}
+
 bool Program::ParseArguments()
 {
     if (cmdLineParser->Parse() == CmdLine::Parser::Status::Failure)
@@ -58,17 +393,712 @@ bool Program::ParseArguments()
                   << std::endl;
         return false;
     }
-    else if (!inputFileParam->IsSpecified())
+    else if (serveParam->IsSpecified() && 
+             (inputFileParam->IsSpecified() || inputListParam->IsSpecified()))
+    {
+        std::cerr << "--serve converts the files clients send, so no files "
+                  << "can be specified." << std::endl;
+        return false;
+    }
+    else if (serveCacheParam->IsSpecified() && 
+             !ParseMegabytes(serveCacheParam->Value(), 
+                             std::numeric_limits<size_t>::max(), 
+                             serveCacheSize))
+    {
+        std::cerr << "The server cache size must be a number of MB." 
+                  << std::endl;
+        return false;
+    }
+    else if (!inputFileParam->IsSpecified() && 
+             !inputListParam->IsSpecified() && !serveParam->IsSpecified())
     {
         std::cout << cmdLineParser->GenerateUsage() << std::endl;
         std::cerr << "You must specify a file to convert to .mid." 
                   << std::endl;
         return false;
     }
+    else if (jobsParam->IsSpecified() && 
+             !ParseNumber(jobsParam->Value(), 
+                          std::numeric_limits<size_t>::max(), numJobs))
+    {
+        std::cerr << "The number of jobs must be a non-negative number "
+                  << "(0 = all cores)." << std::endl;
+        return false;
+    }
+    else if (extractParam->IsSpecified() && 
+             !ParseNumber(extractParam->Value(), 
+                          std::numeric_limits<size_t>::max(), extractTrack))
+    {
+        std::cerr << "The track to extract must be a track number." 
+                  << std::endl;
+        return false;
+    }
+    else if (formatParam->IsSpecified() && 
+             formatParam->Value() != std::to_string(midiType1ID) &&
+             formatParam->Value() != std::to_string(midiType2ID))
+    {
+        std::cerr << "The single file MIDI type must be 1 or 2." << std::endl;
+        return false;
+    }
+    else if (propagateSetupParam->IsSpecified() && 
+             formatParam->IsSpecified() && 
+             formatParam->Value() == std::to_string(midiType1ID))
+    {
+        // The tracks of a type 1 file play at the same time, so the setup 
+        // would be sent again while the first track is already playing.
+        std::cerr << "--propagate-setup can't be combined with --format 1." 
+                  << std::endl;
+        return false;
+    }
+    else if (cacheSizeParam->IsSpecified() && 
+             !ParseMegabytes(cacheSizeParam->Value(), 
+                             std::numeric_limits<uint64_t>::max(), 
+                             cacheSize))
+    {
+        std::cerr << "The cache size must be a number of MB." << std::endl;
+        return false;
+    }
+    else if (rangeParam->IsSpecified() && 
+             !ParseTrackRange(rangeParam->Value(), range))
+    {
+        std::cerr << "The range must be start:end, where start is before "
+                  << "end and each is a number of ticks or a number of "
+                  << "seconds followed by s." << std::endl;
+        return false;
+    }
+    else if (debounceParam->IsSpecified() && 
+             !ParseNumber(debounceParam->Value(), programMaxDebounceMs, 
+                          debounceMs))
+    {
+        std::cerr << "The debounce time must be a number of milliseconds, "
+                  << "up to a day." << std::endl;
+        return false;
+    }
+    else if (stripImuseParam->IsSpecified() && 
+             !optimizeParam->IsSpecified())
+    {
+        std::cerr << "--strip-imuse can only be used with --optimize." 
+                  << std::endl;
+        return false;
+    }
+    else if (watchParam->IsSpecified() && 
+             (IsStream() || carveParam->IsSpecified()))
+    {
+        std::cerr << "--watch can't be combined with reading standard input "
+                  << "or --carve." << std::endl;
+        return false;
+    }
+    else if (incrementalParam->IsSpecified() && 
+             (IsStream() || carveParam->IsSpecified() || 
+              dedupRefsParam->IsSpecified()))
+    {
+        // A skipped input would leave its tracks out of the references.
+        std::cerr << "--incremental can't be combined with reading standard "
+                  << "input, --carve, or --dedup-refs." << std::endl;
+        return false;
+    }
     else if (cmdLineParser->BuiltInHelpOptionIsSpecified())
     {
         std::cout << cmdLineParser->GenerateHelp() << std::endl;
     }
 
     return true;
-}
\ No newline at end of file
+}
+
+ConversionOptions Program::BuildOptions()
+{
+    ConversionOptions options;
+    options.verbose = !quietParam->IsSpecified();
+    if (outputDirParam->IsSpecified())
+        options.outputDirectory = outputDirParam->Value();
+    options.parallelTracks = parallelTracksParam->IsSpecified();
+    if (extractParam->IsSpecified())
+        options.extractTrack = extractTrack;
+    options.propagateSetup = propagateSetupParam->IsSpecified();
+    if (formatParam->IsSpecified())
+        options.singleFileFormat = std::stoi(formatParam->Value());
+    if (rangeParam->IsSpecified())
+        options.range = range;
+    options.optimize = optimizeParam->IsSpecified();
+    options.stripImuseSysEx = stripImuseParam->IsSpecified();
+    options.cache = cache.get();
+    options.dedup = dedup.get();
+    options.incremental = incremental.get();
+    options.asyncWriter = asyncWriter.get();
+    return options;
+}
+
+bool Program::IsBatch()
+{
+    if (inputListParam->IsSpecified())
+        return true;
+
+    if (IsStream())
+        return false;
+
+    std::string input = inputFileParam->Value();
+    return IsGlob(input) || std::filesystem::is_directory(input);
+}
+
+bool Program::IsStream()
+{
+    return inputFileParam->IsSpecified() && 
+           inputFileParam->Value() == streamInputName;
+}
+
+void Program::PrintBanner()
+{
+    std::cout << PROGRAM_NAME << " v" << VERSION_MAJOR << "." << VERSION_MINOR
+              << " " << PROGRAM_RELEASE << " " << PROGRAM_BUILD_TYPE
+              << std::endl << PROGRAM_COPYRIGHT << std::endl << std::endl;
+}
+
+bool Program::ReadInputs(std::vector<std::string>& inputs)
+{
+    if (inputFileParam->IsSpecified())
+        inputs.push_back(inputFileParam->Value());
+
+    if (inputListParam->IsSpecified())
+    {
+        std::ifstream inputList{ inputListParam->Value() };
+        if (!inputList)
+        {
+            std::cerr << "Unable to open input list: " 
+                      << inputListParam->Value() << std::endl;
+            return false;
+        }
+
+        std::string line;
+        while (std::getline(inputList, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            if (!line.empty())
+                inputs.push_back(line);
+        }
+    }
+
+    return true;
+}
+
+bool Program::AddBatchInputs(BatchConverter& batch)
+{
+    std::vector<std::string> inputs;
+    bool allInputsFound = ReadInputs(inputs);
+    for (const std::string& input : inputs)
+        allInputsFound &= batch.AddInput(input);
+
+    return allInputsFound;
+}
+
+int Program::RunBatch()
+{
+    ConversionOptions options = BuildOptions();
+
+    // Printing every chunk of thousands of files from several threads at once
+    // would be both slow and unreadable, so batches only print a line per file.
+    options.verbose = false;
+
+    BatchConverter batch{ options, numJobs };
+    bool allInputsFound = AddBatchInputs(batch);
+
+    if (batch.NumFiles() == 0)
+        return exitCodeInvalidArgs;
+
+    bool converted = batch.Run();
+    bool reported = WriteReport(batch.Stats(), batch.WallSeconds());
+
+    if (!converted || !reported || !allInputsFound)
+        return exitCodeConversionError;
+    else
+        return exitCodeSuccess;
+}
+
+/// @brief The watcher to stop when the program is interrupted, if any.
+static std::atomic<FolderWatcher*> activeWatcher{ nullptr };
+
+/// @brief Stops the active watcher, so that the files already being
+/// converted can finish before the program exits.
+/// @param signal The signal that was received.
+static void StopWatching(int)
+{
+    FolderWatcher* watcher = activeWatcher;
+    if (watcher != nullptr)
+        watcher->Stop();
+}
+
+int Program::RunWatch()
+{
+    std::vector<std::string> inputs;
+    if (!ReadInputs(inputs))
+        return exitCodeInvalidArgs;
+
+    std::chrono::milliseconds debounce{ debounceMs };
+
+    FolderWatcher watcher{ { inputs.begin(), inputs.end() }, debounce };
+    if (!watcher.Start())
+    {
+        std::cerr << watcher.Error() << std::endl;
+        return exitCodeInvalidArgs;
+    }
+
+    // Whatever picks up the .mid files may be watching the output directory
+    // just as we watch ours, so it must never see a file half written.
+    ConversionOptions options = BuildOptions();
+    options.verbose = false;
+    options.atomicWrites = true;
+
+    // A watch may run for weeks, so the report is written as each file is
+    // converted rather than gathered up until the end.
+    std::unique_ptr<std::ofstream> report;
+    std::unique_ptr<JsonReportWriter> reportWriter;
+    if (reportParam->IsSpecified())
+    {
+        report = std::make_unique<std::ofstream>(reportParam->Value());
+        if (!*report)
+        {
+            std::cerr << "Unable to write report: " << reportParam->Value() 
+                      << std::endl;
+            return exitCodeConversionError;
+        }
+        reportWriter = std::make_unique<JsonReportWriter>(*report);
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    size_t numConverted{ 0 };
+    size_t numFailed{ 0 };
+    std::mutex outputMutex;
+    {
+        // The pool lives as long as the watch, so its workers are already
+        // waiting by the time a file arrives.
+        WorkerPool pool{ numJobs };
+        options.trackWorkers = NestedWorkerCount(pool.Size());
+        std::cout << "Watching " << inputs.size() << " directories "
+                  << (watcher.UsesInotify() ? "with inotify" : "by scanning")
+                  << " using " << pool.Size() << " workers, press Ctrl+C to "
+                  << "stop..." << std::endl << std::endl;
+
+        activeWatcher = &watcher;
+        std::signal(SIGINT, StopWatching);
+        std::signal(SIGTERM, StopWatching);
+
+        std::vector<std::filesystem::path> ready;
+        while (watcher.Next(ready))
+        {
+            for (const std::filesystem::path& file : ready)
+            {
+                auto readyTime = std::chrono::steady_clock::now();
+                pool.Submit([&, file, readyTime]
+                {
+                    bool succeeded{ false };
+                    std::string errorMessage;
+                    ConversionStats fileStats;
+                    try
+                    {
+                        GmdFile gmd{ file.string(), 
+                                     BatchOptionsFor(options, file) };
+                        succeeded = gmd.Convert();
+                        fileStats = gmd.Stats();
+                        errorMessage = gmd.Error();
+                    }
+                    catch (const std::exception& e)
+                    {
+                        errorMessage = e.what();
+                        fileStats.fileName = file.string();
+                    }
+
+                    // A watch may run for weeks and end with a crash rather
+                    // than Ctrl+C, so what it converted is saved right away.
+                    bool saved = !incremental || incremental->Save();
+
+                    double milliseconds = std::chrono::duration<double, 
+                        std::milli>(std::chrono::steady_clock::now() - 
+                                    readyTime).count();
+
+                    // Each line is flushed as it is written, since a daemon's
+                    // output usually goes to a log that is read as it grows.
+                    std::lock_guard<std::mutex> lock{ outputMutex };
+                    if (succeeded)
+                        numConverted++;
+                    else
+                        numFailed++;
+                    if (reportWriter)
+                    {
+                        reportWriter->Add(fileStats);
+                        report->flush();
+                    }
+
+                    std::cout << (succeeded ? "[OK]     " : "[FAILED] ") 
+                              << file.string();
+                    if (!errorMessage.empty())
+                        std::cout << " (" << errorMessage << ")";
+                    std::cout << " in " << std::fixed << std::setprecision(1)
+                              << milliseconds << " ms" << std::endl;
+                    if (!saved)
+                    {
+                        std::cerr << "Unable to write the incremental "
+                                  << "manifests." << std::endl;
+                    }
+                });
+            }
+            ready.clear();
+        }
+
+        std::signal(SIGINT, SIG_DFL);
+        std::signal(SIGTERM, SIG_DFL);
+        activeWatcher = nullptr;
+    }
+
+    double wallSeconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - startTime).count();
+    std::cout << std::endl << "Stopped watching after converting " 
+              << numConverted << " files (" << numFailed << " failed)" 
+              << std::endl;
+
+    bool reported{ true };
+    if (reportWriter)
+    {
+        reportWriter->Finish(wallSeconds);
+        report->close();
+        if (!*report)
+        {
+            std::cerr << "Unable to write report: " << reportParam->Value() 
+                      << std::endl;
+            reported = false;
+        }
+    }
+
+    if (numFailed > 0 || !reported)
+        return exitCodeConversionError;
+    else
+        return exitCodeSuccess;
+}
+
+/// @brief The server to stop when the program is interrupted, if any.
+static std::atomic<ConversionServer*> activeServer{ nullptr };
+
+/// @brief Stops the active server, so that the requests already being
+/// answered can finish before the program exits.
+/// @param signal The signal that was received.
+static void StopServing(int)
+{
+    ConversionServer* server = activeServer;
+    if (server != nullptr)
+        server->Stop();
+}
+
+int Program::RunServe()
+{
+    ConversionServer server{ serveParam->Value(), numJobs, serveCacheSize };
+    if (!server.Start())
+    {
+        std::cerr << server.Error() << std::endl;
+        return exitCodeConversionError;
+    }
+
+    std::cout << "Listening on " << serveParam->Value() << " with a " 
+              << serveCacheSize / 1024 / 1024 << " MB result cache, press "
+              << "Ctrl+C to stop..." << std::endl;
+
+    activeServer = &server;
+    std::signal(SIGINT, StopServing);
+    std::signal(SIGTERM, StopServing);
+    server.Run();
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+    activeServer = nullptr;
+
+    ConversionServerStats stats = server.Stats();
+    std::cout << std::endl << "Stopped serving after answering " 
+              << stats.requests << " requests (" << stats.failed 
+              << " failed)" << std::endl
+              << "Result cache: " << stats.cache.hits << " hits, " 
+              << stats.cache.misses << " misses, " << stats.cache.evictions 
+              << " evictions, " << std::fixed << std::setprecision(1) 
+              << stats.cache.size / 1024.0 / 1024.0 << " MB held" 
+              << std::endl;
+    return exitCodeSuccess;
+}
+
+int Program::RunStream()
+{
+#ifdef _WIN32
+    // Standard input and output are opened in text mode on Windows, which
+    // would mangle every CR and LF byte in the .gmd and .mid files.
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+    // Chunk details would be mixed in with the .mid files on standard output.
+    ConversionOptions options = BuildOptions();
+    options.verbose = false;
+
+    // A single MIDI file can be written to standard output as is, but 
+    // separate files per track need to be framed to be told apart.
+    StreamSink sink{ std::cout, !options.singleFileFormat };
+    StreamConverter converter{ std::cin, streamFileName, options };
+    bool converted = converter.Convert(sink);
+    bool reported = WriteReport({ converter.Stats() }, 
+                                converter.Stats().totalSeconds);
+
+    if (!converted || !reported)
+        return exitCodeConversionError;
+    else
+        return exitCodeSuccess;
+}
+
+bool Program::WriteReport(const std::vector<ConversionStats>& stats, 
+                          double wallSeconds)
+{
+    if (!reportParam->IsSpecified())
+        return true;
+
+    std::ofstream report{ reportParam->Value() };
+    if (report)
+        WriteJsonReport(report, stats, wallSeconds);
+
+    if (!report)
+    {
+        std::cerr << "Unable to write report: " << reportParam->Value() 
+                  << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool Program::OpenCache()
+{
+    if (!cacheParam->IsSpecified())
+        return true;
+
+    cache = std::make_unique<ConversionCache>(cacheParam->Value(), cacheSize);
+    if (!cache->Open())
+    {
+        std::cerr << "Unable to open the cache directory: " 
+                  << cacheParam->Value() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool Program::CreateOutputDirectory()
+{
+    if (!outputDirParam->IsSpecified())
+        return true;
+
+    // Otherwise every file would fail to write on its own, each with the
+    // same error.
+    std::error_code error;
+    std::filesystem::create_directories(outputDirParam->Value(), error);
+    if (error)
+    {
+        std::cerr << "Unable to create the output directory " 
+                  << outputDirParam->Value() << ": " << error.message() 
+                  << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void Program::CloseCache()
+{
+    if (!cache)
+        return;
+
+    cache->Evict();
+
+    ConversionCacheStats stats = cache->Stats();
+    std::cout << "Cache: " << stats.hits << " hits, " << stats.misses 
+              << " misses, " << stats.stores << " stored, " 
+              << stats.evictions << " evicted, " << stats.size 
+              << " bytes in use" << std::endl;
+}
+
+bool Program::WriteDedupManifest()
+{
+    if (!dedup)
+        return true;
+
+    std::cout << "Duplicates: " << dedup->NumDuplicates() << " tracks, " 
+              << dedup->BytesSaved() << " bytes not written" << std::endl;
+
+    if (!dedup->WriteManifest(dedupParam->Value()))
+    {
+        std::cerr << "Unable to write the dedup manifest: " 
+                  << dedupParam->Value() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool Program::SaveIncrementalManifest()
+{
+    if (!incremental)
+        return true;
+
+    IncrementalManifestStats stats = incremental->Stats();
+    std::cout << "Incremental: " << stats.upToDate << " up to date, " 
+              << stats.stale << " converted, " << stats.orphansRemoved 
+              << " orphaned files removed" << std::endl;
+
+    if (!incremental->Save())
+    {
+        std::cerr << "Unable to write the incremental manifests." 
+                  << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool Program::GatherFiles(std::vector<std::filesystem::path>& files)
+{
+    if (!IsBatch())
+    {
+        files.push_back(inputFileParam->Value());
+        return true;
+    }
+
+    BatchConverter batch{ BuildOptions(), 1 };
+    bool allInputsFound = AddBatchInputs(batch);
+    files = batch.Files();
+    return allInputsFound;
+}
+
+int Program::RunCarve()
+{
+    std::vector<std::filesystem::path> files;
+    bool allInputsFound = GatherFiles(files);
+
+    auto startTime = std::chrono::steady_clock::now();
+    std::vector<ConversionStats> stats;
+    bool allCarved{ true };
+    for (const auto& file : files)
+    {
+        GmdCarver carver{ file.string(), BuildOptions(), numJobs };
+        allCarved &= carver.Carve();
+        stats.insert(stats.end(), carver.Stats().begin(), 
+                     carver.Stats().end());
+    }
+
+    double wallSeconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - startTime).count();
+    bool reported = WriteReport(stats, wallSeconds);
+
+    if (files.empty())
+        return exitCodeInvalidArgs;
+    else if (!allCarved || !reported || !allInputsFound)
+        return exitCodeConversionError;
+    else
+        return exitCodeSuccess;
+}
+
+int Program::RunList()
+{
+    std::vector<std::filesystem::path> files;
+    bool allInputsFound = GatherFiles(files);
+
+    // Indexing only touches the chunk headers, so listing is bound by the
+    // cost of opening each file and gains nothing from the worker pool.
+    bool allListed{ true };
+    for (const auto& file : files)
+    {
+        GmdFile gmd{ file.string(), BuildOptions() };
+        allListed &= gmd.List(jsonParam->IsSpecified());
+    }
+
+    if (files.empty())
+        return exitCodeInvalidArgs;
+    else if (!allListed || !allInputsFound)
+        return exitCodeConversionError;
+    else
+        return exitCodeSuccess;
+}
+
+int Program::RunStats()
+{
+    bool json = jsonParam->IsSpecified();
+    if (!json)
+        WriteTrackStatsCsvHeader(std::cout);
+
+    return RunPerFile([json](GmdFile& gmd, std::ostream& output)
+    {
+        return gmd.WriteTrackStats(output, json);
+    });
+}
+
+int Program::RunValidate()
+{
+    bool json = jsonParam->IsSpecified();
+    return RunPerFile([json](GmdFile& gmd, std::ostream& output)
+    {
+        bool valid = gmd.Validate(true);
+        if (json)
+        {
+            output << "{\"file\":" << JsonString(gmd.FileName()) 
+                   << ",\"valid\":" << (valid ? "true" : "false");
+            if (!valid)
+                output << ",\"error\":" << JsonString(gmd.Error());
+            output << "}\n";
+        }
+        else if (valid)
+        {
+            output << "OK       " << gmd.FileName() << '\n';
+        }
+        else
+        {
+            // Some errors span several lines, but each file gets one line
+            // here so the output can be filtered with grep.
+            std::string error = gmd.Error();
+            std::replace(error.begin(), error.end(), '\n', ' ');
+            output << "INVALID  " << gmd.FileName() << ": " << error << '\n';
+        }
+
+        return valid;
+    }, false);
+}
+
+int Program::RunPerFile(
+    std::function<bool(GmdFile& gmd, std::ostream& output)> run, 
+    bool printErrors)
+{
+    std::vector<std::filesystem::path> files;
+    bool allInputsFound = GatherFiles(files);
+
+    // Each file writes to its own buffer so that the output comes out in
+    // the same order as the files no matter which worker finishes first.
+    ConversionOptions options = BuildOptions();
+    options.verbose = false;
+    options.printErrors = printErrors;
+    std::vector<std::string> outputs(files.size());
+    std::atomic<bool> allSucceeded{ true };
+    {
+        WorkerPool pool{ numJobs };
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            pool.Submit([&, i]
+            {
+                GmdFile gmd{ files[i].string(), options };
+                std::stringstream output;
+                if (!run(gmd, output))
+                    allSucceeded = false;
+                outputs[i] = output.str();
+            });
+        }
+    }
+
+    for (const std::string& output : outputs)
+        std::cout << output;
+    std::cout << std::flush;
+
+    if (files.empty())
+        return exitCodeInvalidArgs;
+    else if (!allSucceeded || !allInputsFound)
+        return exitCodeConversionError;
+    else
+        return exitCodeSuccess;
+}
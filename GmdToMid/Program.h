@@ -17,13 +17,27 @@
 #ifndef PROGRAM_H
 #define PROGRAM_H
 
+#include <functional>
 #include <memory>
 #include <vector>
 #include <string>
 #include <iostream>
 #include "CmdLine.h"
 #include "BinData.h"
+#include "AsyncWriter.h"
 #include "GmdFile.h"
+#include "BatchConverter.h"
+#include "ConversionCache.h"
+#include "ConversionOptions.h"
+#include "ConversionServer.h"
+#include "FolderWatcher.h"
+#include "GmdCarver.h"
+#include "IncrementalManifest.h"
+#include "SeekIndex.h"
+#include "StreamConverter.h"
+#include "TrackDeduplicator.h"
+#include "TrackStats.h"
+#include "WorkerPool.h"
 #include "Version.h"
 
 /// @brief Indicates the program ran successfully.
@@ -35,6 +49,17 @@ inline constexpr int exitCodeInvalidArgs{ 1 };
 /// @brief Indicates conversion failed.
 inline constexpr int exitCodeConversionError{ 2 };
 
+/// @brief The input name that reads the .gmd file from standard input.
+inline const char* streamInputName{ "-" };
+
+/// @brief The .gmd file name used to name the .mid files read from 
+/// standard input.
+inline const char* streamFileName{ "stdin.gmd" };
+
+/// @brief The longest debounce time allowed with --watch, a day in 
+/// milliseconds.
+inline constexpr int64_t programMaxDebounceMs{ 24 * 60 * 60 * 1000 };
+
 /// @brief This class encasulates the main program logic.
 class Program
 {
@@ -49,11 +74,158 @@ public:
 private:
     std::unique_ptr<CmdLine::ProgParam> progParam;
     std::unique_ptr<CmdLine::PosParam> inputFileParam;
+    std::unique_ptr<CmdLine::ValueParam> inputListParam;
+    std::unique_ptr<CmdLine::ValueParam> outputDirParam;
+    std::unique_ptr<CmdLine::ValueParam> jobsParam;
+    std::unique_ptr<CmdLine::OptionParam> parallelTracksParam;
+    std::unique_ptr<CmdLine::OptionParam> listParam;
+    std::unique_ptr<CmdLine::OptionParam> statsParam;
+    std::unique_ptr<CmdLine::OptionParam> validateParam;
+    std::unique_ptr<CmdLine::OptionParam> jsonParam;
+    std::unique_ptr<CmdLine::ValueParam> extractParam;
+    std::unique_ptr<CmdLine::OptionParam> propagateSetupParam;
+    std::unique_ptr<CmdLine::ValueParam> formatParam;
+    std::unique_ptr<CmdLine::OptionParam> quietParam;
+    std::unique_ptr<CmdLine::ValueParam> reportParam;
+    std::unique_ptr<CmdLine::OptionParam> carveParam;
+    std::unique_ptr<CmdLine::ValueParam> cacheParam;
+    std::unique_ptr<CmdLine::ValueParam> cacheSizeParam;
+    std::unique_ptr<CmdLine::ValueParam> dedupParam;
+    std::unique_ptr<CmdLine::OptionParam> dedupRefsParam;
+    std::unique_ptr<CmdLine::ValueParam> rangeParam;
+    std::unique_ptr<CmdLine::OptionParam> asyncWriteParam;
+    std::unique_ptr<CmdLine::OptionParam> optimizeParam;
+    std::unique_ptr<CmdLine::OptionParam> stripImuseParam;
+    std::unique_ptr<CmdLine::OptionParam> watchParam;
+    std::unique_ptr<CmdLine::ValueParam> debounceParam;
+    std::unique_ptr<CmdLine::ValueParam> serveParam;
+    std::unique_ptr<CmdLine::ValueParam> serveCacheParam;
+    std::unique_ptr<CmdLine::OptionParam> incrementalParam;
+    TrackRange range;
+    size_t numJobs{ 0 };
+    size_t extractTrack{ 0 };
+    uint64_t cacheSize{ conversionCacheDefaultSize };
+    size_t serveCacheSize{ resultCacheDefaultSize };
+    int64_t debounceMs{ folderWatcherDefaultDebounceMs };
+    std::unique_ptr<ConversionCache> cache;
+    std::unique_ptr<TrackDeduplicator> dedup;
+    std::unique_ptr<IncrementalManifest> incremental;
+    std::unique_ptr<AsyncWriter> asyncWriter;
     std::unique_ptr<CmdLine::Parser> cmdLineParser;
 
     /// @brief Parses the command line arguments.
     /// @return true if arguments were successfully parsed, otherwise false.
     bool ParseArguments();
+
+    /// @brief Builds the conversion options from the command line arguments.
+    /// @return The options to convert with.
+    ConversionOptions BuildOptions();
+
+    /// @brief Determines if the command line requests a batch conversion.
+    /// @return true if more than a single file should be converted.
+    bool IsBatch();
+
+    /// @brief Determines if the .gmd file is read from standard input.
+    /// @return true if the input is standard input.
+    bool IsStream();
+
+    /// @brief Prints the program name, version, and copyright.
+    void PrintBanner();
+
+    /// @brief Gets every file, directory, and glob that was specified, on
+    /// the command line or in the input list.
+    /// @param inputs The list to add the inputs to.
+    /// @return true if the input list, if any, was read.
+    bool ReadInputs(std::vector<std::string>& inputs);
+
+    /// @brief Adds every file, directory, and glob that was specified.
+    /// @param batch The batch to add the inputs to.
+    /// @return true if every input matched at least one file.
+    bool AddBatchInputs(BatchConverter& batch);
+
+    /// @brief Converts every file, directory, and glob that was specified.
+    /// @return The exit status of the program.
+    int RunBatch();
+
+    /// @brief Opens the conversion cache if one was specified.
+    /// @return true if no cache was specified or it was opened.
+    bool OpenCache();
+
+    /// @brief Creates the output directory if one was specified and it 
+    /// doesn't exist yet.
+    /// @return true if no directory was specified or it exists.
+    bool CreateOutputDirectory();
+
+    /// @brief Trims the conversion cache to its size limit and prints its
+    /// statistics, if a cache was specified.
+    void CloseCache();
+
+    /// @brief Writes the deduplication manifest and prints its totals, if
+    /// deduplication was requested.
+    /// @return true if no manifest was requested or it was written.
+    bool WriteDedupManifest();
+
+    /// @brief Writes the manifests of every output directory and prints
+    /// their totals, if an incremental conversion was requested.
+    /// @return true if no manifests were requested or they were written.
+    bool SaveIncrementalManifest();
+
+    /// @brief Watches every directory that was specified and converts each
+    /// .gmd file that arrives, until interrupted.
+    /// @return The exit status of the program.
+    int RunWatch();
+
+    /// @brief Answers conversion requests on the socket that was specified,
+    /// until interrupted.
+    /// @return The exit status of the program.
+    int RunServe();
+
+    /// @brief Converts the single file that was specified.
+    /// @return The exit status of the program.
+    int RunSingle();
+
+    /// @brief Gets every file that was specified, expanding batch inputs.
+    /// @param files The list to add the files to.
+    /// @return true if every input matched at least one file.
+    bool GatherFiles(std::vector<std::filesystem::path>& files);
+
+    /// @brief Converts the .gmd files embedded in every file specified.
+    /// @return The exit status of the program.
+    int RunCarve();
+
+    /// @brief Converts standard input and writes the .mid files to standard
+    /// output.
+    /// @return The exit status of the program.
+    int RunStream();
+
+    /// @brief Writes the JSON report if one was requested.
+    /// @param stats The stats of every converted file.
+    /// @param wallSeconds The wall clock time of the conversion, in seconds.
+    /// @return true if no report was requested or it was written.
+    bool WriteReport(const std::vector<ConversionStats>& stats, 
+                     double wallSeconds);
+
+    /// @brief Prints the statistics of every track in every file that was
+    /// specified.
+    /// @return The exit status of the program.
+    int RunStats();
+
+    /// @brief Checks every file that was specified for corruption.
+    /// @return The exit status of the program.
+    int RunValidate();
+
+    /// @brief Runs a function on every file that was specified, in 
+    /// parallel, and prints what each wrote in the order of the files.
+    /// @param run The function to run, which returns true if it succeeded.
+    /// @param printErrors Determines if errors are printed to standard 
+    /// error as well.
+    /// @return The exit status of the program.
+    int RunPerFile(std::function<bool(GmdFile& gmd, std::ostream& output)> run,
+                   bool printErrors = true);
+
+    /// @brief Lists the chunks in every file that was specified.
+    /// @return The exit status of the program.
+    int RunList();
 };
 
 #endif
\ No newline at end of file
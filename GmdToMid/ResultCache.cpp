@@ -0,0 +1,66 @@
+// ResultCache.cpp - Defines the ResultCache class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ResultCache.h"
+
+ResultCache::Result ResultCache::Find(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock{ mutex };
+    auto entry = lookup.find(key);
+    if (entry == lookup.end())
+    {
+        stats.misses++;
+        return nullptr;
+    }
+
+    // The front of the list is the most recently used.
+    stats.hits++;
+    entries.splice(entries.begin(), entries, entry->second);
+    return entry->second->second;
+}
+
+void ResultCache::Store(const std::string& key, Result result)
+{
+    if (!result || result->size() > maxSize)
+        return;
+
+    std::lock_guard<std::mutex> lock{ mutex };
+    auto existing = lookup.find(key);
+    if (existing != lookup.end())
+    {
+        stats.size -= existing->second->second->size();
+        entries.erase(existing->second);
+        lookup.erase(existing);
+    }
+
+    while (!entries.empty() && stats.size + result->size() > maxSize)
+    {
+        stats.size -= entries.back().second->size();
+        stats.evictions++;
+        lookup.erase(entries.back().first);
+        entries.pop_back();
+    }
+
+    stats.size += result->size();
+    entries.emplace_front(key, std::move(result));
+    lookup[key] = entries.begin();
+}
+
+ResultCacheStats ResultCache::Stats()
+{
+    std::lock_guard<std::mutex> lock{ mutex };
+    return stats;
+}
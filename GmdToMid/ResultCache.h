@@ -0,0 +1,90 @@
+// ResultCache.h - Declares the ResultCache class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/// @brief The size of a ResultCache, in bytes, unless another is specified.
+inline constexpr size_t resultCacheDefaultSize{ 64 * 1024 * 1024 };
+
+/// @brief Holds the counters of a ResultCache.
+struct ResultCacheStats
+{
+    /// @brief The number of lookups that found a result.
+    uint64_t hits{ 0 };
+
+    /// @brief The number of lookups that found nothing.
+    uint64_t misses{ 0 };
+
+    /// @brief The number of results evicted to make room for newer ones.
+    uint64_t evictions{ 0 };
+
+    /// @brief The total size of the results held, in bytes.
+    uint64_t size{ 0 };
+};
+
+/// @brief Keeps the most recently used results in memory, up to a size.
+///
+/// Unlike ConversionCache, nothing is written to disk, so a hit costs only a
+/// hash lookup. Results are shared rather than copied, so a result that is
+/// evicted while it is still being sent stays alive until it has been sent.
+/// All methods may be called from several threads at once.
+class ResultCache
+{
+public:
+    /// @brief A result, which is never modified once stored.
+    using Result = std::shared_ptr<const std::vector<uint8_t>>;
+
+    /// @brief Constructor; creates a new, empty ResultCache.
+    /// @param maxSize The most bytes of results to hold.
+    ResultCache(size_t maxSize = resultCacheDefaultSize) : maxSize{ maxSize }
+    { }
+
+    /// @brief Finds a result and marks it as the most recently used.
+    /// @param key The key the result was stored under.
+    /// @return The result, or null if it isn't held.
+    Result Find(const std::string& key);
+
+    /// @brief Stores a result, evicting the least recently used results
+    /// until it fits.
+    /// @param key The key to store the result under.
+    /// @param result The result, which is not stored if it is larger than
+    /// the whole cache.
+    void Store(const std::string& key, Result result);
+
+    /// @brief Gets the counters of the cache.
+    /// @return The counters.
+    ResultCacheStats Stats();
+private:
+    using Entry = std::pair<std::string, Result>;
+
+    std::mutex mutex;
+    size_t maxSize;
+    std::list<Entry> entries;
+    std::unordered_map<std::string, std::list<Entry>::iterator> lookup;
+    ResultCacheStats stats;
+};
+
+#endif
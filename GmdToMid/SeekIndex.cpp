@@ -0,0 +1,317 @@
+// SeekIndex.cpp - Defines the SeekIndex class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <sstream>
+#include "MidiEvent.h"
+#include "SeekIndex.h"
+
+/// @brief The number of MIDI note numbers.
+static constexpr int midiNumNotes{ 128 };
+
+/// @brief The controller number of the sustain pedal.
+static constexpr uint8_t ccSustain{ 64 };
+
+/// @brief Converts a number of ticks to a tick, saturating at the largest.
+/// @param ticks The number of ticks.
+/// @return The tick, which is never negative.
+static uint32_t ClampTick(double ticks)
+{
+    if (!(ticks > 0))
+        return 0;
+    if (ticks >= std::numeric_limits<uint32_t>::max())
+        return std::numeric_limits<uint32_t>::max();
+
+    return static_cast<uint32_t>(std::llround(ticks));
+}
+
+bool SeekIndex::Build(ByteSpan track, uint16_t division)
+{
+    this->track = track;
+    this->division = division;
+    endTick = 0;
+    checkpoints.clear();
+    tempoChanges.clear();
+    error.clear();
+
+    EventCursor cursor{ track };
+    MidiState state;
+    MidiEvent event;
+    size_t numEvents{ 0 };
+    while (true)
+    {
+        if (numEvents % seekIndexCheckpointInterval == 0)
+        {
+            checkpoints.push_back(SeekCheckpoint{ cursor.Tick(), 
+                                                  cursor.Position(), 
+                                                  cursor.RunningStatus(), 
+                                                  state });
+        }
+
+        if (!cursor.Next(event))
+            break;
+
+        ByteSpan data = track.Subspan(event.dataOffset, event.dataLength);
+        state.Apply(event, data);
+        if (event.status == midiMeta && event.metaType == midiMetaTempo && 
+            data.size >= 3)
+        {
+            uint32_t tempo = (data.data[0] << 16) | (data.data[1] << 8) | 
+                             data.data[2];
+            if (tempo > 0)
+                tempoChanges.push_back(TempoChange{ event.tick, tempo });
+        }
+
+        endTick = event.tick;
+        numEvents++;
+    }
+
+    if (cursor.HasError())
+    {
+        error = cursor.Error();
+        return false;
+    }
+
+    return true;
+}
+
+const SeekCheckpoint& SeekIndex::Find(uint32_t tick) const
+{
+    // Every event before a checkpoint is at or before the checkpoint's tick,
+    // so the last checkpoint before the tick has none of the window's events
+    // behind it.
+    auto next = std::lower_bound(
+        checkpoints.begin(), checkpoints.end(), tick,
+        [](const SeekCheckpoint& checkpoint, uint32_t tick)
+        {
+            return checkpoint.tick < tick;
+        });
+
+    if (next == checkpoints.begin())
+        return checkpoints.front();
+
+    return *(next - 1);
+}
+
+uint32_t SeekIndex::TickOf(const RangeBound& bound) const
+{
+    if (!bound.seconds)
+        return ClampTick(bound.value);
+
+    // SMPTE divisions count ticks per frame rather than per quarter note, so
+    // the tempo doesn't matter.
+    if (division & 0x8000)
+    {
+        int framesPerSecond = -static_cast<int8_t>(division >> 8);
+        int ticksPerFrame = division & 0xFF;
+        return ClampTick(bound.value * framesPerSecond * ticksPerFrame);
+    }
+
+    if (division == 0)
+        return 0;
+
+    double microseconds = bound.value * 1000000;
+    double elapsed{ 0 };
+    uint32_t tick{ 0 };
+    uint32_t tempo{ midiDefaultTempo };
+    for (const TempoChange& change : tempoChanges)
+    {
+        double span = static_cast<double>(change.tick - tick) * tempo / 
+                      division;
+        if (elapsed + span > microseconds)
+            break;
+
+        elapsed += span;
+        tick = change.tick;
+        tempo = change.microsecondsPerQuarter;
+    }
+
+    return ClampTick(tick + (microseconds - elapsed) * division / tempo);
+}
+
+bool SeekIndex::Extract(uint32_t startTick, 
+                        uint32_t endTick, 
+                        std::vector<uint8_t>& segment)
+{
+    error.clear();
+    endTick = std::max(startTick, std::min(endTick, this->endTick));
+
+    const SeekCheckpoint& checkpoint = Find(startTick);
+    MidiState state = checkpoint.state;
+    EventCursor cursor{ track };
+    cursor.Seek(checkpoint.position, checkpoint.tick, 
+                checkpoint.runningStatus);
+
+    // The events between the checkpoint and the window only contribute to
+    // the state the window starts with.
+    MidiEvent event;
+    bool hasEvent;
+    while ((hasEvent = cursor.Next(event)) && event.tick < startTick)
+        state.Apply(event, track.Subspan(event.dataOffset, event.dataLength));
+
+    state.AppendPrelude(segment);
+
+    uint8_t heldNotes[midiNumChannels][midiNumNotes]{};
+    bool sustained[midiNumChannels]{};
+    uint32_t lastTick{ startTick };
+    for (; hasEvent && event.tick < endTick; hasEvent = cursor.Next(event))
+    {
+        // We end the segment ourselves, at the end of the window.
+        if (event.status == midiMeta && event.metaType == midiMetaEndOfTrack)
+            continue;
+
+        ByteSpan data = track.Subspan(event.dataOffset, event.dataLength);
+        AppendEvent(segment, event.tick - lastTick, event, data);
+        lastTick = event.tick;
+
+        if (!event.IsChannelEvent())
+            continue;
+
+        uint8_t& held = heldNotes[event.Channel()][data.data[0] & 0x7F];
+        if (event.Command() == midiNoteOn && data.data[1] > 0)
+            held = std::min(held + 1, 255);
+        else if (event.Command() == midiNoteOn || 
+                 event.Command() == midiNoteOff)
+            held = held > 0 ? held - 1 : 0;
+        else if (event.Command() == midiControlChange && 
+                 data.data[0] == ccSustain)
+            sustained[event.Channel()] = data.data[1] >= 64;
+    }
+
+    if (cursor.HasError())
+    {
+        error = cursor.Error();
+        return false;
+    }
+
+    // Notes cut off by the end of the window would otherwise hang, since
+    // their note offs were left behind.
+    uint32_t delta = endTick - lastTick;
+    for (int channel = 0; channel < midiNumChannels; channel++)
+    {
+        for (int note = 0; note < midiNumNotes; note++)
+        {
+            for (int i = 0; i < heldNotes[channel][note]; i++)
+            {
+                AppendVarLen(segment, delta);
+                segment.insert(segment.end(), 
+                    { static_cast<uint8_t>(midiNoteOff | channel), 
+                      static_cast<uint8_t>(note), 0 });
+                delta = 0;
+            }
+        }
+
+        if (sustained[channel])
+        {
+            AppendVarLen(segment, delta);
+            segment.insert(segment.end(), 
+                { static_cast<uint8_t>(midiControlChange | channel), 
+                  ccSustain, 0 });
+            delta = 0;
+        }
+    }
+
+    AppendVarLen(segment, delta);
+    segment.insert(segment.end(), { midiMeta, midiMetaEndOfTrack, 0 });
+    return true;
+}
+
+bool ExtractRange(ByteSpan track, 
+                  uint16_t division, 
+                  const TrackRange& range, 
+                  std::vector<uint8_t>& segment,
+                  std::string& error)
+{
+    SeekIndex index;
+    if (!index.Build(track, division))
+    {
+        error = "Unable to index the track: " + index.Error();
+        return false;
+    }
+
+    uint32_t startTick = index.TickOf(range.start);
+    uint32_t endTick = index.TickOf(range.end);
+    if (startTick >= endTick)
+    {
+        std::stringstream message;
+        message << "The range is empty: tick " << startTick 
+                << " is not before tick " << endTick;
+        error = message.str();
+        return false;
+    }
+
+    if (!index.Extract(startTick, endTick, segment))
+    {
+        error = "Unable to extract the range: " + index.Error();
+        return false;
+    }
+
+    return true;
+}
+
+/// @brief Parses one end of a range.
+/// @param text The end of the range, or an empty string if it is open.
+/// @param openValue The value of the end if it is open.
+/// @param bound The bound to parse into.
+/// @return true if the end was parsed, otherwise false.
+static bool ParseRangeBound(const std::string& text, 
+                            double openValue, 
+                            RangeBound& bound)
+{
+    if (text.empty())
+    {
+        bound = RangeBound{ openValue, false };
+        return true;
+    }
+
+    std::string number = text;
+    bound.seconds = number.back() == 's';
+    if (bound.seconds)
+        number.pop_back();
+
+    // Ticks are whole numbers; seconds may have a fraction.
+    const char* allowed = bound.seconds ? "0123456789." : "0123456789";
+    if (number.empty() || number.find_first_not_of(allowed) != 
+        std::string::npos)
+    {
+        return false;
+    }
+
+    char* end;
+    bound.value = std::strtod(number.c_str(), &end);
+    return *end == '\0';
+}
+
+bool ParseTrackRange(const std::string& text, TrackRange& range)
+{
+    size_t separator = text.find(':');
+    if (separator == std::string::npos)
+        return false;
+
+    if (!ParseRangeBound(text.substr(0, separator), 0, range.start) ||
+        !ParseRangeBound(text.substr(separator + 1), 
+                         std::numeric_limits<double>::infinity(), range.end))
+    {
+        return false;
+    }
+
+    // Ends in different units can only be compared once we know the tempo.
+    return range.start.seconds != range.end.seconds || 
+           range.start.value < range.end.value;
+}
@@ -0,0 +1,139 @@
+// SeekIndex.h - Declares the SeekIndex class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SEEK_INDEX_H
+#define SEEK_INDEX_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ByteSpan.h"
+#include "ConversionOptions.h"
+#include "MidiState.h"
+
+/// @brief The number of events between each checkpoint of a SeekIndex.
+inline constexpr size_t seekIndexCheckpointInterval{ 1024 };
+
+/// @brief Represents a point in a track that decoding can resume from.
+struct SeekCheckpoint
+{
+    /// @brief The tick of the last event before the checkpoint.
+    uint32_t tick{ 0 };
+
+    /// @brief The offset of the first event after the checkpoint.
+    size_t position{ 0 };
+
+    /// @brief The running status at the checkpoint.
+    uint8_t runningStatus{ 0 };
+
+    /// @brief The state built up by every event before the checkpoint.
+    MidiState state;
+};
+
+/// @brief Maps tick positions within a MIDI track to byte offsets.
+///
+/// The index is built in a single pass over the track. Every 
+/// seekIndexCheckpointInterval events it records a checkpoint: the offset of
+/// the next event, the running status, and the MidiState the track has 
+/// built up so far. A window of the track can then be cut out by decoding 
+/// from the nearest checkpoint instead of from the start of the track, 
+/// which is what makes a short window of a long track cheap.
+///
+/// The index also records the tempo changes in the track, so that windows
+/// can be given in seconds as well as ticks.
+class SeekIndex
+{
+public:
+    /// @brief Builds the index for a track.
+    /// @param track The data of the MIDI track chunk, excluding its header.
+    /// @param division The division from the MIDI header.
+    /// @return true if the index was built, otherwise false.
+    bool Build(ByteSpan track, uint16_t division);
+
+    /// @brief Gets the checkpoint to decode a window from.
+    /// @param tick The tick the window starts at.
+    /// @return The last checkpoint that comes before every event at or after
+    /// the tick.
+    const SeekCheckpoint& Find(uint32_t tick) const;
+
+    /// @brief Converts one end of a range to ticks.
+    /// @param bound The end of the range.
+    /// @return The tick the bound falls on.
+    uint32_t TickOf(const RangeBound& bound) const;
+
+    /// @brief Gets the tick of the end of the track.
+    /// @return The tick of the last event in the track.
+    uint32_t EndTick() const { return endTick; }
+
+    /// @brief Cuts a window out of the track as a standalone track.
+    /// @param startTick The tick the window starts at.
+    /// @param endTick The tick the window ends before.
+    /// @param segment The buffer to append the encoded track to.
+    /// @return true if the window was cut out, otherwise false.
+    ///
+    /// The segment starts with a prelude that restores the state the track
+    /// had built up by startTick, followed by every event in the window with
+    /// its tick moved back by startTick. Notes still sounding at the end of 
+    /// the window are released there, and the segment ends exactly 
+    /// endTick - startTick ticks after it starts, so it can be looped.
+    bool Extract(uint32_t startTick, 
+                 uint32_t endTick, 
+                 std::vector<uint8_t>& segment);
+
+    /// @brief Gets the number of checkpoints in the index.
+    /// @return The number of checkpoints, including the start of the track.
+    size_t NumCheckpoints() const { return checkpoints.size(); }
+
+    /// @brief Gets a description of the last error that occurred.
+    /// @return The error message, or an empty string if there was no error.
+    const std::string& Error() const { return error; }
+private:
+    /// @brief Represents a tempo change within the track.
+    struct TempoChange
+    {
+        uint32_t tick;
+        uint32_t microsecondsPerQuarter;
+    };
+
+    ByteSpan track;
+    uint16_t division{ 0 };
+    uint32_t endTick{ 0 };
+    std::vector<SeekCheckpoint> checkpoints;
+    std::vector<TempoChange> tempoChanges;
+    std::string error;
+};
+
+/// @brief Cuts the window selected by a range out of a track.
+/// @param track The data of the MIDI track chunk, excluding its header.
+/// @param division The division from the MIDI header.
+/// @param range The window to cut out.
+/// @param segment The buffer to append the encoded track to.
+/// @param error The error message, if the window couldn't be cut out.
+/// @return true if the window was cut out, otherwise false.
+bool ExtractRange(ByteSpan track, 
+                  uint16_t division, 
+                  const TrackRange& range, 
+                  std::vector<uint8_t>& segment,
+                  std::string& error);
+
+/// @brief Parses a range given as "start:end".
+/// @param text The range, where each end is a number of ticks, or a number
+/// of seconds followed by "s", and either end may be left out.
+/// @param range The range to parse into.
+/// @return true if the range was parsed, otherwise false.
+bool ParseTrackRange(const std::string& text, TrackRange& range);
+
+#endif
@@ -0,0 +1,340 @@
+// ServerProtocol.cpp - Defines the conversion server messages.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstring>
+#include "ServerProtocol.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+/// @brief Appends a big endian 16-bit unsigned integer to a buffer.
+/// @param buffer The buffer to append to.
+/// @param value The integer value to append.
+static void AppendUInt16BE(std::vector<uint8_t>& buffer, uint16_t value)
+{
+    size_t offset = buffer.size();
+    buffer.resize(offset + 2);
+    WriteUInt16BE(buffer.data() + offset, value);
+}
+
+/// @brief Appends a big endian 32-bit unsigned integer to a buffer.
+/// @param buffer The buffer to append to.
+/// @param value The integer value to append.
+static void AppendUInt32BE(std::vector<uint8_t>& buffer, uint32_t value)
+{
+    size_t offset = buffer.size();
+    buffer.resize(offset + 4);
+    WriteUInt32BE(buffer.data() + offset, value);
+}
+
+/// @brief Appends a range bound to a buffer.
+/// @param buffer The buffer to append to.
+/// @param bound The bound to append.
+static void AppendBound(std::vector<uint8_t>& buffer, const RangeBound& bound)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &bound.value, sizeof(bits));
+    buffer.push_back(bound.seconds ? 1 : 0);
+    AppendUInt32BE(buffer, static_cast<uint32_t>(bits >> 32));
+    AppendUInt32BE(buffer, static_cast<uint32_t>(bits));
+}
+
+/// @brief Reads the fields of a message in order, checking each against the
+/// end of the message.
+class MessageReader
+{
+public:
+    /// @brief Constructor; creates a new MessageReader.
+    /// @param body The body of the message.
+    MessageReader(ByteSpan body) : body{ body } { }
+
+    /// @brief Reads the specified number of bytes.
+    /// @param count The number of bytes to read.
+    /// @return The bytes, or null if the message ends first.
+    const uint8_t* Read(size_t count)
+    {
+        if (!body.Contains(position, count))
+            return nullptr;
+        const uint8_t* bytes = body.data + position;
+        position += count;
+        return bytes;
+    }
+
+    /// @brief Gets the bytes that have not been read yet.
+    /// @return The rest of the message.
+    ByteSpan Rest() const 
+    { 
+        return body.Subspan(position, body.size - position); 
+    }
+private:
+    ByteSpan body;
+    size_t position{ 0 };
+};
+
+/// @brief Reads a range bound from a message.
+/// @param reader The reader to read from.
+/// @param bound The bound to read into.
+/// @return true if the bound was read, otherwise false.
+static bool ReadBound(MessageReader& reader, RangeBound& bound)
+{
+    const uint8_t* bytes = reader.Read(9);
+    if (bytes == nullptr)
+        return false;
+
+    uint64_t bits = (static_cast<uint64_t>(ReadUInt32BE(bytes + 1)) << 32) |
+                    ReadUInt32BE(bytes + 5);
+    bound.seconds = bytes[0] != 0;
+    std::memcpy(&bound.value, &bits, sizeof(bits));
+    return true;
+}
+
+void EncodeServerRequest(const ServerRequest& request, 
+                         std::vector<uint8_t>& message)
+{
+    const ConversionOptions& options = request.options;
+    message.clear();
+    AppendUInt32BE(message, 0);
+    message.push_back(request.isPath ? 1 : 0);
+    message.push_back(options.propagateSetup ? 1 : 0);
+    message.push_back(static_cast<uint8_t>(options.singleFileFormat ? 
+                                           *options.singleFileFormat : 0));
+    message.push_back(!options.optimize ? serverOptimizeNone :
+                      options.stripImuseSysEx ? serverOptimizeStripImuse :
+                                                serverOptimize);
+    AppendUInt32BE(message, options.extractTrack ? 
+                   static_cast<uint32_t>(*options.extractTrack) : 
+                   serverAllTracks);
+    message.push_back(options.range ? 1 : 0);
+    if (options.range)
+    {
+        AppendBound(message, options.range->start);
+        AppendBound(message, options.range->end);
+    }
+
+    AppendUInt16BE(message, static_cast<uint16_t>(request.name.size()));
+    message.insert(message.end(), request.name.begin(), request.name.end());
+    if (!request.isPath && request.data.size > 0)
+    {
+        message.insert(message.end(), request.data.data, 
+                       request.data.data + request.data.size);
+    }
+
+    WriteUInt32BE(message.data(), static_cast<uint32_t>(message.size() - 4));
+}
+
+bool DecodeServerRequest(ByteSpan body, 
+                         ServerRequest& request, 
+                         std::string& error)
+{
+    MessageReader reader{ body };
+    const uint8_t* fields = reader.Read(9);
+    if (fields == nullptr)
+    {
+        error = "Request is truncated";
+        return false;
+    }
+
+    request = ServerRequest{};
+    request.isPath = fields[0] != 0;
+    request.options.propagateSetup = fields[1] != 0;
+    if (fields[2] != 0)
+        request.options.singleFileFormat = fields[2];
+    request.options.optimize = fields[3] != serverOptimizeNone;
+    request.options.stripImuseSysEx = fields[3] == serverOptimizeStripImuse;
+    uint32_t extractTrack = ReadUInt32BE(fields + 4);
+    if (extractTrack != serverAllTracks)
+        request.options.extractTrack = extractTrack;
+
+    if (fields[8] != 0)
+    {
+        TrackRange range;
+        if (!ReadBound(reader, range.start) || !ReadBound(reader, range.end))
+        {
+            error = "Request is truncated";
+            return false;
+        }
+        request.options.range = range;
+    }
+
+    const uint8_t* nameSize = reader.Read(2);
+    const uint8_t* name = nameSize == nullptr ? 
+        nullptr : reader.Read(ReadUInt16BE(nameSize));
+    if (name == nullptr)
+    {
+        error = "Request is truncated";
+        return false;
+    }
+
+    request.name.assign(reinterpret_cast<const char*>(name), 
+                        ReadUInt16BE(nameSize));
+    if (!request.isPath)
+        request.data = reader.Rest();
+
+    if (request.options.singleFileFormat && 
+        *request.options.singleFileFormat != 1 &&
+        *request.options.singleFileFormat != 2)
+    {
+        error = "The single file MIDI type must be 1 or 2";
+        return false;
+    }
+
+    if (request.options.propagateSetup && request.options.singleFileFormat &&
+        *request.options.singleFileFormat == 1)
+    {
+        error = "The setup can't be propagated in a type 1 MIDI file";
+        return false;
+    }
+
+    return true;
+}
+
+void EncodeServerResponse(const ConversionResult& result, 
+                          std::vector<uint8_t>& message)
+{
+    message.clear();
+    AppendUInt32BE(message, 0);
+    message.push_back(result.succeeded ? 0 : 1);
+    if (!result.succeeded)
+    {
+        message.insert(message.end(), result.error.begin(), 
+                       result.error.end());
+    }
+    else
+    {
+        AppendUInt32BE(message, static_cast<uint32_t>(result.outputs.size()));
+        for (const MemorySink::Output& output : result.outputs)
+        {
+            AppendUInt32BE(message, static_cast<uint32_t>(output.name.size()));
+            message.insert(message.end(), output.name.begin(), 
+                           output.name.end());
+            AppendUInt32BE(message, static_cast<uint32_t>(output.data.size()));
+            message.insert(message.end(), output.data.begin(), 
+                           output.data.end());
+        }
+    }
+
+    WriteUInt32BE(message.data(), static_cast<uint32_t>(message.size() - 4));
+}
+
+bool DecodeServerResponse(ByteSpan body, ConversionResult& result)
+{
+    result = ConversionResult{};
+    MessageReader reader{ body };
+    const uint8_t* status = reader.Read(1);
+    if (status == nullptr)
+        return false;
+
+    result.succeeded = *status == 0;
+    if (!result.succeeded)
+    {
+        ByteSpan error = reader.Rest();
+        result.error.assign(reinterpret_cast<const char*>(error.data), 
+                            error.size);
+        return true;
+    }
+
+    const uint8_t* numFiles = reader.Read(4);
+    if (numFiles == nullptr)
+        return false;
+
+    for (uint32_t i = 0; i < ReadUInt32BE(numFiles); i++)
+    {
+        const uint8_t* nameSize = reader.Read(4);
+        const uint8_t* name = nameSize == nullptr ? 
+            nullptr : reader.Read(ReadUInt32BE(nameSize));
+        const uint8_t* dataSize = name == nullptr ? nullptr : reader.Read(4);
+        const uint8_t* data = dataSize == nullptr ? 
+            nullptr : reader.Read(ReadUInt32BE(dataSize));
+        if (data == nullptr)
+            return false;
+
+        MemorySink::Output output;
+        output.name.assign(reinterpret_cast<const char*>(name), 
+                           ReadUInt32BE(nameSize));
+        output.data.assign(data, data + ReadUInt32BE(dataSize));
+        result.outputs.push_back(std::move(output));
+    }
+
+    return true;
+}
+
+#ifndef _WIN32
+
+bool ReadSocket(int socket, uint8_t* bytes, size_t count)
+{
+    while (count > 0)
+    {
+        ssize_t numRead = recv(socket, bytes, count, 0);
+        if (numRead < 0 && errno == EINTR)
+            continue;
+        if (numRead <= 0)
+            return false;
+
+        bytes += numRead;
+        count -= static_cast<size_t>(numRead);
+    }
+
+    return true;
+}
+
+bool WriteSocket(int socket, const uint8_t* bytes, size_t count)
+{
+    // A client that hangs up early must not take the whole server down 
+    // with SIGPIPE.
+    while (count > 0)
+    {
+        ssize_t numWritten = send(socket, bytes, count, MSG_NOSIGNAL);
+        if (numWritten < 0 && errno == EINTR)
+            continue;
+        if (numWritten <= 0)
+            return false;
+
+        bytes += numWritten;
+        count -= static_cast<size_t>(numWritten);
+    }
+
+    return true;
+}
+
+#else
+
+bool ReadSocket(int, uint8_t*, size_t)
+{
+    return false;
+}
+
+bool WriteSocket(int, const uint8_t*, size_t)
+{
+    return false;
+}
+
+#endif
+
+bool ReadMessage(int socket, std::vector<uint8_t>& body)
+{
+    uint8_t size[4];
+    if (!ReadSocket(socket, size, sizeof(size)) || 
+        ReadUInt32BE(size) > serverMaxMessageSize)
+    {
+        return false;
+    }
+
+    body.resize(ReadUInt32BE(size));
+    return ReadSocket(socket, body.data(), body.size());
+}
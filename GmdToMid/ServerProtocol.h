@@ -0,0 +1,145 @@
+// ServerProtocol.h - Declares the conversion server messages.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SERVER_PROTOCOL_H
+#define SERVER_PROTOCOL_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ByteSpan.h"
+#include "ConversionOptions.h"
+#include "GmdToMid.h"
+
+/// @brief The largest request or response accepted, in bytes.
+///
+/// Every message starts with its size, and this keeps a corrupt or hostile
+/// size from making the reader allocate gigabytes.
+inline constexpr size_t serverMaxMessageSize{ 256 * 1024 * 1024 };
+
+/// @brief The extract track that means every track is exported.
+inline constexpr uint32_t serverAllTracks{ 0xFFFFFFFF };
+
+/// @brief The optimize field of a request that copies the tracks as they are.
+inline constexpr uint8_t serverOptimizeNone{ 0 };
+
+/// @brief The optimize field of a request that optimizes the tracks.
+inline constexpr uint8_t serverOptimize{ 1 };
+
+/// @brief The optimize field of a request that optimizes the tracks and 
+/// strips iMuse SysEx from them.
+inline constexpr uint8_t serverOptimizeStripImuse{ 2 };
+
+/// @brief Represents a request to convert a .gmd file on the server.
+///
+/// Every message, in either direction, starts with its size as a 32-bit 
+/// big endian integer, not counting the size itself. A request follows
+/// with:
+///
+///     uint8       1 if name is a path for the server to read, otherwise 0
+///     uint8       1 to propagate the setup of the first track, otherwise 0
+///     uint8       the single file MIDI type, or 0 for a file per track
+///     uint8       serverOptimizeNone, serverOptimize, or 
+///                 serverOptimizeStripImuse
+///     uint32 BE   the track to extract, or serverAllTracks
+///     uint8       0 for no range, otherwise 1
+///     2 x bound   the start and end of the range, if any, each as:
+///         uint8       1 if the bound is in seconds, 0 if in ticks
+///         uint64 BE   the bits of the bound as an IEEE 754 double
+///     uint16 BE   the length of the name in bytes
+///     bytes       the name, e.g. "song.gmd", or the path to read
+///     bytes       the .gmd file, unless the name is a path
+///
+/// and a response with:
+///
+///     uint8       0 if the file was converted, otherwise 1
+///     bytes       if not converted, the error message
+///     uint32 BE   if converted, the number of .mid files, each framed as
+///                 in StreamSink: name length, name, size, and bytes
+struct ServerRequest
+{
+    /// @brief The name of the .gmd file, which the names of the .mid files
+    /// are derived from, or the path of the file for the server to read.
+    std::string name;
+
+    /// @brief Determines if the name is a path for the server to read, 
+    /// rather than the name of the data sent with the request.
+    bool isPath{ false };
+
+    /// @brief The bytes of the .gmd file, when the name isn't a path.
+    ///
+    /// When encoding, the bytes are borrowed. When decoding, they refer to
+    /// the request that was decoded.
+    ByteSpan data;
+
+    /// @brief The options to convert with.
+    ///
+    /// Only propagateSetup, singleFileFormat, optimize, stripImuseSysEx,
+    /// extractTrack, and range are sent; the server chooses the rest.
+    ConversionOptions options;
+};
+
+/// @brief Encodes a request, including its size.
+/// @param request The request to encode.
+/// @param message The buffer to write the message to.
+void EncodeServerRequest(const ServerRequest& request, 
+                         std::vector<uint8_t>& message);
+
+/// @brief Decodes a request, not including its size.
+/// @param body The body of the request, after its size.
+/// @param request The request to decode into.
+/// @param error Set to a description of the problem if the request is
+/// malformed.
+/// @return true if the request was decoded, otherwise false.
+bool DecodeServerRequest(ByteSpan body, 
+                         ServerRequest& request, 
+                         std::string& error);
+
+/// @brief Encodes a response, including its size.
+/// @param result The result of the conversion.
+/// @param message The buffer to write the message to.
+void EncodeServerResponse(const ConversionResult& result, 
+                          std::vector<uint8_t>& message);
+
+/// @brief Decodes a response, not including its size.
+/// @param body The body of the response, after its size.
+/// @param result The result to decode into.
+/// @return true if the response was decoded, otherwise false.
+bool DecodeServerResponse(ByteSpan body, ConversionResult& result);
+
+/// @brief Reads exactly the specified number of bytes from a socket.
+/// @param socket The socket to read from.
+/// @param bytes The buffer to read into.
+/// @param count The number of bytes to read.
+/// @return true if every byte was read, or false if the socket closed or
+/// failed first.
+bool ReadSocket(int socket, uint8_t* bytes, size_t count);
+
+/// @brief Writes every byte of a buffer to a socket.
+/// @param socket The socket to write to.
+/// @param bytes The bytes to write.
+/// @param count The number of bytes to write.
+/// @return true if every byte was written, otherwise false.
+bool WriteSocket(int socket, const uint8_t* bytes, size_t count);
+
+/// @brief Reads a message from a socket.
+/// @param socket The socket to read from.
+/// @param body The buffer to read the body of the message into.
+/// @return true if a message was read, or false if the socket closed or
+/// failed, or the message was too large.
+bool ReadMessage(int socket, std::vector<uint8_t>& body);
+
+#endif
@@ -0,0 +1,335 @@
+// StreamConverter.cpp - Defines the StreamConverter class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include "ChunkHeader.h"
+#include "GmdFile.h"
+#include "GmdValidator.h"
+#include "MidiFile.h"
+#include "StreamConverter.h"
+
+/// @brief The most chunk data read from the stream at once.
+///
+/// Chunk data is read in blocks of this size so that a corrupt chunk size
+/// can't make us allocate gigabytes before we find out the stream is short.
+inline constexpr size_t streamReadBlockSize{ 1024 * 1024 };
+
+bool StreamConverter::Convert(OutputSink& sink)
+{
+    this->sink = &sink;
+    registry = options.chunkRegistry != nullptr ? 
+        options.chunkRegistry : &ChunkRegistry::BuiltIn();
+    metadata.clear();
+    stats = ConversionStats{};
+    stats.fileName = fileName;
+    error.clear();
+
+    {
+        StageTimer timer{ stats.totalSeconds };
+        stats.succeeded = ConvertStream();
+    }
+
+    stats.inputBytes = position;
+    return stats.succeeded;
+}
+
+bool StreamConverter::ConvertStream()
+{
+    // The GMD header wraps the rest of the file, but since we can't know how
+    // much the stream holds until it ends, its size is only checked then.
+    uint8_t header[chunkHeaderSize];
+    if (Read(header, chunkHeaderSize) < chunkHeaderSize ||
+        ReadUInt32BE(header) != gmdHeaderFourCC)
+    {
+        return Fail("Input file does not appear to be in the GMD format.");
+    }
+
+    size_t expectedSize = ReadUInt32BE(header + 4);
+    stats.bytesRead += chunkHeaderSize;
+
+    size_t trackNum{ 0 };
+    std::vector<uint8_t> buffer;
+    while (true)
+    {
+        Chunk chunk;
+        bool endOfStream{ false };
+        if (!ReadChunk(chunk, buffer, endOfStream))
+            return false;
+        if (endOfStream)
+            break;
+
+        stats.chunkCounts[chunk.id]++;
+
+        switch (chunk.id)
+        {
+            case midiHeaderFourCC:
+                if (chunk.data.size < midiHeaderDataSize)
+                {
+                    std::stringstream message;
+                    message << "MIDI header at offset " << chunk.offset 
+                            << " is too small (" << chunk.data.size 
+                            << " bytes)";
+                    return Fail(message.str());
+                }
+
+                midiHeaderData.format.SetValue(
+                    ReadUInt16BE(chunk.data.data));
+                midiHeaderData.numTracks.SetValue(
+                    ReadUInt16BE(chunk.data.data + 2));
+                midiHeaderData.division.SetValue(
+                    ReadUInt16BE(chunk.data.data + 4));
+                break;
+            case midiTrackFourCC:
+                if (!HandleTrack(trackNum++, chunk, buffer))
+                    return false;
+                break;
+            default:
+                if (!HandleChunk(chunk))
+                    return false;
+                break;
+        }
+    }
+
+    size_t actualSize = position - chunkHeaderSize;
+    if (expectedSize != actualSize)
+    {
+        std::stringstream message;
+        message << "GMD file appears corrupt due to file size mismatch."
+                << std::endl << "Expected Size : " << expectedSize
+                << std::endl << "Actual Size   : " << actualSize;
+        return Fail(message.str());
+    }
+
+    if (options.extractTrack && *options.extractTrack >= trackNum)
+    {
+        std::stringstream message;
+        message << "Cannot extract track " << *options.extractTrack 
+                << " from " << fileName << ", which only contains " 
+                << trackNum << " tracks.";
+        return Fail(message.str());
+    }
+
+    if (options.singleFileFormat)
+        return ExportSingleFile();
+
+    return true;
+}
+
+bool StreamConverter::ReadChunk(Chunk& chunk, 
+                                std::vector<uint8_t>& buffer, 
+                                bool& endOfStream)
+{
+    size_t headerOffset = position;
+    uint8_t header[chunkHeaderSize];
+    size_t headerRead = Read(header, chunkHeaderSize);
+    if (headerRead == 0)
+    {
+        endOfStream = true;
+        return true;
+    }
+    else if (headerRead < chunkHeaderSize)
+    {
+        std::stringstream message;
+        message << "GMD file appears corrupt: Truncated chunk header at "
+                << "offset " << headerOffset << " (" << headerRead 
+                << " bytes remaining)";
+        return Fail(message.str());
+    }
+
+    chunk.id = ReadUInt32BE(header);
+    chunk.offset = headerOffset;
+    size_t dataSize = ReadUInt32BE(header + 4);
+    stats.bytesRead += chunkHeaderSize;
+
+    // Only the chunks we convert or have a handler for are kept; the rest
+    // are read past without being stored, so their data span is left empty.
+    bool isNeeded = chunk.id == midiHeaderFourCC || 
+                    chunk.id == midiTrackFourCC ||
+                    registry->Find(chunk.id) != nullptr;
+    size_t dataRead{ 0 };
+    buffer.clear();
+
+    while (dataRead < dataSize)
+    {
+        size_t blockSize = std::min(dataSize - dataRead, streamReadBlockSize);
+        size_t blockRead;
+        if (isNeeded)
+        {
+            buffer.resize(dataRead + blockSize);
+            blockRead = Read(buffer.data() + dataRead, blockSize);
+        }
+        else
+        {
+            blockRead = Read(nullptr, blockSize);
+        }
+
+        dataRead += blockRead;
+        if (blockRead < blockSize)
+            break;
+    }
+
+    if (dataRead < dataSize)
+    {
+        std::stringstream message;
+        message << "GMD file appears corrupt: Chunk " << chunk.IdString() 
+                << " at offset " << headerOffset << " declares " << dataSize 
+                << " bytes but only " << dataRead << " remain";
+        return Fail(message.str());
+    }
+
+    if (isNeeded)
+    {
+        stats.bytesRead += dataSize;
+        chunk.data = ByteSpan{ buffer.data(), dataSize };
+    }
+
+    return true;
+}
+
+bool StreamConverter::HandleChunk(const Chunk& chunk)
+{
+    const ChunkHandler* handler = registry->Find(chunk.id);
+    if (handler == nullptr)
+        return true;
+
+    ChunkMetadata chunkMetadata{ chunk.id, chunk.offset, {} };
+    std::string handlerError;
+    if (!(*handler)(chunk, chunkMetadata, handlerError))
+    {
+        std::stringstream message;
+        message << "Unable to decode chunk " << chunk.IdString() 
+                << " at offset " << chunk.offset << ": " << handlerError;
+        return Fail(message.str());
+    }
+
+    metadata.push_back(std::move(chunkMetadata));
+    return true;
+}
+
+size_t StreamConverter::Read(uint8_t* bytes, size_t count)
+{
+    if (bytes != nullptr)
+        input.read(reinterpret_cast<char*>(bytes), count);
+    else
+        input.ignore(static_cast<std::streamsize>(count));
+
+    size_t numRead = static_cast<size_t>(input.gcount());
+    position += numRead;
+    return numRead;
+}
+
+bool StreamConverter::HandleTrack(size_t trackNum, 
+                                  const Chunk& chunk,
+                                  std::vector<uint8_t>& trackData)
+{
+    // Each track is checked before anything is written for it, though the
+    // tracks before it may already have been.
+    {
+        StageTimer timer{ stats.parseSeconds };
+        std::string validateError;
+        if (!ValidateTrack(trackNum, chunk, validateError))
+            return Fail(validateError);
+    }
+
+    ByteSpan track{ trackData.data(), trackData.size() };
+
+    // The first track always arrives before the tracks that need its setup,
+    // so the prelude is ready by the time any of them are exported. A file
+    // with a single track needs no prelude, so a first track that can't be
+    // read only fails the conversion once a second track turns up.
+    bool needsSetup = !options.extractTrack || *options.extractTrack > 0;
+    if (trackNum == 0 && options.propagateSetup && needsSetup)
+    {
+        StageTimer timer{ stats.parseSeconds };
+        exporter.BuildSetupPrelude(track, setupError);
+    }
+
+    if (options.extractTrack && trackNum != *options.extractTrack)
+        return true;
+
+    if (trackNum > 0 && !setupError.empty())
+        return Fail(setupError);
+
+    PreparedTrack prepared;
+    prepared.data = track;
+    std::string exportError;
+    bool isPrepared = exporter.Prepare(trackNum, prepared, exportError);
+    stats.parseSeconds += prepared.parseSeconds;
+    stats.bytesOptimized += prepared.bytesOptimized;
+    if (!isPrepared)
+        return Fail(exportError);
+
+    if (options.singleFileFormat)
+    {
+        // Moving the vector keeps its data where it is, so a track that 
+        // still borrows it stays valid, and the buffer for the next chunk 
+        // starts out empty instead of being overwritten.
+        if (prepared.storage.empty())
+        {
+            prepared.storage = std::move(trackData);
+            trackData = std::vector<uint8_t>{};
+        }
+        pendingTracks.push_back(std::move(prepared));
+        return true;
+    }
+
+    std::string exportName = ExportName("-" + std::to_string(trackNum));
+    ExportedFile file;
+    bool written = exporter.WriteTrack(*sink, exportName, prepared, file, 
+                                       exportError);
+    stats.writeSeconds += file.writeSeconds;
+    stats.bytesWritten += file.bytesWritten;
+    if (!written)
+        return Fail(exportError);
+
+    stats.filesWritten++;
+    return true;
+}
+
+bool StreamConverter::ExportSingleFile()
+{
+    ExportedFile file;
+    std::string exportError;
+    bool written = exporter.WriteSingleFile(*sink, ExportName(""), 
+                                            pendingTracks, file, exportError);
+    stats.writeSeconds += file.writeSeconds;
+    stats.bytesWritten += file.bytesWritten;
+    if (!written)
+        return Fail(exportError);
+
+    stats.filesWritten++;
+    return true;
+}
+
+bool StreamConverter::Fail(const std::string& message)
+{
+    if (error.empty())
+        error = message;
+
+    if (options.printErrors)
+        std::cerr << message << std::endl;
+
+    return false;
+}
+
+std::string StreamConverter::ExportName(const std::string& suffix) const
+{
+    std::filesystem::path gmdPath{ fileName };
+    return gmdPath.stem().string() + suffix + ".mid";
+}
@@ -0,0 +1,139 @@
+// StreamConverter.h - Declares the StreamConverter class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STREAM_CONVERTER_H
+#define STREAM_CONVERTER_H
+
+#include <istream>
+#include <string>
+#include <vector>
+#include "ChunkRegistry.h"
+#include "ConversionOptions.h"
+#include "ConversionStats.h"
+#include "GmdReader.h"
+#include "MidiHeaderData.h"
+#include "OutputSink.h"
+#include "TrackExporter.h"
+
+/// @brief Converts a .gmd file read from a stream, such as standard input.
+///
+/// Unlike GmdFile, which maps the whole file and indexes it up front, the
+/// stream is read one chunk at a time and never needs to be seekable or of
+/// a known size. Each track is exported as soon as it has been read, and
+/// chunks that aren't needed are skipped without being stored, so only one
+/// track is held in memory at a time. The exception is exporting every 
+/// track into a single MIDI file, which has to hold every track until the
+/// end of the stream.
+///
+/// Every ConversionOption except parallelTracks and outputDirectory is
+/// supported, and nothing is ever printed to standard output.
+class StreamConverter
+{
+public:
+    /// @brief Constructor; creates a new StreamConverter.
+    /// @param input The binary stream to read the .gmd file from.
+    /// @param fileName The name of the .gmd file, which the names of the
+    /// .mid files are derived from.
+    /// @param options The options that control the conversion.
+    StreamConverter(std::istream& input, 
+                    std::string fileName, 
+                    ConversionOptions options = {}) :
+        input{ input }, fileName{ fileName }, options{ options }
+    { }
+
+    /// @brief Converts the stream, handing each .mid file to the given sink.
+    /// @param sink The sink to write the .mid files to.
+    /// @return true if the conversion was successful, otherwise false.
+    bool Convert(OutputSink& sink);
+
+    /// @brief Gets the timings and counters from the conversion.
+    /// @return The stats of the last call to Convert().
+    const ConversionStats& Stats() const { return stats; }
+
+    /// @brief Gets what the chunk handlers decoded from the stream.
+    /// @return The metadata of every chunk that has a handler, in the order
+    /// the chunks appear in the stream. @see ChunkRegistry
+    const std::vector<ChunkMetadata>& Metadata() const { return metadata; }
+
+    /// @brief Gets a description of the error that stopped the conversion.
+    /// @return The error message, or an empty string if there was no error.
+    const std::string& Error() const { return error; }
+private:
+    std::istream& input;
+    std::string fileName;
+    ConversionOptions options;
+    OutputSink* sink{ nullptr };
+    size_t position{ 0 };
+    MidiHeaderData midiHeaderData;
+    TrackExporter exporter{ options, midiHeaderData };
+    std::vector<PreparedTrack> pendingTracks;
+    const ChunkRegistry* registry{ nullptr };
+    std::vector<ChunkMetadata> metadata;
+    ConversionStats stats;
+    std::string setupError;
+    std::string error;
+
+    /// @brief Converts the stream; Convert() wraps this to time it.
+    /// @return true if the conversion was successful, otherwise false.
+    bool ConvertStream();
+
+    /// @brief Reads the next chunk header and, if needed, its data.
+    /// @param chunk The chunk to read into.
+    /// @param buffer The buffer the chunk data is read into.
+    /// @param endOfStream Set if the stream ended before the chunk header.
+    /// @return true if a chunk was read or the stream ended cleanly.
+    bool ReadChunk(Chunk& chunk, 
+                   std::vector<uint8_t>& buffer, 
+                   bool& endOfStream);
+
+    /// @brief Reads exactly the specified number of bytes.
+    /// @param bytes The bytes to read into, or nullptr to skip them.
+    /// @param count The number of bytes to read.
+    /// @return The number of bytes read, which is less than count only if
+    /// the stream ended.
+    size_t Read(uint8_t* bytes, size_t count);
+
+    /// @brief Exports a track that has just been read.
+    /// @param trackNum The zero-based number of the track.
+    /// @param chunk The MTrk chunk of the track.
+    /// @param trackData The data of the track, which may be taken.
+    /// @return true if the track was exported or queued, otherwise false.
+    bool HandleTrack(size_t trackNum,
+                     const Chunk& chunk,
+                     std::vector<uint8_t>& trackData);
+
+    /// @brief Passes a chunk that has just been read to its handler, if it
+    /// has one.
+    /// @param chunk The chunk, other than the MIDI header or a track.
+    /// @return true if there was no handler or it succeeded.
+    bool HandleChunk(const Chunk& chunk);
+
+    /// @brief Exports every queued track into a single MIDI file.
+    /// @return true if the file was exported, otherwise false.
+    bool ExportSingleFile();
+
+    /// @brief Records an error and prints it if options.printErrors is set.
+    /// @param message The error message.
+    /// @return false, so that callers can return the result directly.
+    bool Fail(const std::string& message);
+
+    /// @brief Gets the name of the .mid file with the specified suffix.
+    /// @param suffix The suffix to add to the .gmd file name's stem.
+    /// @return The name of the .mid file.
+    std::string ExportName(const std::string& suffix) const;
+};
+
+#endif
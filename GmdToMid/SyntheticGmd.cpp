@@ -0,0 +1,157 @@
+// SyntheticGmd.cpp - Defines functions for generating synthetic .gmd files.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstring>
+#include <fstream>
+#include <random>
+#include "ByteSpan.h"
+#include "ChunkHeader.h"
+#include "GmdFile.h"
+#include "MidiEvent.h"
+#include "MidiFile.h"
+#include "SyntheticGmd.h"
+
+/// @brief The number of notes between each controller or pitch bend.
+static constexpr size_t syntheticNotesPerController{ 16 };
+
+/// @brief Appends a chunk header to a buffer.
+/// @param buffer The buffer to append to.
+/// @param id The 4 character chunk ID.
+/// @param size The size of the chunk data.
+static void AppendChunkHeader(std::vector<uint8_t>& buffer, 
+                              const char* id, 
+                              size_t size)
+{
+    size_t offset = buffer.size();
+    buffer.resize(offset + chunkHeaderSize);
+    std::memcpy(buffer.data() + offset, id, 4);
+    WriteUInt32BE(buffer.data() + offset + 4, static_cast<uint32_t>(size));
+}
+
+/// @brief Appends the data of a synthetic MIDI track to a buffer.
+/// @param buffer The buffer to append to.
+/// @param options The shape of the track.
+/// @param random The random number generator for the events.
+static void AppendTrackData(std::vector<uint8_t>& buffer,
+                            const SyntheticGmdOptions& options,
+                            std::mt19937& random)
+{
+    size_t start = buffer.size();
+    uint32_t delta = options.eventDensity > 0 ? 
+        static_cast<uint32_t>(syntheticDivision / options.eventDensity) : 0;
+    uint8_t channel = static_cast<uint8_t>(random() % 16);
+
+    // Every track starts with the kind of setup games put at the start of
+    // their tracks: a tempo, an iMuse SysEx message, and a program.
+    const uint8_t setup[] = {
+        0x00, midiMeta, midiMetaTempo, 0x03, 0x07, 0xA1, 0x20,
+        0x00, midiSysEx, 0x05, imuseManufacturerID, 0x00, 0x01, 0x02, 
+        midiSysExEscape,
+        0x00, static_cast<uint8_t>(midiProgramChange | channel), 
+        static_cast<uint8_t>(random() % 128)
+    };
+    buffer.insert(buffer.end(), std::begin(setup), std::end(setup));
+
+    const uint8_t endOfTrack[] = { 0x00, midiMeta, midiMetaEndOfTrack, 0x00 };
+    size_t numNotes{ 0 };
+    while (buffer.size() - start + sizeof(endOfTrack) < options.trackSize)
+    {
+        uint8_t note = static_cast<uint8_t>(36 + random() % 48);
+        uint8_t velocity = static_cast<uint8_t>(1 + random() % 127);
+
+        // A note on and a note on with zero velocity, sharing running status.
+        AppendVarLen(buffer, delta);
+        buffer.push_back(midiNoteOn | channel);
+        buffer.push_back(note);
+        buffer.push_back(velocity);
+        AppendVarLen(buffer, delta);
+        buffer.push_back(note);
+        buffer.push_back(0);
+
+        if (++numNotes % syntheticNotesPerController == 0)
+        {
+            AppendVarLen(buffer, 0);
+            buffer.push_back(midiControlChange | channel);
+            buffer.push_back(static_cast<uint8_t>(1 + random() % 10));
+            buffer.push_back(static_cast<uint8_t>(random() % 128));
+            AppendVarLen(buffer, 0);
+            buffer.push_back(midiPitchBend | channel);
+            buffer.push_back(static_cast<uint8_t>(random() % 128));
+            buffer.push_back(static_cast<uint8_t>(random() % 128));
+        }
+    }
+
+    buffer.insert(buffer.end(), std::begin(endOfTrack), std::end(endOfTrack));
+}
+
+std::vector<uint8_t> GenerateSyntheticGmd(const SyntheticGmdOptions& options)
+{
+    std::mt19937 random{ options.seed };
+    std::vector<uint8_t> buffer;
+    buffer.reserve(chunkHeaderSize * (options.numTracks + 
+                                      options.numUnknownChunks + 2) +
+                   midiHeaderDataSize + 
+                   (options.trackSize + 64) * options.numTracks +
+                   options.unknownChunkSize * options.numUnknownChunks);
+
+    // The size of the GMD header is filled in once the rest is generated.
+    AppendChunkHeader(buffer, gmdHeaderID, 0);
+
+    AppendChunkHeader(buffer, midiHeaderID, midiHeaderDataSize);
+    uint8_t headerData[midiHeaderDataSize];
+    WriteUInt16BE(headerData, midiType2ID);
+    WriteUInt16BE(headerData + 2, static_cast<uint16_t>(options.numTracks));
+    WriteUInt16BE(headerData + 4, syntheticDivision);
+    buffer.insert(buffer.end(), headerData, headerData + midiHeaderDataSize);
+
+    size_t numUnknownWritten{ 0 };
+    for (size_t trackNum = 0; trackNum <= options.numTracks; trackNum++)
+    {
+        // Spread the unknown chunks evenly over the gaps before, between,
+        // and after the tracks.
+        size_t numUnknownDue = options.numUnknownChunks * (trackNum + 1) /
+                               (options.numTracks + 1);
+        for (; numUnknownWritten < numUnknownDue; numUnknownWritten++)
+        {
+            AppendChunkHeader(buffer, syntheticUnknownID, 
+                              options.unknownChunkSize);
+            for (size_t i = 0; i < options.unknownChunkSize; i++)
+                buffer.push_back(static_cast<uint8_t>(random()));
+        }
+
+        if (trackNum == options.numTracks)
+            break;
+
+        size_t headerOffset = buffer.size();
+        AppendChunkHeader(buffer, midiTrackID, 0);
+        AppendTrackData(buffer, options, random);
+        WriteUInt32BE(buffer.data() + headerOffset + 4, static_cast<uint32_t>(
+            buffer.size() - headerOffset - chunkHeaderSize));
+    }
+
+    WriteUInt32BE(buffer.data() + 4, 
+                  static_cast<uint32_t>(buffer.size() - chunkHeaderSize));
+    return buffer;
+}
+
+bool WriteSyntheticGmd(const std::string& fileName, 
+                       const SyntheticGmdOptions& options)
+{
+    std::vector<uint8_t> data = GenerateSyntheticGmd(options);
+    std::ofstream stream{ fileName, std::ios::binary };
+    stream.write(reinterpret_cast<const char*>(data.data()), data.size());
+    return static_cast<bool>(stream);
+}
@@ -0,0 +1,77 @@
+// SyntheticGmd.h - Declares functions for generating synthetic .gmd files.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SYNTHETIC_GMD_H
+#define SYNTHETIC_GMD_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// @brief The chunk ID given to the chunks GmdToMid doesn't know about.
+inline const char* syntheticUnknownID{ "Junk" };
+
+/// @brief The division (PPQN) written to the MIDI header.
+inline constexpr uint16_t syntheticDivision{ 480 };
+
+/// @brief Describes the shape of a synthetic .gmd file.
+struct SyntheticGmdOptions
+{
+    /// @brief The number of MIDI tracks in the file.
+    size_t numTracks{ 2 };
+
+    /// @brief The approximate size of each track in bytes.
+    ///
+    /// Events are added until the track reaches this size, so each track is
+    /// at most a few bytes larger.
+    size_t trackSize{ 1024 };
+
+    /// @brief The number of chunks with an ID GmdToMid doesn't recognize.
+    ///
+    /// These are spread evenly between the tracks, the same way games place
+    /// their own chunks between the MIDI data.
+    size_t numUnknownChunks{ 1 };
+
+    /// @brief The size of each unknown chunk in bytes.
+    size_t unknownChunkSize{ 16 };
+
+    /// @brief The number of events per quarter note.
+    ///
+    /// Higher densities mean smaller delta times, so the same track size
+    /// covers less time. A density of 0 places every event at the same tick.
+    size_t eventDensity{ 4 };
+
+    /// @brief The seed for the random notes, velocities, and controllers.
+    uint32_t seed{ 1 };
+};
+
+/// @brief Generates the bytes of a synthetic .gmd file.
+/// @param options The shape of the file to generate.
+/// @return The bytes of the entire file.
+///
+/// The tracks use running status, controllers, pitch bends, meta events, and
+/// iMuse SysEx messages so that they exercise the same paths as real files.
+/// The same options always generate the same bytes.
+std::vector<uint8_t> GenerateSyntheticGmd(const SyntheticGmdOptions& options);
+
+/// @brief Generates a synthetic .gmd file and writes it to disk.
+/// @param fileName The name of the file to write.
+/// @param options The shape of the file to generate.
+/// @return true if the file was written, otherwise false.
+bool WriteSyntheticGmd(const std::string& fileName, 
+                       const SyntheticGmdOptions& options);
+
+#endif
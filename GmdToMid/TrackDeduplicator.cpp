@@ -0,0 +1,143 @@
+// TrackDeduplicator.cpp - Defines the TrackDeduplicator class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <fstream>
+#include <tuple>
+#include "Hash.h"
+#include "Json.h"
+#include "TrackDeduplicator.h"
+
+/// @brief The seed of the second hash of the track data.
+inline constexpr uint64_t trackKeySeed2{ 0x6A09E667F3BCC908ULL };
+
+bool TrackKey::operator<(const TrackKey& other) const
+{
+    return std::tie(dataHash, dataHash2, preludeHash, size, division) <
+           std::tie(other.dataHash, other.dataHash2, other.preludeHash, 
+                    other.size, other.division);
+}
+
+TrackKey TrackDeduplicator::KeyOf(ByteSpan track, 
+                                  ByteSpan prelude, 
+                                  uint16_t division)
+{
+    TrackKey key;
+    key.dataHash = Xxh64(track);
+    key.dataHash2 = Xxh64(track, trackKeySeed2);
+    key.preludeHash = Xxh64(prelude);
+    key.size = track.size;
+    key.division = division;
+    return key;
+}
+
+bool TrackDeduplicator::Claim(const TrackKey& key, 
+                              const std::string& path, 
+                              std::string& canonicalPath)
+{
+    std::unique_lock<std::mutex> lock{ mutex };
+    auto [it, inserted] = canonicals.try_emplace(key, Canonical{ path });
+    if (inserted)
+        return true;
+
+    finished.wait(lock, [&] { return it->second.state != State::Writing; });
+    if (it->second.state == State::Failed)
+    {
+        it->second = Canonical{ path };
+        return true;
+    }
+
+    canonicalPath = it->second.path;
+    return false;
+}
+
+void TrackDeduplicator::Finish(const TrackKey& key, bool written)
+{
+    {
+        std::lock_guard<std::mutex> lock{ mutex };
+        canonicals[key].state = written ? State::Written : State::Failed;
+    }
+
+    finished.notify_all();
+}
+
+void TrackDeduplicator::Record(const std::string& gmdFile, 
+                               size_t trackNum,
+                               const std::string& output, 
+                               const std::string& canonical,
+                               uint64_t bytes)
+{
+    std::lock_guard<std::mutex> lock{ mutex };
+    manifest.push_back(ManifestEntry{ gmdFile, trackNum, output, canonical, 
+                                      bytes });
+}
+
+uint64_t TrackDeduplicator::NumDuplicates() const
+{
+    std::lock_guard<std::mutex> lock{ mutex };
+    return std::count_if(manifest.begin(), manifest.end(), 
+                         [](const ManifestEntry& entry) 
+                         { 
+                             return entry.output != entry.canonical; 
+                         });
+}
+
+uint64_t TrackDeduplicator::BytesSaved() const
+{
+    std::lock_guard<std::mutex> lock{ mutex };
+    uint64_t bytesSaved{ 0 };
+    for (const ManifestEntry& entry : manifest)
+    {
+        if (entry.output != entry.canonical)
+            bytesSaved += entry.bytes;
+    }
+    return bytesSaved;
+}
+
+bool TrackDeduplicator::WriteManifest(const std::string& fileName) const
+{
+    std::vector<ManifestEntry> entries;
+    {
+        std::lock_guard<std::mutex> lock{ mutex };
+        entries = manifest;
+    }
+
+    std::sort(entries.begin(), entries.end(), 
+              [](const ManifestEntry& a, const ManifestEntry& b)
+              {
+                  return std::tie(a.gmdFile, a.trackNum) < 
+                         std::tie(b.gmdFile, b.trackNum);
+              });
+
+    std::ofstream stream{ fileName };
+    stream << "{\"linked\":" << (linkDuplicates ? "true" : "false")
+           << ",\"tracks\":[";
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        const ManifestEntry& entry = entries[i];
+        stream << (i > 0 ? "," : "") << "\n{\"file\":" 
+               << JsonString(entry.gmdFile)
+               << ",\"track\":" << entry.trackNum
+               << ",\"output\":" << JsonString(entry.output)
+               << ",\"canonical\":" << JsonString(entry.canonical)
+               << ",\"duplicate\":" 
+               << (entry.output != entry.canonical ? "true" : "false")
+               << ",\"bytes\":" << entry.bytes << "}";
+    }
+    stream << "]}" << std::endl;
+
+    return !stream.fail();
+}
@@ -0,0 +1,151 @@
+// TrackDeduplicator.h - Declares the TrackDeduplicator class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TRACK_DEDUPLICATOR_H
+#define TRACK_DEDUPLICATOR_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ByteSpan.h"
+
+/// @brief Identifies the contents of an exported track.
+///
+/// Two tracks only produce the same .mid file if their data, prelude, and
+/// division all match, so all three are part of the key. The track data is
+/// hashed twice with different seeds, so a collision would need both 64-bit
+/// hashes and the size to match.
+struct TrackKey
+{
+    uint64_t dataHash{ 0 };
+    uint64_t dataHash2{ 0 };
+    uint64_t preludeHash{ 0 };
+    uint64_t size{ 0 };
+    uint16_t division{ 0 };
+
+    bool operator<(const TrackKey& other) const;
+};
+
+/// @brief Finds tracks that are identical to one already exported, so that
+/// they can be linked to or referenced instead of written again.
+///
+/// One deduplicator is shared by every file in a run, so identical tracks
+/// are found both within and across files. The first track with a given
+/// key is written as normal and becomes the canonical output; every later
+/// copy is hard linked to it, or, when links are turned off, only recorded
+/// in the manifest. The manifest maps every (file, track) pair to its
+/// canonical output.
+class TrackDeduplicator
+{
+public:
+    /// @brief Constructor; creates a new TrackDeduplicator.
+    /// @param linkDuplicates Determines if duplicates are hard linked to 
+    /// their canonical output, or only recorded in the manifest.
+    TrackDeduplicator(bool linkDuplicates) : linkDuplicates{ linkDuplicates }
+    { }
+
+    /// @brief Computes the key of a track.
+    /// @param track The track data.
+    /// @param prelude The events added to the start of the track, if any.
+    /// @param division The division of the MIDI file.
+    /// @return The key of the track.
+    static TrackKey KeyOf(ByteSpan track, ByteSpan prelude, uint16_t division);
+
+    /// @brief Claims the key for an output, unless it already has one.
+    /// @param key The key of the track.
+    /// @param path The path the track would be written to.
+    /// @param canonicalPath Set to the canonical output if the key has one.
+    /// @return true if the caller must write the track and then call 
+    /// Finish(), or false if it is a duplicate of canonicalPath.
+    ///
+    /// If another thread is still writing the canonical output, this waits
+    /// until it has finished. If that write fails, the caller takes over.
+    bool Claim(const TrackKey& key, 
+               const std::string& path, 
+               std::string& canonicalPath);
+
+    /// @brief Finishes writing the canonical output of a claimed key.
+    /// @param key The key that was claimed.
+    /// @param written Determines if the output was written successfully.
+    void Finish(const TrackKey& key, bool written);
+
+    /// @brief Adds a track to the manifest.
+    /// @param gmdFile The name of the .gmd file the track came from.
+    /// @param trackNum The zero-based number of the track.
+    /// @param output The path the track was, or would have been, written to.
+    /// @param canonical The path of the canonical output of the track.
+    /// @param bytes The size of the .mid file in bytes.
+    void Record(const std::string& gmdFile, 
+                size_t trackNum,
+                const std::string& output, 
+                const std::string& canonical,
+                uint64_t bytes);
+
+    /// @brief Determines if duplicates are hard linked to their canonical
+    /// output.
+    /// @return true if duplicates are linked, false if only referenced.
+    bool LinkDuplicates() const { return linkDuplicates; }
+
+    /// @brief Gets the number of tracks that were duplicates.
+    /// @return The number of duplicate tracks.
+    uint64_t NumDuplicates() const;
+
+    /// @brief Gets the number of bytes that weren't written thanks to
+    /// duplicates.
+    /// @return The number of bytes saved.
+    uint64_t BytesSaved() const;
+
+    /// @brief Writes the manifest as JSON.
+    /// @param fileName The name of the file to write.
+    /// @return true if the manifest was written, otherwise false.
+    ///
+    /// The tracks are sorted by file and track number, so the manifest is
+    /// the same however the files were scheduled.
+    bool WriteManifest(const std::string& fileName) const;
+private:
+    enum class State
+    {
+        Writing,
+        Written,
+        Failed
+    };
+
+    struct Canonical
+    {
+        std::string path;
+        State state{ State::Writing };
+    };
+
+    struct ManifestEntry
+    {
+        std::string gmdFile;
+        size_t trackNum{ 0 };
+        std::string output;
+        std::string canonical;
+        uint64_t bytes{ 0 };
+    };
+
+    bool linkDuplicates;
+    mutable std::mutex mutex;
+    std::condition_variable finished;
+    std::map<TrackKey, Canonical> canonicals;
+    std::vector<ManifestEntry> manifest;
+};
+
+#endif
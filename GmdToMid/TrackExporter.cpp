@@ -0,0 +1,157 @@
+// TrackExporter.cpp - Defines the TrackExporter class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ConversionStats.h"
+#include "EventArena.h"
+#include "EventStore.h"
+#include "MidiFile.h"
+#include "MidiState.h"
+#include "SeekIndex.h"
+#include "TrackExporter.h"
+#include "TrackOptimizer.h"
+
+bool TrackExporter::BuildSetupPrelude(ByteSpan firstTrack, std::string& error)
+{
+    setupPrelude.clear();
+
+    EventArena arena;
+    EventStore events;
+    if (!events.Decode(firstTrack, arena))
+    {
+        error = "Unable to read the setup from the first track: " + 
+                events.Error();
+        return false;
+    }
+
+    MidiState state;
+    state.ApplySetup(events);
+    state.AppendPrelude(setupPrelude);
+    return true;
+}
+
+bool TrackExporter::Prepare(size_t trackNum, 
+                            PreparedTrack& track, 
+                            std::string& error) const
+{
+    StageTimer timer{ track.parseSeconds };
+
+    // The first track is where the setup comes from, so it never needs it.
+    if (trackNum > 0)
+        track.prelude = SetupPrelude();
+
+    // A segment is exported exactly like a whole track would be, so it can
+    // still be deduplicated against other segments.
+    if (options.range)
+    {
+        std::vector<uint8_t> segment;
+        std::string extractError;
+        if (!ExtractRange(track.data, header.division.Value(), 
+                          *options.range, segment, extractError))
+        {
+            error = "Track " + std::to_string(trackNum) + ": " + extractError;
+            return false;
+        }
+
+        // The data may still be in the storage being replaced, so it is
+        // only replaced once the segment is complete.
+        track.storage = std::move(segment);
+        track.data = ByteSpan{ track.storage.data(), track.storage.size() };
+    }
+
+    if (options.optimize)
+    {
+        // The tracks of a type 1 file play together, so an event one track
+        // repeats may undo a change another track made in the meantime.
+        bool dropRedundant = options.singleFileFormat != midiType1ID;
+        TrackOptimizer optimizer{ dropRedundant, options.stripImuseSysEx };
+        std::vector<uint8_t> optimized;
+        if (!optimizer.Optimize(track.prelude, track.data, optimized))
+        {
+            error = "Track " + std::to_string(trackNum) + ": " + 
+                    optimizer.Error();
+            return false;
+        }
+
+        // The prelude is now part of the track, so it isn't added again
+        // when the track is written.
+        track.bytesOptimized = track.prelude.size + track.data.size - 
+                               optimized.size();
+        track.storage = std::move(optimized);
+        track.data = ByteSpan{ track.storage.data(), track.storage.size() };
+        track.prelude = ByteSpan{};
+    }
+
+    return true;
+}
+
+bool TrackExporter::WriteTrack(OutputSink& sink, 
+                               const std::string& name,
+                               const PreparedTrack& track,
+                               ExportedFile& file,
+                               std::string& error) const
+{
+    MidiFile exportFile{ sink, name, header.division };
+    bool written;
+    {
+        StageTimer timer{ file.writeSeconds };
+        written = exportFile.WriteTrack(track.data, track.prelude);
+    }
+
+    file.bytesWritten = exportFile.BytesWritten();
+    if (!written)
+    {
+        error = "Unable to write " + sink.PathOf(name);
+        return false;
+    }
+
+    return true;
+}
+
+bool TrackExporter::WriteSingleFile(OutputSink& sink, 
+                                    const std::string& name,
+                                    const std::vector<PreparedTrack>& tracks,
+                                    ExportedFile& file,
+                                    std::string& error) const
+{
+    if (tracks.size() > midiMaxTracks)
+    {
+        error = "Too many tracks to fit in a single MIDI file: " +
+                std::to_string(tracks.size());
+        return false;
+    }
+
+    MidiFile exportFile{ sink, 
+                         name, 
+                         static_cast<int>(*options.singleFileFormat), 
+                         header.division };
+    for (const PreparedTrack& track : tracks)
+        exportFile.AddTrack(track.data, track.prelude);
+
+    bool written;
+    {
+        StageTimer timer{ file.writeSeconds };
+        written = exportFile.Write();
+    }
+
+    file.bytesWritten = exportFile.BytesWritten();
+    if (!written)
+    {
+        error = "Unable to write " + sink.PathOf(name);
+        return false;
+    }
+
+    return true;
+}
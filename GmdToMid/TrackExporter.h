@@ -0,0 +1,144 @@
+// TrackExporter.h - Declares the TrackExporter class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TRACK_EXPORTER_H
+#define TRACK_EXPORTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ByteSpan.h"
+#include "ConversionOptions.h"
+#include "MidiHeaderData.h"
+#include "OutputSink.h"
+
+/// @brief Represents a track that is ready to be written to a .mid file.
+struct PreparedTrack
+{
+    /// @brief The events of the track, excluding the chunk header.
+    ///
+    /// Until the track is prepared this is the track as it is in the .gmd
+    /// file, which is only borrowed. Once it is cut or re-encoded, it refers
+    /// to storage instead.
+    ByteSpan data;
+
+    /// @brief Events to write at the start of the track, if any.
+    ByteSpan prelude;
+
+    /// @brief Holds the events of the track once they no longer come from
+    /// the .gmd file.
+    std::vector<uint8_t> storage;
+
+    /// @brief The time spent cutting and re-encoding the track, in seconds.
+    double parseSeconds{ 0 };
+
+    /// @brief The number of bytes the track shrank by when it was 
+    /// re-encoded.
+    uint64_t bytesOptimized{ 0 };
+};
+
+/// @brief Holds what writing a .mid file cost.
+struct ExportedFile
+{
+    /// @brief The time spent writing the file, in seconds.
+    double writeSeconds{ 0 };
+
+    /// @brief The number of bytes written.
+    size_t bytesWritten{ 0 };
+};
+
+/// @brief Takes each track of a .gmd file through the steps that turn it
+/// into a track of a .mid file, and writes the .mid files.
+///
+/// A track gets the setup prelude from the first track, is cut down to
+/// ConversionOptions::range, and is then re-encoded by the TrackOptimizer,
+/// in that order, depending on the options. GmdFile and StreamConverter
+/// read the tracks in different ways but both export them through this 
+/// class, so every conversion treats a track the same way.
+///
+/// Once the setup prelude is built, the exporter is only read from, so 
+/// tracks can be prepared and written from several threads at once.
+class TrackExporter
+{
+public:
+    /// @brief Constructor; creates a new TrackExporter.
+    /// @param options The options of the conversion.
+    /// @param header The MIDI header of the .gmd file, which is read each
+    /// time a track is exported and must outlive the exporter.
+    TrackExporter(const ConversionOptions& options, 
+                  const MidiHeaderData& header) :
+        options{ options }, header{ header }
+    { }
+
+    TrackExporter(const TrackExporter&) = delete;
+    TrackExporter& operator=(const TrackExporter&) = delete;
+
+    /// @brief Builds the setup prelude added to the transition tracks from
+    /// the first track. @see MidiState
+    /// @param firstTrack The events of the first track.
+    /// @param error Set to the reason if the first track can't be read.
+    /// @return true if the prelude was built, otherwise false.
+    bool BuildSetupPrelude(ByteSpan firstTrack, std::string& error);
+
+    /// @brief Gets the setup prelude built by BuildSetupPrelude().
+    /// @return The prelude, which is empty if it wasn't built.
+    ByteSpan SetupPrelude() const
+    {
+        return ByteSpan{ setupPrelude.data(), setupPrelude.size() };
+    }
+
+    /// @brief Prepares a track to be written.
+    /// @param trackNum The number of the track in the .gmd file.
+    /// @param track The track, with data set to its events.
+    /// @param error Set to the reason if the track can't be prepared.
+    /// @return true if the track was prepared, otherwise false.
+    bool Prepare(size_t trackNum, PreparedTrack& track, 
+                 std::string& error) const;
+
+    /// @brief Writes a prepared track as a type 0 .mid file.
+    /// @param sink The sink to write the file to.
+    /// @param name The name of the file.
+    /// @param track The track.
+    /// @param file Set to what writing the file cost.
+    /// @param error Set to the reason if the file can't be written.
+    /// @return true if the file was written, otherwise false.
+    bool WriteTrack(OutputSink& sink, 
+                    const std::string& name,
+                    const PreparedTrack& track,
+                    ExportedFile& file,
+                    std::string& error) const;
+
+    /// @brief Writes prepared tracks as a single .mid file of the type 
+    /// given by ConversionOptions::singleFileFormat.
+    /// @param sink The sink to write the file to.
+    /// @param name The name of the file.
+    /// @param tracks The tracks, in order.
+    /// @param file Set to what writing the file cost.
+    /// @param error Set to the reason if the file can't be written.
+    /// @return true if the file was written, otherwise false.
+    bool WriteSingleFile(OutputSink& sink, 
+                         const std::string& name,
+                         const std::vector<PreparedTrack>& tracks,
+                         ExportedFile& file,
+                         std::string& error) const;
+private:
+    const ConversionOptions& options;
+    const MidiHeaderData& header;
+    std::vector<uint8_t> setupPrelude;
+};
+
+#endif
@@ -0,0 +1,249 @@
+// TrackOptimizer.cpp - Defines the TrackOptimizer class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include "MidiEvent.h"
+#include "MidiState.h"
+#include "TrackOptimizer.h"
+
+/// @brief The largest delta time a variable length quantity can hold.
+static constexpr uint32_t midiMaxVarLenValue{ 0x0FFFFFFF };
+
+/// @brief Controller numbers with special meaning to the optimizer.
+enum OptimizerController : uint8_t
+{
+    ccBankSelectMsb = 0,
+    ccDataEntryMsb = 6,
+    ccBankSelectLsb = 32,
+    ccDataEntryLsb = 38,
+    ccDataIncrement = 96,
+    ccRpnMsb = 101,
+    ccFirstChannelMode = 120,
+    ccResetAllControllers = 121
+};
+
+/// @brief Holds the values a channel has been set to by a track so far.
+struct OptimizerChannel
+{
+    /// @brief Indicates a value that no event has set yet.
+    static constexpr int32_t unset{ -1 };
+
+    int32_t controllers[midiNumControllers];
+    int32_t program;
+    int32_t programBankMsb;
+    int32_t programBankLsb;
+    int32_t pitchBend;
+    int32_t channelPressure;
+
+    /// @brief Forgets every value, so that the next event setting each one
+    /// is kept.
+    void Reset()
+    {
+        std::fill(std::begin(controllers), std::end(controllers), unset);
+        program = unset;
+        programBankMsb = unset;
+        programBankLsb = unset;
+        pitchBend = unset;
+        channelPressure = unset;
+    }
+};
+
+/// @brief Determines if a controller only ever holds a plain value, so 
+/// that setting it to the value it already has changes nothing.
+/// @param controller The controller number.
+/// @return false for data entry, the parameter selectors and increments,
+/// and the channel mode messages, otherwise true.
+static bool IsPlainController(uint8_t controller)
+{
+    if (controller >= ccFirstChannelMode)
+        return false;
+    if (controller >= ccDataIncrement && controller <= ccRpnMsb)
+        return false;
+
+    return controller != ccDataEntryMsb && controller != ccDataEntryLsb;
+}
+
+/// @brief Updates a channel with an event and determines if the event 
+/// changed nothing.
+/// @param channel The channel the event is sent on.
+/// @param command The command of the event.
+/// @param data The data bytes of the event.
+/// @return true if the channel already had the value the event sets.
+static bool ApplyChannelEvent(OptimizerChannel& channel, 
+                              uint8_t command, 
+                              ByteSpan data)
+{
+    int32_t value;
+    switch (command)
+    {
+        case midiControlChange:
+        {
+            uint8_t controller = data.data[0] & 0x7F;
+            if (controller == ccResetAllControllers)
+            {
+                // Which controllers a reset affects differs between 
+                // synthesizers, so we assume the worst.
+                channel.Reset();
+                return false;
+            }
+            if (!IsPlainController(controller))
+                return false;
+            if (channel.controllers[controller] == data.data[1])
+                return true;
+            channel.controllers[controller] = data.data[1];
+            return false;
+        }
+        case midiProgramChange:
+            if (channel.program == data.data[0] && 
+                channel.programBankMsb == 
+                channel.controllers[ccBankSelectMsb] &&
+                channel.programBankLsb == channel.controllers[ccBankSelectLsb])
+            {
+                return true;
+            }
+            channel.program = data.data[0];
+            channel.programBankMsb = channel.controllers[ccBankSelectMsb];
+            channel.programBankLsb = channel.controllers[ccBankSelectLsb];
+            return false;
+        case midiPitchBend:
+            value = data.data[0] | (data.data[1] << 7);
+            if (channel.pitchBend == value)
+                return true;
+            channel.pitchBend = value;
+            return false;
+        case midiChannelPressure:
+            if (channel.channelPressure == data.data[0])
+                return true;
+            channel.channelPressure = data.data[0];
+            return false;
+        default:
+            return false;
+    }
+}
+
+/// @brief Determines if a SysEx event is a complete iMuse message.
+/// @param event The event.
+/// @param data The data bytes of the event.
+/// @return true if the event holds an entire iMuse SysEx message.
+///
+/// A message split over several packets is never stripped, so that no
+/// continuation packet is left without the start of its message.
+static bool IsCompleteImuseSysEx(const MidiEvent& event, ByteSpan data)
+{
+    return event.status == midiSysEx && IsImuseSysEx(data) && 
+           data.data[data.size - 1] == midiSysExEscape;
+}
+
+bool TrackOptimizer::Optimize(ByteSpan prelude, 
+                              ByteSpan track, 
+                              std::vector<uint8_t>& output)
+{
+    error.clear();
+    output.clear();
+    output.reserve(prelude.size + track.size);
+
+    OptimizerChannel channels[midiNumChannels];
+    for (OptimizerChannel& channel : channels)
+        channel.Reset();
+
+    uint8_t runningStatus{ 0 };
+    auto write = [&](const MidiEvent& event, ByteSpan data, uint32_t delta)
+    {
+        if (!event.IsChannelEvent())
+        {
+            AppendEvent(output, delta, event, data);
+            runningStatus = 0;
+            return;
+        }
+
+        // Most events follow the previous one closely and are notes, so 
+        // their bytes are pushed one at a time rather than inserted.
+        if (delta < 0x80)
+            output.push_back(static_cast<uint8_t>(delta));
+        else
+            AppendVarLen(output, delta);
+
+        if (event.status != runningStatus)
+            output.push_back(event.status);
+        output.push_back(data.data[0]);
+        if (data.size > 1)
+            output.push_back(data.data[1]);
+        runningStatus = event.status;
+    };
+
+    // The delta time of each dropped event is carried over to the next
+    // event. Should that ever make a delta time too long to encode, the
+    // last event that was dropped is written after all, which is harmless
+    // since it changes nothing, and takes the delta carried over so far.
+    uint32_t delta{ 0 };
+    MidiEvent lastDropped;
+    ByteSpan lastDroppedData;
+
+    for (ByteSpan events : { prelude, track })
+    {
+        EventCursor cursor{ events };
+        MidiEvent event;
+        while (cursor.Next(event))
+        {
+            ByteSpan data = events.Subspan(event.dataOffset, 
+                                           event.dataLength);
+            bool redundant = event.IsChannelEvent() && 
+                ApplyChannelEvent(channels[event.Channel()], 
+                                  event.Command(), data);
+            bool stripped = stripImuseSysEx && 
+                            IsCompleteImuseSysEx(event, data);
+
+            // A SysEx message may reset the synthesizer or reprogram a part,
+            // e.g. a GM or GS reset or an iMuse message, and which values it
+            // changes depends on the synthesizer, so we assume the worst, as
+            // for a reset of all controllers. A message we leave out changes
+            // nothing.
+            bool isSysEx = event.status == midiSysEx || 
+                           event.status == midiSysExEscape;
+            if (isSysEx && !stripped)
+            {
+                for (OptimizerChannel& channel : channels)
+                    channel.Reset();
+            }
+
+            if (static_cast<uint64_t>(delta) + event.delta > 
+                midiMaxVarLenValue)
+            {
+                write(lastDropped, lastDroppedData, delta);
+                delta = 0;
+            }
+
+            if ((redundant && dropRedundant) || stripped)
+            {
+                delta += event.delta;
+                lastDropped = event;
+                lastDroppedData = data;
+                continue;
+            }
+
+            write(event, data, delta + event.delta);
+            delta = 0;
+        }
+
+        if (cursor.HasError())
+        {
+            error = cursor.Error();
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,84 @@
+// TrackOptimizer.h - Declares the TrackOptimizer class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TRACK_OPTIMIZER_H
+#define TRACK_OPTIMIZER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ByteSpan.h"
+
+/// @brief Re-encodes MIDI tracks into as few bytes as possible.
+///
+/// GMD tracks are copied into .mid files as they are, so they keep every
+/// explicit status byte and every event that repeats a value the channel
+/// already has. The optimizer decodes a track and writes it out again:
+///
+/// - Channel events use running status whenever the status repeats. Meta
+///   and SysEx events cancel running status, as the standard requires,
+///   even though GMD tracks rely on them not doing so.
+/// - When dropping redundant events, a control change, program change,
+///   pitch bend, or channel pressure that sets the channel to the value it
+///   already has is left out, with its delta time carried over to the next
+///   event. A program change is only left out if the bank is also the one
+///   the program was last selected from, since a bank select only takes
+///   effect at the next program change. Data entry, the parameter 
+///   selectors and increments, and the channel mode messages are always
+///   kept, since they aren't plain values. After a SysEx message or a
+///   reset of all controllers, every value is treated as unknown again.
+/// - When stripping iMuse SysEx, the SysEx messages iMuse uses for its own
+///   hooks and markers, which general MIDI players ignore, are left out.
+///
+/// Redundancy is judged within one track, so it must not be used for the
+/// tracks of a type 1 file, which share their channels as they play.
+class TrackOptimizer
+{
+public:
+    /// @brief Constructor; creates a new TrackOptimizer.
+    /// @param dropRedundant Determines if events that don't change the
+    /// state of their channel are left out.
+    /// @param stripImuseSysEx Determines if iMuse SysEx events are left out.
+    TrackOptimizer(bool dropRedundant, bool stripImuseSysEx) :
+        dropRedundant{ dropRedundant }, stripImuseSysEx{ stripImuseSysEx }
+    { }
+
+    /// @brief Re-encodes a track.
+    /// @param prelude Events to place at the start of the track, if any.
+    /// @param track The data of the MIDI track chunk, excluding its header.
+    /// @param output The buffer to replace the contents of with the 
+    /// re-encoded prelude and track.
+    /// @return true if the track was re-encoded, or false if it is 
+    /// malformed (see Error()).
+    ///
+    /// The prelude is re-encoded along with the track, so that the events
+    /// at the start of the track that repeat the setup in the prelude are
+    /// dropped as well.
+    bool Optimize(ByteSpan prelude, 
+                  ByteSpan track, 
+                  std::vector<uint8_t>& output);
+
+    /// @brief Gets a description of the error that stopped the last track
+    /// from being re-encoded.
+    /// @return The error message, or an empty string if there was no error.
+    const std::string& Error() const { return error; }
+private:
+    bool dropRedundant;
+    bool stripImuseSysEx;
+    std::string error;
+};
+
+#endif
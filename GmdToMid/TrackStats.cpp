@@ -0,0 +1,223 @@
+// TrackStats.cpp - Defines track analysis and its CSV and JSON output.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <iomanip>
+#include <sstream>
+#include "Json.h"
+#include "MidiEvent.h"
+#include "MidiState.h"
+#include "TrackStats.h"
+
+/// @brief Converts a tempo to beats per minute.
+/// @param microsecondsPerQuarter The tempo in microseconds per quarter note.
+/// @return The tempo in beats per minute.
+static double BeatsPerMinute(uint32_t microsecondsPerQuarter)
+{
+    return 60000000.0 / microsecondsPerQuarter;
+}
+
+/// @brief Quotes a string so it can be written as a CSV field, if needed.
+/// @param value The string to quote.
+/// @return The string, quoted if it contains a comma, quote, or newline.
+static std::string CsvString(const std::string& value)
+{
+    if (value.find_first_of(",\"\r\n") == std::string::npos)
+        return value;
+
+    std::string quoted{ "\"" };
+    for (char c : value)
+    {
+        if (c == '"')
+            quoted += '"';
+        quoted += c;
+    }
+
+    quoted += '"';
+    return quoted;
+}
+
+bool AnalyzeTrack(ByteSpan track, 
+                  uint16_t division, 
+                  TrackStats& stats, 
+                  std::string& error)
+{
+    // SMPTE divisions count ticks per frame, so every tick lasts the same
+    // time no matter the tempo.
+    bool isSmpte = (division & 0x8000) != 0;
+    double smpteTicksPerSecond = -static_cast<int8_t>(division >> 8) * 
+                                 static_cast<double>(division & 0xFF);
+
+    double seconds{ 0 };
+    uint32_t lastTick{ 0 };
+    uint32_t tempo{ midiDefaultTempo };
+    auto secondsAt = [&](uint32_t tick)
+    {
+        if (isSmpte)
+            return smpteTicksPerSecond > 0 ? tick / smpteTicksPerSecond : 0.0;
+        if (division == 0)
+            return 0.0;
+        return seconds + static_cast<double>(tick - lastTick) * tempo / 
+                         division / 1000000;
+    };
+
+    EventCursor cursor{ track };
+    MidiEvent event;
+    while (cursor.Next(event))
+    {
+        stats.numEvents++;
+        const uint8_t* data = track.data + event.dataOffset;
+        if (event.IsChannelEvent())
+        {
+            stats.channelMask |= 1 << event.Channel();
+            if (event.Command() == midiNoteOn && data[1] > 0)
+                stats.numNotes++;
+        }
+        else if (event.status == midiMeta)
+        {
+            if (event.metaType == midiMetaMarker)
+            {
+                stats.numMarkers++;
+            }
+            else if (event.metaType == midiMetaTempo && event.dataLength >= 3)
+            {
+                uint32_t newTempo = (data[0] << 16) | (data[1] << 8) | data[2];
+                if (newTempo > 0)
+                {
+                    seconds = secondsAt(event.tick);
+                    lastTick = event.tick;
+                    tempo = newTempo;
+                    stats.tempoMap.push_back(
+                        TempoPoint{ event.tick, seconds, newTempo });
+                }
+            }
+        }
+        else
+        {
+            stats.numSysEx++;
+            if (IsImuseSysEx(ByteSpan{ data, event.dataLength }))
+                stats.numImuseSysEx++;
+        }
+
+        stats.endTick = event.tick;
+    }
+
+    stats.seconds = secondsAt(stats.endTick);
+    if (cursor.HasError())
+    {
+        error = cursor.Error();
+        return false;
+    }
+
+    return true;
+}
+
+void WriteTrackStatsCsvHeader(std::ostream& stream)
+{
+    stream << "file,track,ticks,seconds,events,notes,channels,tempoChanges,"
+           << "tempoMap,sysex,imuseSysex,markers\n";
+}
+
+void WriteTrackStatsCsv(std::ostream& stream, 
+                        const std::string& fileName, 
+                        const std::vector<TrackStats>& tracks)
+{
+    std::stringstream csv;
+    csv << std::fixed;
+    for (const TrackStats& track : tracks)
+    {
+        csv << CsvString(fileName) << ',' << track.trackNum << ','
+            << track.endTick << ',' << std::setprecision(3) << track.seconds 
+            << ',' << track.numEvents << ',' << track.numNotes << ',';
+
+        // Lists within a field are separated by spaces, so they never need
+        // to be quoted. Channels are numbered 1 to 16 and the tempo map is
+        // a list of tick:BPM pairs.
+        const char* separator = "";
+        for (int channel = 0; channel < midiNumChannels; channel++)
+        {
+            if (track.channelMask & (1 << channel))
+            {
+                csv << separator << channel + 1;
+                separator = " ";
+            }
+        }
+
+        csv << ',' << track.tempoMap.size() << ',';
+        separator = "";
+        for (const TempoPoint& point : track.tempoMap)
+        {
+            csv << separator << point.tick << ':' << std::setprecision(2)
+                << BeatsPerMinute(point.microsecondsPerQuarter);
+            separator = " ";
+        }
+
+        csv << ',' << track.numSysEx << ',' << track.numImuseSysEx << ','
+            << track.numMarkers << '\n';
+    }
+
+    stream << csv.str();
+}
+
+void WriteTrackStatsJson(std::ostream& stream, 
+                         const std::string& fileName, 
+                         uint16_t division,
+                         const std::vector<TrackStats>& tracks)
+{
+    // Like --list --json, each file is a single line of JSON.
+    std::stringstream json;
+    json << std::fixed << "{\"file\":" << JsonString(fileName)
+         << ",\"division\":" << division << ",\"tracks\":[";
+
+    for (size_t i = 0; i < tracks.size(); i++)
+    {
+        const TrackStats& track = tracks[i];
+        json << (i > 0 ? "," : "")
+             << "{\"track\":" << track.trackNum
+             << ",\"ticks\":" << track.endTick
+             << ",\"seconds\":" << std::setprecision(3) << track.seconds
+             << ",\"events\":" << track.numEvents
+             << ",\"notes\":" << track.numNotes
+             << ",\"channels\":[";
+
+        const char* separator = "";
+        for (int channel = 0; channel < midiNumChannels; channel++)
+        {
+            if (track.channelMask & (1 << channel))
+            {
+                json << separator << channel + 1;
+                separator = ",";
+            }
+        }
+
+        json << "],\"tempoMap\":[";
+        for (size_t j = 0; j < track.tempoMap.size(); j++)
+        {
+            const TempoPoint& point = track.tempoMap[j];
+            json << (j > 0 ? "," : "")
+                 << "{\"tick\":" << point.tick
+                 << ",\"seconds\":" << std::setprecision(3) << point.seconds
+                 << ",\"bpm\":" << std::setprecision(2) 
+                 << BeatsPerMinute(point.microsecondsPerQuarter) << "}";
+        }
+
+        json << "],\"sysex\":" << track.numSysEx
+             << ",\"imuseSysex\":" << track.numImuseSysEx
+             << ",\"markers\":" << track.numMarkers << "}";
+    }
+
+    json << "]}\n";
+    stream << json.str();
+}
@@ -0,0 +1,110 @@
+// TrackStats.h - Declares the TrackStats struct and track analysis.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TRACK_STATS_H
+#define TRACK_STATS_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "ByteSpan.h"
+
+/// @brief Represents a tempo change within a track.
+struct TempoPoint
+{
+    /// @brief The tick the tempo changes at.
+    uint32_t tick{ 0 };
+
+    /// @brief The time the tempo changes at, in seconds.
+    double seconds{ 0 };
+
+    /// @brief The new tempo, in microseconds per quarter note.
+    uint32_t microsecondsPerQuarter{ 0 };
+};
+
+/// @brief Represents the statistics of a single MIDI track.
+struct TrackStats
+{
+    /// @brief The zero-based number of the track.
+    size_t trackNum{ 0 };
+
+    /// @brief The tick of the last event in the track.
+    uint32_t endTick{ 0 };
+
+    /// @brief The length of the track, in seconds.
+    double seconds{ 0 };
+
+    /// @brief The number of events, including the end of track.
+    uint64_t numEvents{ 0 };
+
+    /// @brief The number of notes, i.e. note ons with a non-zero velocity.
+    uint64_t numNotes{ 0 };
+
+    /// @brief The number of SysEx events, including iMuse events.
+    uint64_t numSysEx{ 0 };
+
+    /// @brief The number of SysEx events specific to iMuse.
+    uint64_t numImuseSysEx{ 0 };
+
+    /// @brief The number of marker meta events.
+    uint64_t numMarkers{ 0 };
+
+    /// @brief A bit for each channel any channel event is sent on.
+    uint16_t channelMask{ 0 };
+
+    /// @brief Every tempo change in the track, in order.
+    std::vector<TempoPoint> tempoMap;
+};
+
+/// @brief Computes the statistics of a track in a single pass.
+/// @param track The data of the MIDI track chunk, excluding its header.
+/// @param division The division from the MIDI header, which converts ticks
+/// to seconds.
+/// @param stats The stats to fill in.
+/// @param error The error message, if the track couldn't be decoded.
+/// @return true if the whole track was decoded, otherwise false.
+///
+/// The events are decoded one at a time and only counted, so nothing is
+/// allocated except for the tempo map.
+bool AnalyzeTrack(ByteSpan track, 
+                  uint16_t division, 
+                  TrackStats& stats, 
+                  std::string& error);
+
+/// @brief Writes the header row of the CSV written by WriteTrackStatsCsv.
+/// @param stream The stream to write to.
+void WriteTrackStatsCsvHeader(std::ostream& stream);
+
+/// @brief Writes the stats of every track in a file as rows of CSV.
+/// @param stream The stream to write to.
+/// @param fileName The name of the .gmd file.
+/// @param tracks The stats of each track.
+void WriteTrackStatsCsv(std::ostream& stream, 
+                        const std::string& fileName, 
+                        const std::vector<TrackStats>& tracks);
+
+/// @brief Writes the stats of every track in a file as a line of JSON.
+/// @param stream The stream to write to.
+/// @param fileName The name of the .gmd file.
+/// @param division The division from the MIDI header.
+/// @param tracks The stats of each track.
+void WriteTrackStatsJson(std::ostream& stream, 
+                         const std::string& fileName, 
+                         uint16_t division,
+                         const std::vector<TrackStats>& tracks);
+
+#endif
@@ -0,0 +1,96 @@
+// WorkerPool.cpp - Defines the WorkerPool class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(size_t numWorkers) : activeJobs{ 0 }, stopping{ false }
+{
+    if (numWorkers == 0)
+        numWorkers = DefaultWorkerCount();
+    numWorkers = std::min(numWorkers, workerPoolMaxWorkers);
+
+    maxQueuedJobs = numWorkers * workerPoolJobsPerWorker;
+
+    for (size_t i = 0; i < numWorkers; i++)
+        workers.emplace_back(&WorkerPool::WorkerLoop, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock{ mutex };
+        stopping = true;
+    }
+
+    jobAvailable.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+void WorkerPool::Submit(std::function<void()> job)
+{
+    std::unique_lock<std::mutex> lock{ mutex };
+    slotAvailable.wait(lock, [this] { return jobs.size() < maxQueuedJobs; });
+    jobs.push_back(std::move(job));
+    lock.unlock();
+    jobAvailable.notify_one();
+}
+
+void WorkerPool::Wait()
+{
+    std::unique_lock<std::mutex> lock{ mutex };
+    idle.wait(lock, [this] { return jobs.empty() && activeJobs == 0; });
+}
+
+void WorkerPool::WorkerLoop()
+{
+    while (true)
+    {
+        std::unique_lock<std::mutex> lock{ mutex };
+        jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+        // We drain the queue before stopping so that destroying the pool
+        // never silently drops work that has already been submitted.
+        if (jobs.empty())
+            return;
+
+        std::function<void()> job{ std::move(jobs.front()) };
+        jobs.pop_front();
+        activeJobs++;
+        lock.unlock();
+        slotAvailable.notify_one();
+
+        job();
+
+        lock.lock();
+        activeJobs--;
+        if (jobs.empty() && activeJobs == 0)
+            idle.notify_all();
+    }
+}
+
+size_t DefaultWorkerCount()
+{
+    unsigned int hardwareThreads = std::thread::hardware_concurrency();
+    return hardwareThreads > 0 ? hardwareThreads : 1;
+}
+
+size_t NestedWorkerCount(size_t numWorkers)
+{
+    return std::max<size_t>(1, DefaultWorkerCount() / 
+                               std::max<size_t>(1, numWorkers));
+}
@@ -0,0 +1,90 @@
+// WorkerPool.h - Declares the WorkerPool class.
+//
+// Copyright (C) 2024 Stephen Bonar
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http ://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// @brief The number of queued jobs allowed per worker before Submit blocks.
+inline constexpr size_t workerPoolJobsPerWorker{ 4 };
+
+/// @brief The most worker threads a pool starts, however many are asked for.
+inline constexpr size_t workerPoolMaxWorkers{ 256 };
+
+/// @brief Represents a fixed-size pool of worker threads.
+///
+/// Jobs are queued with Submit() and picked up by the first idle worker. The
+/// queue is bounded so that a producer enumerating thousands of files cannot
+/// get arbitrarily far ahead of the workers; Submit() simply blocks until a
+/// slot becomes free.
+class WorkerPool
+{
+public:
+    /// @brief Constructor; starts the specified number of worker threads.
+    /// @param numWorkers The number of workers, or 0 to match the hardware.
+    /// No more than workerPoolMaxWorkers are started.
+    WorkerPool(size_t numWorkers = 0);
+
+    /// @brief Destructor; finishes all queued jobs and joins the workers.
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    /// @brief Queues a job to be run by the next available worker.
+    /// @param job The job to run. Jobs must not throw.
+    void Submit(std::function<void()> job);
+
+    /// @brief Blocks until every job submitted so far has finished running.
+    void Wait();
+
+    /// @brief Gets the number of worker threads in the pool.
+    /// @return The number of worker threads.
+    size_t Size() const { return workers.size(); }
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable slotAvailable;
+    std::condition_variable idle;
+    size_t maxQueuedJobs;
+    size_t activeJobs;
+    bool stopping;
+
+    /// @brief The main loop each worker thread runs until the pool stops.
+    void WorkerLoop();
+};
+
+/// @brief Gets the default number of workers for the current hardware.
+/// @return The number of hardware threads, or 1 if it cannot be determined.
+size_t DefaultWorkerCount();
+
+/// @brief Gets the number of workers each job of a pool may use for work of
+/// its own, so that together they don't start more threads than the 
+/// hardware has.
+/// @param numWorkers The number of workers in the outer pool.
+/// @return The hardware threads shared out among the workers, at least 1.
+size_t NestedWorkerCount(size_t numWorkers);
+
+#endif